@@ -1,17 +1,43 @@
+#ifndef EACHUNK_H
+#define EACHUNK_H
+
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include "utk.h"
+
+#define EA_TAG(a,b,c,d) ((uint32_t)(a) | ((uint32_t)(b)<<8) | ((uint32_t)(c)<<16) | ((uint32_t)(d)<<24))
+
+/* A chunk is a view into caller-owned memory, such as a file mapped by
+** open_input in io.h, so chunks of any size are parsed without copying.
+** Reading past the end of a chunk sets a sticky error and yields zeros, so
+** callers can parse a whole header and check chunk->error once. */
 typedef struct EAChunk {
     uint32_t type;
-    uint8_t *start;
-    uint8_t *ptr;
-    uint8_t *end;
+    const uint8_t *start;
+    const uint8_t *ptr;
+    const uint8_t *end;
+    int error;
 } EAChunk;
 
+/* Fields of a PT (Patch) header, as found in M10 files and SCHl chunks. */
+typedef struct PTHeader {
+    uint32_t codec_revision;   /* key 0x80 */
+    uint32_t compression_type; /* key 0x83 (PT/M10) */
+    uint32_t num_samples;      /* key 0x85 */
+    uint32_t codec_type;       /* key 0xA0 (SCxl) */
+} PTHeader;
+
 static void chunk_read_bytes(EAChunk *chunk, uint8_t *dest, size_t size)
 {
     size_t bytes_remaining = chunk->end - chunk->ptr;
 
     if (bytes_remaining < size) {
-        fprintf(stderr, "error: unexpected end of chunk\n");
-        exit(EXIT_FAILURE);
+        chunk->error = UTK_ERR_EOF;
+        chunk->ptr = chunk->end;
+        memset(dest, 0, size);
+        return;
     }
 
     memcpy(dest, chunk->ptr, size);
@@ -22,7 +48,7 @@ static uint32_t chunk_read_u32(EAChunk *chunk)
 {
     uint8_t dest[4];
     chunk_read_bytes(chunk, dest, sizeof(dest));
-    return dest[0] | (dest[1] << 8) | (dest[2] << 16) | (dest[3] << 24);
+    return dest[0] | (dest[1] << 8) | (dest[2] << 16) | ((uint32_t)dest[3] << 24);
 }
 
 static uint32_t chunk_read_u8(EAChunk *chunk)
@@ -38,8 +64,9 @@ static uint32_t chunk_read_var_int(EAChunk *chunk)
     uint8_t size = chunk_read_u8(chunk);
 
     if (size > 4) {
-        fprintf(stderr, "error: invalid varint size %u\n", (unsigned)size);
-        exit(EXIT_FAILURE);
+        chunk->error = UTK_ERR_BAD_CHUNK;
+        chunk->ptr = chunk->end;
+        return 0;
     }
 
     chunk_read_bytes(chunk, dest, size);
@@ -49,29 +76,363 @@ static uint32_t chunk_read_var_int(EAChunk *chunk)
     case 1: return dest[0];
     case 2: return (dest[0]<<8) | dest[1];
     case 3: return (dest[0]<<16) | (dest[1] << 8) | dest[2];
-    case 4: return (dest[0]<<24) | (dest[1] << 16) | (dest[2] << 8) | dest[3];
+    case 4: return ((uint32_t)dest[0]<<24) | (dest[1] << 16) | (dest[2] << 8) | dest[3];
     default: return 0;
     }
 }
 
-static EAChunk *read_chunk(FILE *fp)
+/* Parse the key/value section of a PT header, starting at the chunk's
+** current position. Returns UTK_OK or the chunk's error. */
+static int chunk_read_pt_header(EAChunk *chunk, PTHeader *hdr)
+{
+    memset(hdr, 0, sizeof(*hdr));
+
+    while (!chunk->error) {
+        uint8_t cmd = chunk_read_u8(chunk);
+        if (cmd == 0xFD) {
+            while (!chunk->error) {
+                uint8_t key = chunk_read_u8(chunk);
+                uint32_t value = chunk_read_var_int(chunk);
+
+                if (key == 0xFF)
+                    break;
+                else if (key == 0x80)
+                    hdr->codec_revision = value;
+                else if (key == 0x83)
+                    hdr->compression_type = value;
+                else if (key == 0x85)
+                    hdr->num_samples = value;
+                else if (key == 0xA0)
+                    hdr->codec_type = value;
+            }
+            break;
+        } else {
+            chunk_read_var_int(chunk);
+        }
+    }
+
+    return chunk->error;
+}
+
+/* Set up a zero-copy view of the chunk at *ptr and advance *ptr past it. */
+static int chunk_from_memory(EAChunk *chunk, const uint8_t **ptr, const uint8_t *end)
 {
+    const uint8_t *p = *ptr;
     uint32_t size;
-    static EAChunk chunk;
-    static uint8_t buffer[4096];
 
-    chunk.type = read_u32(fp);
+    if (end - p < 8)
+        return UTK_ERR_EOF;
+
+    chunk->type = p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+    size = p[4] | (p[5] << 8) | (p[6] << 16) | ((uint32_t)p[7] << 24);
+    if (size < 8)
+        return UTK_ERR_BAD_CHUNK;
+    if ((size_t)(end - p) < size)
+        return UTK_ERR_EOF;
+
+    chunk->start = chunk->ptr = p + 8;
+    chunk->end = p + size;
+    chunk->error = UTK_OK;
+    *ptr = p + size;
+
+    return UTK_OK;
+}
+
+/*
+** PT and SCxl streams.
+*/
+
+/* A PT stream (M10 files) is a PT header followed by the bitstream. An
+** SCxl stream is an SCHl chunk holding a PT header, an SCCl chunk with the
+** number of SCDl chunks, the SCDl chunks and an SCEl chunk. Each SCDl chunk
+** holds the number of samples it decodes to and a piece of the bitstream;
+** the decoder state carries over from one to the next. */
+typedef struct EAStream {
+    PTHeader hdr;
+    int parsed_header;    /* hdr is valid, even if the stream is not */
+    const uint8_t *next;  /* PT: the bitstream; SCxl: the next SCDl chunk */
+    const uint8_t *end;
+    uint32_t num_chunks;  /* SCxl: the number of SCDl chunks */
+    uint32_t chunks_left;
+    uint32_t sample_pos;  /* of the next SCDl chunk */
+} EAStream;
+
+/* The bitstream of one SCDl chunk and the samples it decodes to, which are
+** clamped to the length of the stream. */
+typedef struct EADataChunk {
+    const uint8_t *ptr, *end;
+    uint32_t first_sample;
+    uint32_t num_samples;
+} EADataChunk;
+
+/* The decoder state at the start of an SCDl chunk, as in a seek point of
+** utkseek.h. The bit reader starts afresh at each chunk, so this is all that
+** a seek to the chunk needs. */
+typedef struct EACheckpoint {
+    float rc[12];
+    float synth_history[12];
+    float adapt_cb[324];
+} EACheckpoint;
+
+/* Parse the PT header of an M10 file in [data, data+size). s->next is then
+** the bitstream. */
+static int ea_open_pt(EAStream *s, const uint8_t *data, size_t size)
+{
+    EAChunk chunk;
+    int ret;
+
+    memset(s, 0, sizeof(*s));
+    s->next = data;
+    s->end = data + size;
+
+    ret = chunk_from_memory(&chunk, &s->next, s->end);
+    if (ret != UTK_OK)
+        return ret;
+    if ((chunk.type & 0xffff) != EA_TAG('P','T',0,0))
+        return UTK_ERR_BAD_SIGNATURE;
+
+    ret = chunk_read_pt_header(&chunk, &s->hdr);
+    if (ret != UTK_OK)
+        return ret;
+    s->parsed_header = 1;
+
+    if (s->hdr.compression_type != 9)
+        return UTK_ERR_UNSUPPORTED;
+
+    return UTK_OK;
+}
+
+/* Parse the SCHl and SCCl chunks of an SCxl stream in [data, data+size).
+** s->next is then the first SCDl chunk. */
+static int ea_open_scxl(EAStream *s, const uint8_t *data, size_t size)
+{
+    EAChunk chunk;
+    int ret;
+
+    memset(s, 0, sizeof(*s));
+    s->next = data;
+    s->end = data + size;
+
+    /* SCHl */
+    ret = chunk_from_memory(&chunk, &s->next, s->end);
+    if (ret != UTK_OK)
+        return ret;
+    if (chunk.type != EA_TAG('S','C','H','l'))
+        return UTK_ERR_BAD_SIGNATURE;
+    if ((chunk_read_u32(&chunk) & 0xffff) != EA_TAG('P','T',0,0))
+        return UTK_ERR_BAD_HEADER;
+
+    ret = chunk_read_pt_header(&chunk, &s->hdr);
+    if (ret != UTK_OK)
+        return ret;
+    s->parsed_header = 1;
+
+    if (s->hdr.codec_type != 4 && s->hdr.codec_type != 22)
+        return UTK_ERR_UNSUPPORTED;
+
+    /* SCCl */
+    ret = chunk_from_memory(&chunk, &s->next, s->end);
+    if (ret != UTK_OK)
+        return ret;
+    if (chunk.type != EA_TAG('S','C','C','l'))
+        return UTK_ERR_BAD_CHUNK;
+
+    s->num_chunks = chunk_read_u32(&chunk);
+    if (chunk.error)
+        return UTK_ERR_BAD_CHUNK;
+
+    s->chunks_left = s->num_chunks;
+
+    return UTK_OK;
+}
+
+/* Parse the next SCDl chunk into *dc. Returns UTK_ERR_EOF after the last
+** one. */
+static int ea_next_data_chunk(EAStream *s, EADataChunk *dc)
+{
+    EAChunk chunk;
+    uint32_t num_samples;
+    int ret;
+
+    if (s->chunks_left == 0)
+        return UTK_ERR_EOF;
+
+    ret = chunk_from_memory(&chunk, &s->next, s->end);
+    if (ret != UTK_OK)
+        return ret;
+    if (chunk.type != EA_TAG('S','C','D','l'))
+        return UTK_ERR_BAD_CHUNK;
+
+    num_samples = chunk_read_u32(&chunk);
+    chunk_read_u32(&chunk); /* unknown */
+    chunk_read_u8(&chunk);  /* unknown */
+    if (chunk.error)
+        return chunk.error;
+
+    if (num_samples > s->hdr.num_samples - s->sample_pos)
+        num_samples = s->hdr.num_samples - s->sample_pos;
+
+    dc->ptr = chunk.ptr;
+    dc->end = chunk.end;
+    dc->first_sample = s->sample_pos;
+    dc->num_samples = num_samples;
+
+    s->sample_pos += num_samples;
+    s->chunks_left--;
+
+    return UTK_OK;
+}
 
-    size = read_u32(fp);
-    if (size < 8 || size-8 > sizeof(buffer)) {
-        fprintf(stderr, "error: invalid chunk size %u\n", (unsigned)size);
-        exit(EXIT_FAILURE);
+/* Index all of the SCDl chunks of a stream just opened with ea_open_scxl
+** into index[s->num_chunks]. (An SCDl chunk takes at least 17 bytes, so
+** check s->num_chunks against the size of the data before allocating the
+** index for it.) */
+static int ea_index_scxl(EAStream *s, EADataChunk *index)
+{
+    uint32_t i;
+    int ret;
+
+    for (i = 0; i < s->num_chunks; i++) {
+        ret = ea_next_data_chunk(s, &index[i]);
+        if (ret != UTK_OK)
+            return ret;
+    }
+
+    return UTK_OK;
+}
+
+/* After the last SCDl chunk, check for the SCEl chunk and that the SCDl
+** chunks held all of the samples. */
+static int ea_read_scel(EAStream *s)
+{
+    EAChunk chunk;
+    int ret;
+
+    if (s->chunks_left != 0)
+        return UTK_ERR_INVALID_ARG;
+
+    ret = chunk_from_memory(&chunk, &s->next, s->end);
+    if (ret != UTK_OK)
+        return ret;
+    if (chunk.type != EA_TAG('S','C','E','l') || s->sample_pos != s->hdr.num_samples)
+        return UTK_ERR_BAD_CHUNK;
+
+    return UTK_OK;
+}
+
+/* Parse an SCxl stream from its SCHl chunk to its SCEl chunk, without
+** decoding it. s->next is then just past the stream. */
+static int ea_skip_scxl(EAStream *s, const uint8_t *data, size_t size)
+{
+    EADataChunk dc;
+    int ret;
+
+    ret = ea_open_scxl(s, data, size);
+    while (ret == UTK_OK && s->chunks_left > 0)
+        ret = ea_next_data_chunk(s, &dc);
+
+    if (ret != UTK_OK)
+        return ret;
+
+    return ea_read_scel(s);
+}
+
+/* The next SCHl tag in [ptr, end), or end if there is none. A bank or a
+** concatenation of SCxl streams may have padding between the streams. */
+static const uint8_t *ea_find_scxl(const uint8_t *ptr, const uint8_t *end)
+{
+    while (end - ptr >= 4) {
+        ptr = memchr(ptr, 'S', (size_t)(end - ptr) - 3);
+        if (!ptr)
+            break;
+        if (!memcmp(ptr, "SCHl", 4))
+            return ptr;
+        ptr++;
     }
 
-    size -= 8;
-    read_bytes(fp, buffer, size);
-    chunk.start = chunk.ptr = buffer;
-    chunk.end = buffer+size;
+    return end;
+}
+
+/* The index of the data chunk that holds the given sample. */
+static uint32_t ea_find_chunk(const EADataChunk *index, uint32_t num_chunks, uint32_t sample)
+{
+    uint32_t lo = 0, hi = num_chunks;
+
+    while (hi - lo > 1) {
+        uint32_t mid = lo + (hi - lo)/2;
+
+        if (index[mid].first_sample <= sample)
+            lo = mid;
+        else
+            hi = mid;
+    }
+
+    return lo;
+}
+
+/* Decode the num_chunks data chunks of an index once, and save the decoder
+** state at the start of each one into checkpoints[num_chunks]. rev3 is
+** nonzero for codec revision 3, whose frames may carry PCM data. Returns
+** UTK_OK, UTK_ERR_NOMEM or UTK_ERR_BAD_PCM. */
+static int ea_build_checkpoints(EACheckpoint *checkpoints, const EADataChunk *index,
+                                uint32_t num_chunks, int rev3)
+{
+    /* (too big for the stack on some platforms) */
+    UTKContext *ctx = malloc(sizeof(*ctx));
+    uint32_t i, j;
+
+    if (!ctx)
+        return UTK_ERR_NOMEM;
+
+    utk_init(ctx);
+
+    for (i = 0; i < num_chunks; i++) {
+        EACheckpoint *cp = &checkpoints[i];
+
+        memcpy(cp->rc, ctx->rc, sizeof(cp->rc));
+        memcpy(cp->synth_history, ctx->synth_history, sizeof(cp->synth_history));
+        memcpy(cp->adapt_cb, utk_adapt_cb(ctx), sizeof(cp->adapt_cb));
+
+        utk_set_ptr(ctx, index[i].ptr, index[i].end);
+
+        for (j = 0; j < index[i].num_samples; j += 432) {
+            if (!rev3) {
+                utk_decode_frame(ctx);
+            } else if (utk_rev3_decode_frame(ctx) != UTK_OK) {
+                free(ctx);
+                return UTK_ERR_BAD_PCM;
+            }
+        }
+    }
+
+    free(ctx);
+
+    return UTK_OK;
+}
+
+/* Set up ctx to decode from the start of data chunk i, with the decoder
+** state saved by ea_build_checkpoints. The stream header is taken from the
+** first chunk. The output is the same as that of a sequential decode. */
+static void ea_seek_chunk(UTKContext *ctx, const EADataChunk *index,
+                          const EACheckpoint *checkpoints, uint32_t i, int rev3)
+{
+    utk_init(ctx);
+
+    if (i > 0) {
+        const EACheckpoint *cp = &checkpoints[i];
+
+        /* (in revision 3, each frame starts with a byte-aligned PCM flag) */
+        utk_set_ptr(ctx, index[0].ptr + (rev3 ? 1 : 0), index[0].end);
+        utk_refill_bits(ctx);
+        utk_parse_header(ctx);
+        ctx->parsed_header = 1;
+
+        memcpy(ctx->rc, cp->rc, sizeof(cp->rc));
+        memcpy(ctx->synth_history, cp->synth_history, sizeof(cp->synth_history));
+        memcpy(utk_adapt_cb(ctx), cp->adapt_cb, sizeof(cp->adapt_cb));
+    }
+
+    utk_set_ptr(ctx, index[i].ptr, index[i].end);
+}
 
-    return &chunk;
-}
\ No newline at end of file
+#endif
@@ -4,6 +4,18 @@
 #include <string.h>
 #include <errno.h>
 
+/* Map input and output files into memory where the platform supports it
+** (define _POSIX_C_SOURCE 200112L before including any header); otherwise
+** fall back to stdio. */
+#if (defined(__unix__) || defined(__APPLE__)) && defined(_POSIX_C_SOURCE) \
+    && _POSIX_C_SOURCE >= 200112L
+#define IO_HAVE_MMAP 1
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
 static void read_bytes(FILE *fp, uint8_t *dest, size_t size)
 {
     size_t bytes_copied;
@@ -75,4 +87,430 @@ static void write_u16(FILE *fp, uint16_t x)
 static void write_u8(FILE *fp, uint8_t x)
 {
     write_bytes(fp, &x, sizeof(x));
-}
\ No newline at end of file
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static int is_little_endian(void)
+{
+    const uint16_t x = 1;
+    return *(const uint8_t *)&x;
+}
+
+/* The whole contents of an input file. */
+typedef struct InputFile {
+    const uint8_t *data;
+    size_t size;
+    int mapped;
+} InputFile;
+
+/* Read the rest of fp into memory. Returns 0 or an errno value. */
+static int read_all(InputFile *in, FILE *fp)
+{
+    uint8_t *data = NULL;
+    size_t size = 0, capacity = 0;
+
+    for (;;) {
+        size_t n;
+
+        if (size == capacity) {
+            uint8_t *p;
+
+            capacity = capacity ? 2*capacity : 1 << 16;
+            p = realloc(data, capacity);
+            if (!p) {
+                free(data);
+                return ENOMEM;
+            }
+            data = p;
+        }
+
+        n = fread(data + size, 1, capacity - size, fp);
+        size += n;
+        if (n == 0)
+            break;
+    }
+
+    if (ferror(fp)) {
+        int error = errno ? errno : EIO;
+        free(data);
+        return error;
+    }
+
+    in->data = data;
+    in->size = size;
+    in->mapped = 0;
+
+    return 0;
+}
+
+/* Load a whole input file, memory-mapping it if possible. A path of "-"
+** reads standard input. Returns 0 or an errno value. */
+static int load_input(InputFile *in, const char *path)
+{
+    FILE *fp;
+    int ret;
+
+    if (!strcmp(path, "-"))
+        return read_all(in, stdin);
+
+    fp = fopen(path, "rb");
+    if (!fp)
+        return errno ? errno : ENOENT;
+
+#ifdef IO_HAVE_MMAP
+    {
+        struct stat st;
+
+        /* (a file too large for the address space is read instead, and
+        ** fails with ENOMEM) */
+        if (fstat(fileno(fp), &st) == 0 && S_ISREG(st.st_mode) && st.st_size > 0
+            && (uint64_t)st.st_size <= (size_t)-1) {
+            void *p = mmap(NULL, (size_t)st.st_size, PROT_READ, MAP_PRIVATE, fileno(fp), 0);
+            if (p != MAP_FAILED) {
+                in->data = p;
+                in->size = (size_t)st.st_size;
+                in->mapped = 1;
+                fclose(fp);
+                return 0;
+            }
+        }
+    }
+#endif
+
+    ret = read_all(in, fp);
+    fclose(fp);
+
+    return ret;
+}
+
+/* Same as load_input, but exit with an error message on failure. */
+static void open_input(InputFile *in, const char *path)
+{
+    int ret = load_input(in, path);
+
+    if (ret != 0) {
+        fprintf(stderr, "error: failed to read '%s': %s\n", path, strerror(ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void close_input(InputFile *in)
+{
+#ifdef IO_HAVE_MMAP
+    if (in->mapped) {
+        munmap((void *)in->data, in->size);
+        return;
+    }
+#endif
+    free((void *)in->data);
+}
+
+/* An output file written through stdio, or, once output_map has been
+** called, copied straight into a memory mapping of the file. */
+typedef struct OutputFile {
+    FILE *fp;
+    const char *path;
+    uint8_t *map;
+    size_t map_size, pos;
+    int error; /* the first errno value from a failed write */
+} OutputFile;
+
+/* Create an output file. A path of "-" writes to standard output. Unless
+** force is set, refuse to overwrite an existing file. Returns 0, EEXIST or
+** another errno value. */
+static int create_output(OutputFile *out, const char *path, int force)
+{
+    FILE *fp;
+
+    memset(out, 0, sizeof(*out));
+    out->path = path;
+
+    if (!strcmp(path, "-")) {
+        out->fp = stdout;
+    } else {
+        if (!force && (fp = fopen(path, "rb")) != NULL) {
+            fclose(fp);
+            return EEXIST;
+        }
+
+        /* read-write, so that output_map can map the file */
+        out->fp = fopen(path, "w+b");
+        if (!out->fp)
+            return errno ? errno : EIO;
+    }
+
+    /* write in large blocks at block-aligned file offsets */
+    setvbuf(out->fp, NULL, _IOFBF, 1 << 16);
+
+    return 0;
+}
+
+/* Same as create_output, but exit with an error message on failure. */
+static void open_output(OutputFile *out, const char *path, int force)
+{
+    int ret = create_output(out, path, force);
+
+    if (ret == EEXIST && !force) {
+        fprintf(stderr, "error: '%s' already exists\n", path);
+        exit(EXIT_FAILURE);
+    } else if (ret != 0) {
+        fprintf(stderr, "error: failed to create '%s': %s\n", path, strerror(ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Once the header has been written, allocate a regular output file's final
+** size (in bytes) on disk and map it, so that the samples are copied into
+** the page cache without a write call per block. The space is allocated up
+** front because a write through the mapping to a full disk would raise
+** SIGBUS instead of failing. Pipes, platforms without mmap or
+** posix_fallocate, files too large for the address space and files that
+** don't fit on the disk keep writing through stdio, where a full disk is
+** reported as a write error. */
+static void output_map(OutputFile *out, uint64_t size)
+{
+#if defined(IO_HAVE_MMAP) && !defined(__APPLE__)
+    struct stat st;
+    long pos;
+    void *p;
+    int fd = fileno(out->fp);
+
+    if (fflush(out->fp) != 0 || fstat(fd, &st) != 0 || !S_ISREG(st.st_mode))
+        return;
+
+    if (size > (size_t)-1 || (uint64_t)(off_t)size != size)
+        return;
+
+    pos = ftell(out->fp);
+    if (pos < 0 || (uint64_t)pos > size)
+        return;
+
+    if (posix_fallocate(fd, 0, (off_t)size) != 0) {
+        /* (this may have extended the file) */
+        if (ftruncate(fd, (off_t)pos) != 0 && !out->error)
+            out->error = errno ? errno : EIO;
+        return;
+    }
+
+    p = mmap(NULL, (size_t)size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) {
+        if (ftruncate(fd, (off_t)pos) != 0 && !out->error)
+            out->error = errno ? errno : EIO;
+        return;
+    }
+
+    out->map = p;
+    out->map_size = (size_t)size;
+    out->pos = (size_t)pos;
+#else
+    (void)out;
+    (void)size;
+#endif
+}
+
+/* Write errors are kept in out->error and reported when the file is
+** closed. */
+static void output_bytes(OutputFile *out, const uint8_t *src, size_t size)
+{
+    if (!out->map) {
+        if (size && fwrite(src, 1, size, out->fp) != size && !out->error)
+            out->error = errno ? errno : EIO;
+        return;
+    }
+
+    if (size > out->map_size - out->pos) {
+        fprintf(stderr, "error: output larger than expected\n");
+        exit(EXIT_FAILURE);
+    }
+
+    memcpy(out->map + out->pos, src, size);
+    out->pos += size;
+}
+
+/* Write n samples as 16-bit little-endian PCM. */
+static void output_s16(OutputFile *out, const int16_t *x, size_t n)
+{
+    uint8_t dest[4096];
+    size_t i, j;
+
+    if (is_little_endian()) {
+        output_bytes(out, (const uint8_t *)x, n*2);
+        return;
+    }
+
+    for (i = 0; i < n; i += j) {
+        for (j = 0; j < sizeof(dest)/2 && i+j < n; j++) {
+            dest[2*j+0] = (uint8_t)x[i+j];
+            dest[2*j+1] = (uint8_t)((uint16_t)x[i+j]>>8);
+        }
+        output_bytes(out, dest, 2*j);
+    }
+}
+
+/* Write n samples as 32-bit little-endian IEEE float. */
+static void output_f32(OutputFile *out, const float *x, size_t n)
+{
+    uint8_t dest[4096];
+    size_t i, j;
+
+    if (is_little_endian()) {
+        output_bytes(out, (const uint8_t *)x, n*4);
+        return;
+    }
+
+    for (i = 0; i < n; i += j) {
+        for (j = 0; j < sizeof(dest)/4 && i+j < n; j++) {
+            uint32_t u;
+            memcpy(&u, &x[i+j], 4);
+            dest[4*j+0] = (uint8_t)u;
+            dest[4*j+1] = (uint8_t)(u>>8);
+            dest[4*j+2] = (uint8_t)(u>>16);
+            dest[4*j+3] = (uint8_t)(u>>24);
+        }
+        output_bytes(out, dest, 4*j);
+    }
+}
+
+/* Close an output file. Returns 0, or the errno value of the first write
+** that failed. */
+static int finish_output(OutputFile *out)
+{
+#ifdef IO_HAVE_MMAP
+    /* the space is already allocated, and the kernel writes the pages of a
+    ** shared mapping back after munmap, as it does for the stdio buffers
+    ** after fclose */
+    if (out->map && munmap(out->map, out->map_size) != 0 && !out->error)
+        out->error = errno ? errno : EIO;
+#endif
+
+    if (fclose(out->fp) != 0 && !out->error)
+        out->error = errno ? errno : EIO;
+
+    return out->error;
+}
+
+/* Same as finish_output, but exit with an error message on failure. */
+static void close_output(OutputFile *out)
+{
+    int ret = finish_output(out);
+
+    if (ret != 0) {
+        fprintf(stderr, "error: failed to write '%s': %s\n", out->path, strerror(ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Size of the header of a WAV file, and of the ds64 chunk that an RF64
+** file adds to it. */
+#define WAV_HEADER_SIZE(use_float) ((use_float) ? 58 : 44)
+#define WAV_DS64_SIZE 36
+#define WAV_MAX_HEADER_SIZE (WAV_HEADER_SIZE(1) + WAV_DS64_SIZE)
+
+static void put_u32(uint8_t *p, uint32_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x>>8);
+    p[2] = (uint8_t)(x>>16);
+    p[3] = (uint8_t)(x>>24);
+}
+
+static void put_u16(uint8_t *p, uint16_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x>>8);
+}
+
+static void put_u64(uint8_t *p, uint64_t x)
+{
+    put_u32(p, (uint32_t)x);
+    put_u32(p+4, (uint32_t)(x>>32));
+}
+
+/* Whether num_samples samples take an RF64 file, since the RIFF size of a
+** WAV file would not fit in 32 bits. */
+static int wav_is_rf64(uint64_t num_samples, int use_float)
+{
+    return WAV_HEADER_SIZE(use_float) - 8 + num_samples * (use_float ? 4 : 2) > 0xffffffff;
+}
+
+/* Size of the header written by make_wav_header and write_wav_header. */
+static size_t wav_header_size(uint64_t num_samples, int use_float)
+{
+    return WAV_HEADER_SIZE(use_float) + (wav_is_rf64(num_samples, use_float) ? WAV_DS64_SIZE : 0);
+}
+
+/* Size of the whole file. */
+static uint64_t wav_file_size(uint64_t num_samples, int use_float)
+{
+    return wav_header_size(num_samples, use_float) + num_samples * (use_float ? 4 : 2);
+}
+
+/* Build the header of a mono WAV file with 16-bit PCM samples, or with
+** 32-bit IEEE float samples (format 3, with the fact chunk it requires), in
+** dest, which must hold wav_header_size(num_samples, use_float) bytes.
+**
+** If the data is too large for a WAV file (4 GiB), this is the header of an
+** RF64 file (EBU Tech 3306) instead: the RIFF, data and fact sizes are set
+** to 0xffffffff, and their 64-bit values are in a ds64 chunk before fmt. */
+static void make_wav_header(uint8_t *dest, uint32_t sample_rate, uint64_t num_samples,
+                            int use_float)
+{
+    uint64_t data_size = num_samples * (use_float ? 4 : 2);
+    int rf64 = wav_is_rf64(num_samples, use_float);
+    uint8_t *p = dest;
+
+    if (rf64) {
+        memcpy(p, "RF64", 4);
+        put_u32(p+4, 0xffffffff);
+        memcpy(p+8, "WAVEds64", 8);
+        put_u32(p+16, WAV_DS64_SIZE - 8);
+        put_u64(p+20, wav_file_size(num_samples, use_float) - 8); /* riffSize */
+        put_u64(p+28, data_size);                   /* dataSize */
+        put_u64(p+36, num_samples);                 /* sampleCount */
+        put_u32(p+44, 0);                           /* tableLength */
+        p += WAV_DS64_SIZE;
+    } else {
+        memcpy(p, "RIFF", 4);
+        put_u32(p+4, (uint32_t)(WAV_HEADER_SIZE(use_float) - 8 + data_size));
+        memcpy(p+8, "WAVE", 4);
+    }
+
+    memcpy(p+12, "fmt ", 4);
+    put_u32(p+16, use_float ? 18 : 16);
+    put_u16(p+20, use_float ? 3 : 1);           /* wFormatTag */
+    put_u16(p+22, 1);                           /* nChannels */
+    put_u32(p+24, sample_rate);                 /* nSamplesPerSec */
+    put_u32(p+28, sample_rate * (use_float ? 4 : 2)); /* nAvgBytesPerSec */
+    put_u16(p+32, use_float ? 4 : 2);           /* nBlockAlign */
+    put_u16(p+34, use_float ? 32 : 16);         /* wBitsPerSample */
+    p += 36;
+
+    if (use_float) {
+        put_u16(p, 0);                          /* cbSize */
+        memcpy(p+2, "fact", 4);
+        put_u32(p+6, 4);
+        put_u32(p+10, rf64 ? 0xffffffff : (uint32_t)num_samples);
+        p += 14;
+    }
+
+    memcpy(p, "data", 4);
+    put_u32(p+4, rf64 ? 0xffffffff : (uint32_t)data_size);
+}
+
+static void write_wav_header(FILE *fp, uint32_t sample_rate, uint64_t num_samples,
+                             int use_float)
+{
+    uint8_t dest[WAV_MAX_HEADER_SIZE];
+
+    make_wav_header(dest, sample_rate, num_samples, use_float);
+    write_bytes(fp, dest, wav_header_size(num_samples, use_float));
+}
@@ -0,0 +1,302 @@
+/*
+** libutk
+** Reentrant MicroTalk decoding library.
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
+**          -c -o libutk.o libutk.c && ar rcs libutk.a libutk.o
+**          gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
+**          -shared -fPIC -o libutk.so libutk.c
+*/
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include "libutk.h"
+#include "utk.h"
+#include "eachunk.h"
+
+#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((uint32_t)(d)<<24))
+#define MIN(x,y) ((x)<(y)?(x):(y))
+
+struct UTKDecoder {
+    UTKAllocator allocator;
+    UTKStreamInfo info;
+    int opened;
+
+    /* SCxl: the chunks after the current one, and its samples left */
+    EAStream stream;
+    uint32_t chunk_samples;
+
+    uint32_t samples_remaining;
+    int frame_pos, frame_len;
+    UTKContext utk;
+};
+
+static void *default_alloc(void *opaque, size_t size)
+{
+    (void)opaque;
+    return malloc(size);
+}
+
+static void default_free(void *opaque, void *ptr)
+{
+    (void)opaque;
+    free(ptr);
+}
+
+static uint32_t get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint16_t get_u16(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8);
+}
+
+static int open_utm0(UTKDecoder *dec, const uint8_t *data, size_t size)
+{
+    uint32_t dwOutSize, nSamplesPerSec;
+
+    if (size < 32)
+        return UTK_ERR_EOF;
+
+    dwOutSize = get_u32(data+4);
+    nSamplesPerSec = get_u32(data+16);
+
+    if ((dwOutSize & 0x01) != 0
+        || get_u32(data+8) != 20     /* dwWfxSize */
+        || get_u16(data+12) != 1)    /* wFormatTag */
+        return UTK_ERR_BAD_HEADER;
+
+    if (get_u16(data+14) != 1        /* nChannels */
+        || nSamplesPerSec < 8000 || nSamplesPerSec > 192000
+        || get_u32(data+20) != nSamplesPerSec * 2 /* nAvgBytesPerSec */
+        || get_u16(data+24) != 2     /* nBlockAlign */
+        || get_u16(data+26) != 16    /* wBitsPerSample */
+        || get_u16(data+28) != 0)    /* cbSize */
+        return UTK_ERR_UNSUPPORTED;
+
+    dec->info.container = UTK_CONTAINER_UTM0;
+    dec->info.sample_rate = nSamplesPerSec;
+    dec->info.num_samples = dwOutSize/2;
+    utk_set_ptr(&dec->utk, data + 32, data + size);
+
+    return UTK_OK;
+}
+
+static int open_pt(UTKDecoder *dec, const uint8_t *data, size_t size)
+{
+    int ret = ea_open_pt(&dec->stream, data, size);
+
+    if (ret != UTK_OK)
+        return ret;
+
+    dec->info.container = UTK_CONTAINER_PT;
+    dec->info.sample_rate = 22050;
+    dec->info.num_samples = dec->stream.hdr.num_samples;
+    utk_set_ptr(&dec->utk, dec->stream.next, dec->stream.end);
+
+    return UTK_OK;
+}
+
+static int open_scxl(UTKDecoder *dec, const uint8_t *data, size_t size)
+{
+    int ret = ea_open_scxl(&dec->stream, data, size);
+
+    if (ret != UTK_OK)
+        return ret;
+
+    dec->info.container = UTK_CONTAINER_SCXL;
+    dec->info.codec_revision = dec->stream.hdr.codec_revision;
+    dec->info.sample_rate = 22050;
+    dec->info.num_samples = dec->stream.hdr.num_samples;
+
+    return UTK_OK;
+}
+
+/* Move on to the next SCDl chunk. */
+static int next_data_chunk(UTKDecoder *dec)
+{
+    EADataChunk chunk;
+    int ret;
+
+    ret = ea_next_data_chunk(&dec->stream, &chunk);
+    if (ret != UTK_OK)
+        return ret;
+
+    dec->chunk_samples = chunk.num_samples;
+    utk_set_ptr(&dec->utk, chunk.ptr, chunk.end);
+
+    return UTK_OK;
+}
+
+static int decode_next_frame(UTKDecoder *dec)
+{
+    int ret;
+
+    if (dec->info.container == UTK_CONTAINER_SCXL) {
+        while (dec->chunk_samples == 0) {
+            ret = next_data_chunk(dec);
+            if (ret != UTK_OK)
+                return ret;
+        }
+
+        if (dec->info.codec_revision >= 3) {
+            ret = utk_rev3_decode_frame(&dec->utk);
+            if (ret != UTK_OK)
+                return ret;
+        } else {
+            utk_decode_frame(&dec->utk);
+        }
+
+        dec->frame_len = MIN(dec->chunk_samples, 432);
+        dec->chunk_samples -= dec->frame_len;
+    } else {
+        utk_decode_frame(&dec->utk);
+        dec->frame_len = MIN(dec->samples_remaining, 432);
+    }
+
+    dec->frame_pos = 0;
+    dec->samples_remaining -= dec->frame_len;
+
+    return UTK_OK;
+}
+
+/*
+** Public functions.
+*/
+
+UTKDecoder *utk_decoder_create(const UTKAllocator *allocator)
+{
+    UTKAllocator a;
+    UTKDecoder *dec;
+
+    if (allocator) {
+        a = *allocator;
+    } else {
+        a.alloc = default_alloc;
+        a.free = default_free;
+        a.opaque = NULL;
+    }
+
+    dec = a.alloc(a.opaque, sizeof(*dec));
+    if (!dec)
+        return NULL;
+
+    memset(dec, 0, sizeof(*dec));
+    dec->allocator = a;
+
+    return dec;
+}
+
+void utk_decoder_destroy(UTKDecoder *dec)
+{
+    if (dec)
+        dec->allocator.free(dec->allocator.opaque, dec);
+}
+
+int utk_decoder_open(UTKDecoder *dec, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    int ret;
+
+    if (!dec || (!data && size))
+        return UTK_ERR_INVALID_ARG;
+
+    dec->opened = 0;
+    memset(&dec->info, 0, sizeof(dec->info));
+    memset(&dec->stream, 0, sizeof(dec->stream));
+    dec->chunk_samples = 0;
+    dec->frame_pos = dec->frame_len = 0;
+    utk_init(&dec->utk);
+
+    if (size < 4)
+        return UTK_ERR_BAD_SIGNATURE;
+
+    if (get_u32(p) == MAKE_U32('U','T','M','0'))
+        ret = open_utm0(dec, p, size);
+    else if (get_u32(p) == MAKE_U32('S','C','H','l'))
+        ret = open_scxl(dec, p, size);
+    else if ((get_u32(p) & 0xffff) == MAKE_U32('P','T','\x00','\x00'))
+        ret = open_pt(dec, p, size);
+    else
+        ret = UTK_ERR_BAD_SIGNATURE;
+
+    if (ret != UTK_OK)
+        return ret;
+
+    dec->samples_remaining = dec->info.num_samples;
+    dec->opened = 1;
+
+    return UTK_OK;
+}
+
+int utk_decoder_get_info(const UTKDecoder *dec, UTKStreamInfo *info)
+{
+    if (!dec || !info || !dec->opened)
+        return UTK_ERR_INVALID_ARG;
+
+    *info = dec->info;
+
+    return UTK_OK;
+}
+
+/* Decode up to max_samples samples into out, as int16 (out_float == NULL) or
+** float (out_s16 == NULL). */
+static int read_samples(UTKDecoder *dec, int16_t *out_s16, float *out_float,
+                        size_t max_samples, size_t *samples_read)
+{
+    size_t total = 0;
+    int ret = UTK_OK;
+
+    while (total < max_samples) {
+        int count;
+
+        if (dec->frame_pos == dec->frame_len) {
+            if (dec->samples_remaining == 0)
+                break;
+
+            ret = decode_next_frame(dec);
+            if (ret != UTK_OK)
+                break;
+        }
+
+        count = (int)MIN((size_t)(dec->frame_len - dec->frame_pos), max_samples - total);
+        if (out_s16)
+            utk_convert_s16(&out_s16[total], &dec->utk.decompressed_frame[dec->frame_pos], count);
+        else
+            utk_convert_f32(&out_float[total], &dec->utk.decompressed_frame[dec->frame_pos], count);
+
+        dec->frame_pos += count;
+        total += count;
+    }
+
+    if (samples_read)
+        *samples_read = total;
+
+    return ret;
+}
+
+int utk_decoder_read_s16(UTKDecoder *dec, int16_t *out, size_t max_samples,
+                         size_t *samples_read)
+{
+    if (!dec || !dec->opened || (!out && max_samples))
+        return UTK_ERR_INVALID_ARG;
+
+    return read_samples(dec, out, NULL, max_samples, samples_read);
+}
+
+int utk_decoder_read_f32(UTKDecoder *dec, float *out, size_t max_samples,
+                         size_t *samples_read)
+{
+    if (!dec || !dec->opened || (!out && max_samples))
+        return UTK_ERR_INVALID_ARG;
+
+    return read_samples(dec, NULL, out, max_samples, samples_read);
+}
+
+const char *utk_strerror(int error)
+{
+    return utk_error_string(error);
+}
@@ -0,0 +1,63 @@
+/*
+** libutk
+** Reentrant MicroTalk decoding library.
+** Authors: Andrew D'Addesio
+** License: Public domain
+**
+** Every UTKDecoder is independent: there is no global state, so separate
+** decoders may be used concurrently from separate threads. Nothing in the
+** library calls exit() or prints to stderr; every function that can fail
+** returns one of the UTK_* codes from utkerror.h.
+*/
+#ifndef LIBUTK_H
+#define LIBUTK_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include "utkerror.h"
+
+typedef struct UTKDecoder UTKDecoder;
+
+/* Caller-supplied allocation. Pass NULL to use malloc/free. */
+typedef struct UTKAllocator {
+    void *(*alloc)(void *opaque, size_t size);
+    void (*free)(void *opaque, void *ptr);
+    void *opaque;
+} UTKAllocator;
+
+enum {
+    UTK_CONTAINER_UTM0 = 1, /* Maxis UTK (The Sims Online, SimCity 4) */
+    UTK_CONTAINER_PT = 2,   /* PT/M10 (Beasts & Bumpkins) */
+    UTK_CONTAINER_SCXL = 3  /* EA SCxl (FIFA 2001/2002) */
+};
+
+typedef struct UTKStreamInfo {
+    int container;
+    int codec_revision;
+    uint32_t sample_rate;
+    uint32_t num_samples;
+} UTKStreamInfo;
+
+UTKDecoder *utk_decoder_create(const UTKAllocator *allocator);
+void utk_decoder_destroy(UTKDecoder *dec);
+
+/* Detect the container format and parse the stream header. The data is not
+** copied and must remain valid until the decoder is destroyed or reopened.
+** A decoder may be reopened any number of times to decode another file. */
+int utk_decoder_open(UTKDecoder *dec, const void *data, size_t size);
+
+int utk_decoder_get_info(const UTKDecoder *dec, UTKStreamInfo *info);
+
+/* Decode up to max_samples samples. *samples_read is set to 0 at the end of
+** the stream. */
+int utk_decoder_read_s16(UTKDecoder *dec, int16_t *out, size_t max_samples,
+                         size_t *samples_read);
+
+/* Same as utk_decoder_read_s16, but output float samples with int16 full
+** scale at +-1.0, without clipping. */
+int utk_decoder_read_f32(UTKDecoder *dec, float *out, size_t max_samples,
+                         size_t *samples_read);
+
+const char *utk_strerror(int error);
+
+#endif
@@ -1,138 +1,131 @@
+#ifndef UTK_H
+#define UTK_H
+
 #include <stdint.h>
+#include <stdio.h>
 #include <string.h>
+#include "utkerror.h"
+#include "utkcodebook.h"
+#include "utktables.h"
+#include "utkdsp.h"
+
+/* Per-frame statistics, for finding out why a stream decodes slowly or
+** sounds bad. Only compiled in with -DUTK_STATS; otherwise the decoder has
+** no trace of them. If ctx->stats_hook is set, utk_decode_frame calls it
+** with the statistics of each frame (see utkstats.h to aggregate them). */
+#ifdef UTK_STATS
+typedef struct UTKFrameStats {
+    int use_multipulse;
+    int subframe_bits[4]; /* including the pitch and gain fields */
+    int pitch_lag[4];     /* 0-255 */
+    int pitch_gain[4];    /* index, 0-15 */
+    int fixed_gain[4];    /* index, 0-63 */
+    int zero_runs;        /* runs of 7-70 zeros (multipulse only) */
+    int large_pulses;     /* pulses of magnitude 7 and up (multipulse only) */
+    int clipped;          /* samples that saturate when converted to int16 */
+} UTKFrameStats;
+
+#define UTK_STAT(x) x
+#else
+#define UTK_STAT(x)
+#endif
+
+struct UTKFrame;
+
+/* The excitation history that the pitch predictor (adaptive codebook) reads
+** is kept in a ring of 8 subframes, so that it never has to be moved. The
+** current frame's excitation goes at cb_pos, which alternates between 0 and
+** 432, and the 324 samples before it (wrapping around) are the codebook.
+** The first subframe is mirrored after the end of the ring, so every 108
+** samples the predictor reads are contiguous. */
+#define UTK_RING_SIZE 864
+
+/* The refill buffer for reading a bitstream from a file (utk_set_fp). It is
+** supplied by the caller, so that the many contexts that decode from memory
+** don't carry it. */
+typedef struct UTKFileBuffer {
+    FILE *fp;
+    uint8_t data[8+4096];
+} UTKFileBuffer;
 
-/* Note: This struct assumes a member alignment of 4 bytes.
-** This matters when pitch_lag > 216 on the first subframe of any given frame. */
 typedef struct UTKContext {
-    FILE *fp;
+    /* the state used on every frame comes first, to keep it in as few cache
+    ** lines as possible */
+    uint64_t bits_value;
     const uint8_t *ptr, *end;
-    int parsed_header;
-    unsigned int bits_value;
     int bits_count;
+    int overrun; /* zero bytes returned past the end of the input */
+    /* the subframe parsers for the stream, by model (see utkframe.h) */
+    void (*parse_subframes[2])(struct UTKContext *ctx, struct UTKFrame *frame);
     int reduced_bw;
     int multipulse_thresh;
-    float fixed_gains[64];
+    int cb_pos;
+    int parsed_header;
     float rc[12];
     float synth_history[12];
-    float adapt_cb[324];
+    float fixed_gains[64];
+    float cb_ring[UTK_RING_SIZE+108];
     float decompressed_frame[432];
+    UTKFileBuffer *file; /* set by utk_set_fp */
+    int fp_buffered; /* ptr and end point into file->data */
+#ifdef UTK_STATS
+    uint32_t bits_read;
+    UTKFrameStats stats;  /* of the last frame */
+    void (*stats_hook)(void *opaque, const UTKFrameStats *stats);
+    void *stats_opaque;
+#endif
 } UTKContext;
 
-enum {
-    MDL_NORMAL = 0,
-    MDL_LARGEPULSE = 1
-};
-
-static const float utk_rc_table[64] = {
-    +0.0f,
-    -.99677598476409912109375f, -.99032700061798095703125f, -.983879029750823974609375f, -.977430999279022216796875f,
-    -.970982015132904052734375f, -.964533984661102294921875f, -.958085000514984130859375f, -.9516370296478271484375f,
-    -.930754005908966064453125f, -.904959976673126220703125f, -.879167020320892333984375f, -.853372991085052490234375f,
-    -.827579021453857421875f, -.801786005496978759765625f, -.775991976261138916015625f, -.75019800662994384765625f,
-    -.724404990673065185546875f, -.6986110210418701171875f, -.6706349849700927734375f, -.61904799938201904296875f,
-    -.567460000514984130859375f, -.515873014926910400390625f, -.4642859995365142822265625f, -.4126980006694793701171875f,
-    -.361110985279083251953125f, -.309523999691009521484375f, -.257937014102935791015625f, -.20634900033473968505859375f,
-    -.1547619998455047607421875f, -.10317499935626983642578125f, -.05158700048923492431640625f,
-    +0.0f,
-    +.05158700048923492431640625f, +.10317499935626983642578125f, +.1547619998455047607421875f, +.20634900033473968505859375f,
-    +.257937014102935791015625f, +.309523999691009521484375f, +.361110985279083251953125f, +.4126980006694793701171875f,
-    +.4642859995365142822265625f, +.515873014926910400390625f, +.567460000514984130859375f, +.61904799938201904296875f,
-    +.6706349849700927734375f, +.6986110210418701171875f, +.724404990673065185546875f, +.75019800662994384765625f,
-    +.775991976261138916015625f, +.801786005496978759765625f, +.827579021453857421875f, +.853372991085052490234375f,
-    +.879167020320892333984375f, +.904959976673126220703125f, +.930754005908966064453125f, +.9516370296478271484375f,
-    +.958085000514984130859375f, +.964533984661102294921875f, +.970982015132904052734375f, +.977430999279022216796875f,
-    +.983879029750823974609375f, +.99032700061798095703125f, +.99677598476409912109375f
-};
-
-static const uint8_t utk_codebooks[2][256] = {
-    { /* normal model */
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 21,
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 25,
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 22,
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5,  0,
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 21,
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 26,
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 22,
-        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
-        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5,  2
-    }, { /* large-pulse model */
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 27,
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  1,
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 28,
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  3,
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 27,
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  1,
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 28,
-        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
-        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  3
+/* The fields of one frame, as read from the bitstream by utk_parse_frame. */
+typedef struct UTKFrame {
+    int use_multipulse;
+    float rc[12];
+    int pitch_lag[4];
+    float pitch_gain[4];
+    float fixed_gain[4];
+    float excitation[4][5+108+5];
+} UTKFrame;
+
+static const char *utk_error_string(int error)
+{
+    switch (error) {
+    case UTK_OK: return "success";
+    case UTK_ERR_NOMEM: return "out of memory";
+    case UTK_ERR_INVALID_ARG: return "invalid argument";
+    case UTK_ERR_EOF: return "unexpected end of data";
+    case UTK_ERR_BAD_SIGNATURE: return "unrecognized file signature";
+    case UTK_ERR_BAD_HEADER: return "invalid stream header";
+    case UTK_ERR_BAD_CHUNK: return "invalid chunk";
+    case UTK_ERR_UNSUPPORTED: return "unsupported stream parameters";
+    case UTK_ERR_BAD_PCM: return "invalid PCM data in MicroTalk Rev. 3 frame";
+    default: return "unknown error";
     }
-};
-
-static const struct {
-    int next_model;
-    int code_size;
-    float pulse_value;
-} utk_commands[29] = {
-    {MDL_LARGEPULSE, 8,  0.0f},
-    {MDL_LARGEPULSE, 7,  0.0f},
-    {MDL_NORMAL,     8,  0.0f},
-    {MDL_NORMAL,     7,  0.0f},
-    {MDL_NORMAL,     2,  0.0f},
-    {MDL_NORMAL,     2, -1.0f},
-    {MDL_NORMAL,     2, +1.0f},
-    {MDL_NORMAL,     3, -1.0f},
-    {MDL_NORMAL,     3, +1.0f},
-    {MDL_LARGEPULSE, 4, -2.0f},
-    {MDL_LARGEPULSE, 4, +2.0f},
-    {MDL_LARGEPULSE, 3, -2.0f},
-    {MDL_LARGEPULSE, 3, +2.0f},
-    {MDL_LARGEPULSE, 5, -3.0f},
-    {MDL_LARGEPULSE, 5, +3.0f},
-    {MDL_LARGEPULSE, 4, -3.0f},
-    {MDL_LARGEPULSE, 4, +3.0f},
-    {MDL_LARGEPULSE, 6, -4.0f},
-    {MDL_LARGEPULSE, 6, +4.0f},
-    {MDL_LARGEPULSE, 5, -4.0f},
-    {MDL_LARGEPULSE, 5, +4.0f},
-    {MDL_LARGEPULSE, 7, -5.0f},
-    {MDL_LARGEPULSE, 7, +5.0f},
-    {MDL_LARGEPULSE, 6, -5.0f},
-    {MDL_LARGEPULSE, 6, +5.0f},
-    {MDL_LARGEPULSE, 8, -6.0f},
-    {MDL_LARGEPULSE, 8, +6.0f},
-    {MDL_LARGEPULSE, 7, -6.0f},
-    {MDL_LARGEPULSE, 7, +6.0f}
-};
+}
 
 static int utk_read_byte(UTKContext *ctx)
 {
     if (ctx->ptr < ctx->end)
         return *ctx->ptr++;
 
-    if (ctx->fp) {
-        static uint8_t buffer[4096];
-        size_t bytes_copied = fread(buffer, 1, sizeof(buffer), ctx->fp);
-        if (bytes_copied > 0 && bytes_copied <= sizeof(buffer)) {
-            ctx->ptr = buffer;
-            ctx->end = buffer + bytes_copied;
+    if (ctx->file) {
+        UTKFileBuffer *file = ctx->file;
+        size_t bytes_copied;
+
+        /* Keep the last 8 bytes of the previous block in front of the new
+        ** one so that utk_unread_bits can always rewind into them. */
+        if (ctx->fp_buffered)
+            memcpy(file->data, ctx->end - 8, 8);
+
+        bytes_copied = fread(file->data + 8, 1, sizeof(file->data) - 8, file->fp);
+        if (bytes_copied > 0 && bytes_copied <= sizeof(file->data) - 8) {
+            ctx->ptr = file->data + 8;
+            ctx->end = file->data + 8 + bytes_copied;
+            ctx->fp_buffered = 1;
             return *ctx->ptr++;
         }
     }
 
+    ctx->overrun++;
     return 0;
 }
 
@@ -143,91 +136,133 @@ static int16_t utk_read_i16(UTKContext *ctx)
     return x;
 }
 
+static uint64_t utk_load_u64(const uint8_t *p)
+{
+    return (uint64_t)p[0] | ((uint64_t)p[1] << 8) | ((uint64_t)p[2] << 16)
+        | ((uint64_t)p[3] << 24) | ((uint64_t)p[4] << 32) | ((uint64_t)p[5] << 40)
+        | ((uint64_t)p[6] << 48) | ((uint64_t)p[7] << 56);
+}
+
+/* Top up the bit buffer to at least 56 bits. The fast path loads 8 bytes at
+** once; bits of the 8th byte that land above bits_count are identical to the
+** ones the next refill ORs in, so they need no masking. Near the end of the
+** input (or when reading from a file) we fall back to one byte at a time,
+** which also supplies zeros past the end just like utk_read_byte. */
+static void utk_refill_bits(UTKContext *ctx)
+{
+    if (ctx->end - ctx->ptr >= 8) {
+        ctx->bits_value |= utk_load_u64(ctx->ptr) << ctx->bits_count;
+        ctx->ptr += (63 - ctx->bits_count) >> 3;
+        ctx->bits_count |= 56;
+    } else {
+        while (ctx->bits_count <= 56) {
+            ctx->bits_value |= (uint64_t)utk_read_byte(ctx) << ctx->bits_count;
+            ctx->bits_count += 8;
+        }
+    }
+}
+
+/* Read count <= 8 bits, LSB first. At least 8 bits are always buffered, so
+** the next byte of the bitstream can be peeked at with bits_value & 0xff. */
 static int utk_read_bits(UTKContext *ctx, int count)
 {
-    int ret = ctx->bits_value & ((1 << count) - 1);
+    int ret = (int)ctx->bits_value & ((1 << count) - 1);
     ctx->bits_value >>= count;
     ctx->bits_count -= count;
+    UTK_STAT(ctx->bits_read += count);
 
-    if (ctx->bits_count < 8) {
-        /* read another byte */
-        ctx->bits_value |= utk_read_byte(ctx) << ctx->bits_count;
-        ctx->bits_count += 8;
-    }
+    if (ctx->bits_count < 8)
+        utk_refill_bits(ctx);
 
     return ret;
 }
 
-static void utk_parse_header(UTKContext *ctx)
+/* Discard the partially consumed byte and reset the bit reader, leaving ptr
+** one byte short of where a byte-at-a-time reader would be (it always held
+** exactly one whole byte of lookahead, and did not advance ptr for the zero
+** bytes it supplied past the end of the input). */
+static void utk_unread_bits(UTKContext *ctx)
+{
+    int back = (ctx->bits_count >> 3) - ctx->overrun;
+
+    ctx->ptr -= back > 1 ? back : 1;
+    ctx->overrun = 0;
+    ctx->bits_value = 0;
+    ctx->bits_count = 0;
+}
+
+/* Number of bits read so far, counting from start, when reading from memory
+** (see utk_set_ptr). */
+static uint64_t utk_tell(const UTKContext *ctx, const uint8_t *start)
+{
+    return ((uint64_t)(ctx->ptr - start) + ctx->overrun)*8 - ctx->bits_count;
+}
+
+/* the decoder variants: full or reduced bandwidth, RELP or multi-pulse */
+#define UTK_STRIDE 1
+#define UTK_MULTIPULSE 0
+#define UTK_VARIANT(x) x##_fb_relp
+#include "utkframe.h"
+#define UTK_STRIDE 1
+#define UTK_MULTIPULSE 1
+#define UTK_VARIANT(x) x##_fb_mp
+#include "utkframe.h"
+#define UTK_STRIDE 2
+#define UTK_MULTIPULSE 0
+#define UTK_VARIANT(x) x##_rb_relp
+#include "utkframe.h"
+#define UTK_STRIDE 2
+#define UTK_MULTIPULSE 1
+#define UTK_VARIANT(x) x##_rb_mp
+#include "utkframe.h"
+
+/* Set up the decoder for the 15-bit stream header at the start of the
+** bitstream, as read LSB first: the bandwidth (1 bit), the multi-pulse
+** threshold (4 bits) and the first fixed gain and the ratio between fixed
+** gains (4 and 6 bits). */
+static void utk_set_header(UTKContext *ctx, int header)
 {
     int i;
     float multiplier;
 
-    ctx->reduced_bw = utk_read_bits(ctx, 1);
-    ctx->multipulse_thresh = 32 - utk_read_bits(ctx, 4);
-    ctx->fixed_gains[0] = 8.0f * (1 + utk_read_bits(ctx, 4));
-    multiplier = 1.04f + utk_read_bits(ctx, 6)*0.001f;
+    ctx->reduced_bw = header & 1;
+    ctx->multipulse_thresh = 32 - ((header >> 1) & 15);
+    ctx->fixed_gains[0] = 8.0f * (1 + ((header >> 5) & 15));
+    multiplier = 1.04f + ((header >> 9) & 63)*0.001f;
 
     for (i = 1; i < 64; i++)
         ctx->fixed_gains[i] = ctx->fixed_gains[i-1] * multiplier;
+
+    if (!ctx->reduced_bw) {
+        ctx->parse_subframes[0] = utk_parse_subframes_fb_relp;
+        ctx->parse_subframes[1] = utk_parse_subframes_fb_mp;
+    } else {
+        ctx->parse_subframes[0] = utk_parse_subframes_rb_relp;
+        ctx->parse_subframes[1] = utk_parse_subframes_rb_mp;
+    }
 }
 
-static void utk_decode_excitation(UTKContext *ctx, int use_multipulse, float *out, int stride)
+static void utk_parse_header(UTKContext *ctx)
 {
-    int i;
+    int header = utk_read_bits(ctx, 8);
 
-    if (use_multipulse) {
-        /* multi-pulse model: n pulses are coded explicitly; the rest are zero */
-        int model, cmd;
-        model = 0;
-        i = 0;
-        while (i < 108) {
-            cmd = utk_codebooks[model][ctx->bits_value & 0xff];
-            model = utk_commands[cmd].next_model;
-            utk_read_bits(ctx, utk_commands[cmd].code_size);
-
-            if (cmd > 3) {
-                /* insert a pulse with magnitude <= 6.0f */
-                out[i] = utk_commands[cmd].pulse_value;
-                i += stride;
-            } else if (cmd > 1) {
-                /* insert between 7 and 70 zeros */
-                int count = 7 + utk_read_bits(ctx, 6);
-                if (i + count * stride > 108)
-                    count = (108 - i)/stride;
-
-                while (count > 0) {
-                    out[i] = 0.0f;
-                    i += stride;
-                    count--;
-                }
-            } else {
-                /* insert a pulse with magnitude >= 7.0f */
-                int x = 7;
-
-                while (utk_read_bits(ctx, 1))
-                    x++;
-
-                if (!utk_read_bits(ctx, 1))
-                    x *= -1;
-
-                out[i] = (float)x;
-                i += stride;
-            }
-        }
+    utk_set_header(ctx, header | utk_read_bits(ctx, 7) << 8);
+}
+
+/* Decode the 108/stride excitation samples of one subframe into out[0],
+** out[stride], ... (stride is 1, or 2 at reduced bandwidth). */
+static void utk_decode_excitation(UTKContext *ctx, int use_multipulse, float *out, int stride)
+{
+    if (stride == 1) {
+        if (use_multipulse)
+            utk_decode_excitation_fb_mp(ctx, out);
+        else
+            utk_decode_excitation_fb_relp(ctx, out);
     } else {
-        /* RELP model: entire residual (excitation) signal is coded explicitly */
-        i = 0;
-        while (i < 108) {
-            if (!utk_read_bits(ctx, 1))
-                out[i] = 0.0f;
-            else if (!utk_read_bits(ctx, 1))
-                out[i] = -2.0f;
-            else
-                out[i] = 2.0f;
-
-            i += stride;
-        }
+        if (use_multipulse)
+            utk_decode_excitation_rb_mp(ctx, out);
+        else
+            utk_decode_excitation_rb_relp(ctx, out);
     }
 }
 
@@ -259,52 +294,56 @@ static void rc_to_lpc(const float *rc, float *lpc)
     }
 }
 
-static void utk_lp_synthesis_filter(UTKContext *ctx, int offset, int num_blocks)
+static void utk_lp_synthesis_filter(UTKContext *ctx, const float *excitation,
+                                    int offset, int num_blocks)
 {
-    int i, j, k;
     float lpc[12];
-    float *ptr = &ctx->decompressed_frame[offset];
 
     rc_to_lpc(ctx->rc, lpc);
+    utk_synthesize(&ctx->decompressed_frame[offset], &excitation[offset], num_blocks,
+                   lpc, ctx->synth_history);
+}
 
-    for (i = 0; i < num_blocks; i++) {
-        for (j = 0; j < 12; j++) {
-            float x = *ptr;
-
-            for (k = 0; k < j; k++)
-                x += lpc[k] * ctx->synth_history[k-j+12];
-            for (; k < 12; k++)
-                x += lpc[k] * ctx->synth_history[k-j];
+/* A pitch lag above 216 on the first subframe reaches up to 39 samples in
+** front of the adaptive codebook. The original decoder kept the codebook in
+** its context right behind the tail of fixed_gains, rc and synth_history,
+** and read those; put the same values in front of the codebook. */
+static void utk_fill_cb_prefix(UTKContext *ctx)
+{
+    float *prefix = &ctx->cb_ring[(ctx->cb_pos + UTK_RING_SIZE - 324 - 39) % UTK_RING_SIZE];
 
-            ctx->synth_history[11-j] = x;
-            *ptr++ = x;
-        }
-    }
+    memcpy(prefix, &ctx->fixed_gains[64-15], 15*sizeof(float));
+    memcpy(prefix + 15, ctx->rc, 12*sizeof(float));
+    memcpy(prefix + 27, ctx->synth_history, 12*sizeof(float));
 }
 
 /*
 ** Public functions.
 */
 
-static void utk_decode_frame(UTKContext *ctx)
+/* Parse one frame from the bitstream, including the excitation signal. This
+** touches only the bit reader and the header fields of ctx. */
+static void utk_parse_frame(UTKContext *ctx, UTKFrame *frame)
 {
-    int i, j;
-    int use_multipulse = 0;
-    float excitation[5+108+5];
-    float rc_delta[12];
+    int i;
 
-    if (!ctx->bits_count) {
-        ctx->bits_value = utk_read_byte(ctx);
-        ctx->bits_count = 8;
-    }
+    if (!ctx->bits_count)
+        utk_refill_bits(ctx);
 
     if (!ctx->parsed_header) {
         utk_parse_header(ctx);
         ctx->parsed_header = 1;
     }
 
-    memset(&excitation[0], 0, 5*sizeof(float));
-    memset(&excitation[5+108], 0, 5*sizeof(float));
+#ifdef UTK_STATS
+    memset(&ctx->stats, 0, sizeof(ctx->stats));
+    ctx->bits_read = 0;
+#endif
+
+    /* (the vectorized interpolation also reads, but discards, the samples
+    ** it is about to fill in, so clear the whole buffer) */
+    memset(frame->excitation, 0, sizeof(frame->excitation));
+    frame->use_multipulse = 0;
 
     /* read the reflection coefficients */
     for (i = 0; i < 12; i++) {
@@ -312,66 +351,130 @@ static void utk_decode_frame(UTKContext *ctx)
         if (i == 0) {
             idx = utk_read_bits(ctx, 6);
             if (idx < ctx->multipulse_thresh)
-                use_multipulse = 1;
+                frame->use_multipulse = 1;
         } else if (i < 4) {
             idx = utk_read_bits(ctx, 6);
         } else {
             idx = 16 + utk_read_bits(ctx, 5);
         }
 
-        rc_delta[i] = (utk_rc_table[idx] - ctx->rc[i])*0.25f;
+        frame->rc[i] = utk_rc_table[idx];
     }
 
     /* decode four subframes */
+    ctx->parse_subframes[frame->use_multipulse](ctx, frame);
+
+    UTK_STAT(ctx->stats.use_multipulse = frame->use_multipulse);
+}
+
+/* The adaptive codebook for the next frame: the last 324 samples of
+** excitation, oldest first. They are always contiguous in the ring, and can be
+** saved and restored through this pointer. */
+static float *utk_adapt_cb(UTKContext *ctx)
+{
+    return &ctx->cb_ring[(ctx->cb_pos + UTK_RING_SIZE - 324) % UTK_RING_SIZE];
+}
+
+/* Mix the adaptive codebook into the excitation of a parsed frame, and
+** advance the ring to the next frame. Returns the frame's 432 samples of
+** excitation, which stay valid until the next frame is mixed. This reads the
+** rc and synth_history of the previous frame (see utk_fill_cb_prefix). */
+static const float *utk_mix_frame(UTKContext *ctx, const UTKFrame *frame)
+{
+    float *out = &ctx->cb_ring[ctx->cb_pos];
+    int i;
+
+    if (frame->pitch_lag[0] > 216)
+        utk_fill_cb_prefix(ctx);
+
     for (i = 0; i < 4; i++) {
-        int pitch_lag = utk_read_bits(ctx, 8);
-        float pitch_gain = (float)utk_read_bits(ctx, 4)/15.0f;
-        float fixed_gain = ctx->fixed_gains[utk_read_bits(ctx, 6)];
+        int pos = ctx->cb_pos + 108*i - 108 - frame->pitch_lag[i];
 
-        if (!ctx->reduced_bw) {
-            utk_decode_excitation(ctx, use_multipulse, &excitation[5], 1);
-        } else {
-            /* residual (excitation) signal is encoded at reduced bandwidth */
-            int align = utk_read_bits(ctx, 1);
-            int zero = utk_read_bits(ctx, 1);
-
-            utk_decode_excitation(ctx, use_multipulse, &excitation[5+align], 2);
-
-            if (zero) {
-                /* fill the remaining samples with zero
-                ** (spectrum is duplicated into high frequencies) */
-                for (j = 0; j < 54; j++)
-                    excitation[5+(1-align)+2*j] = 0.0f;
-            } else {
-                /* interpolate the remaining samples
-                ** (spectrum is low-pass filtered) */
-                float *ptr = &excitation[5+(1-align)];
-                for (j = 0; j < 108; j += 2)
-                    ptr[j] =   ptr[j-5] * 0.01803267933428287506103515625f
-                             - ptr[j-3] * 0.114591561257839202880859375f
-                             + ptr[j-1] * 0.597385942935943603515625f
-                             + ptr[j+1] * 0.597385942935943603515625f
-                             - ptr[j+3] * 0.114591561257839202880859375f
-                             + ptr[j+5] * 0.01803267933428287506103515625f;
-
-                /* scale by 0.5f to give the sinc impulse response unit energy */
-                fixed_gain *= 0.5f;
-            }
-        }
+        if (pos < 0)
+            pos += UTK_RING_SIZE;
+
+        utk_pitch_mix(&out[108*i], &frame->excitation[i][5], &ctx->cb_ring[pos],
+                      frame->fixed_gain[i], frame->pitch_gain[i]);
 
-        for (j = 0; j < 108; j++)
-            ctx->decompressed_frame[108*i+j] =   fixed_gain * excitation[5+j]
-                                               + pitch_gain * ctx->adapt_cb[108*i+216-pitch_lag+j];
+        if (ctx->cb_pos == 0 && i == 0)
+            memcpy(&ctx->cb_ring[UTK_RING_SIZE], out, 108*sizeof(float));
     }
 
-    for (i = 0; i < 324; i++)
-        ctx->adapt_cb[i] = ctx->decompressed_frame[108+i];
+    ctx->cb_pos = 432 - ctx->cb_pos;
+
+    return out;
+}
+
+/* Reconstruct the output samples of a parsed frame into
+** ctx->decompressed_frame. */
+static void utk_synth_frame(UTKContext *ctx, const UTKFrame *frame)
+{
+    const float *excitation;
+    int i, j;
+    float rc_delta[12];
+
+    for (i = 0; i < 12; i++)
+        rc_delta[i] = (frame->rc[i] - ctx->rc[i])*0.25f;
+
+    excitation = utk_mix_frame(ctx, frame);
 
     for (i = 0; i < 4; i++) {
         for (j = 0; j < 12; j++)
             ctx->rc[j] += rc_delta[j];
 
-        utk_lp_synthesis_filter(ctx, 12*i, i < 3 ? 1 : 33);
+        utk_lp_synthesis_filter(ctx, excitation, 12*i, i < 3 ? 1 : 33);
+    }
+}
+
+static void utk_decode_frame(UTKContext *ctx)
+{
+    UTKFrame frame;
+
+    utk_parse_frame(ctx, &frame);
+    utk_synth_frame(ctx, &frame);
+
+#ifdef UTK_STATS
+    {
+        int i;
+
+        for (i = 0; i < 432; i++) {
+            if (ctx->decompressed_frame[i] >= 32767.5f || ctx->decompressed_frame[i] < -32768.5f)
+                ctx->stats.clipped++;
+        }
+
+        if (ctx->stats_hook)
+            ctx->stats_hook(ctx->stats_opaque, &ctx->stats);
+    }
+#endif
+}
+
+/* Decode frames until count samples have been written to out, as rounded
+** and saturated int16 samples. The samples of the last frame beyond count are
+** discarded, so count should be a multiple of 432 except at the end of the
+** stream. */
+static void utk_decode_s16(UTKContext *ctx, int16_t *out, size_t count)
+{
+    while (count > 0) {
+        int n = count < 432 ? (int)count : 432;
+
+        utk_decode_frame(ctx);
+        utk_convert_s16(out, ctx->decompressed_frame, n);
+        out += n;
+        count -= n;
+    }
+}
+
+/* Same as utk_decode_s16, but output float samples with int16 full scale
+** at +-1.0. These are not clipped. */
+static void utk_decode_f32(UTKContext *ctx, float *out, size_t count)
+{
+    while (count > 0) {
+        int n = count < 432 ? (int)count : 432;
+
+        utk_decode_frame(ctx);
+        utk_convert_f32(out, ctx->decompressed_frame, n);
+        out += n;
+        count -= n;
     }
 }
 
@@ -380,11 +483,16 @@ static void utk_init(UTKContext *ctx)
     memset(ctx, 0, sizeof(*ctx));
 }
 
-static void utk_set_fp(UTKContext *ctx, FILE *fp)
+/* Decode the bitstream read from fp, through file, which must stay valid
+** while ctx decodes from it. */
+static void utk_set_fp(UTKContext *ctx, FILE *fp, UTKFileBuffer *file)
 {
-    ctx->fp = fp;
+    file->fp = fp;
+    ctx->file = file;
 
     /* reset the bit reader */
+    ctx->overrun = 0;
+    ctx->bits_value = 0;
     ctx->bits_count = 0;
 }
 
@@ -392,16 +500,34 @@ static void utk_set_ptr(UTKContext *ctx, const uint8_t *ptr, const uint8_t *end)
 {
     ctx->ptr = ptr;
     ctx->end = end;
+    ctx->fp_buffered = 0;
 
     /* reset the bit reader */
+    ctx->overrun = 0;
+    ctx->bits_value = 0;
     ctx->bits_count = 0;
 }
 
+/* Point the bit reader at the given bit of the bitstream in [start, end),
+** as counted by utk_tell. Bits past the end read as zero. */
+static void utk_set_bit_ptr(UTKContext *ctx, const uint8_t *start, const uint8_t *end,
+                            uint64_t bit)
+{
+    uint64_t byte = bit >> 3;
+
+    utk_set_ptr(ctx, byte < (uint64_t)(end - start) ? start + (size_t)byte : end, end);
+    utk_refill_bits(ctx);
+    if (bit & 7)
+        utk_read_bits(ctx, bit & 7);
+}
+
 /*
 ** MicroTalk Revision 3 decoding function.
+** Returns UTK_OK, or UTK_ERR_BAD_PCM if the frame carries an out-of-range
+** PCM patch.
 */
 
-static void utk_rev3_decode_frame(UTKContext *ctx)
+static int utk_rev3_decode_frame(UTKContext *ctx)
 {
     int pcm_data_present = (utk_read_byte(ctx) == 0xee);
     int i;
@@ -409,8 +535,7 @@ static void utk_rev3_decode_frame(UTKContext *ctx)
     utk_decode_frame(ctx);
 
     /* unread the last 8 bits and reset the bit reader */
-    ctx->ptr--;
-    ctx->bits_count = 0;
+    utk_unread_bits(ctx);
 
     if (pcm_data_present) {
         /* Overwrite n samples at a given offset in the decoded frame with
@@ -421,17 +546,15 @@ static void utk_rev3_decode_frame(UTKContext *ctx)
         /* sx.exe does not do any bounds checking or clamping of these two
         ** fields (see 004274D1 in sx.exe v3.01.01), which means a specially
         ** crafted MT5:1 file can crash sx.exe.
-        ** We will throw an error instead. */
-        if (offset < 0 || offset > 432) {
-            fprintf(stderr, "error: invalid PCM offset %d\n", offset);
-            exit(EXIT_FAILURE);
-        }
-        if (count < 0 || count > 432 - offset) {
-            fprintf(stderr, "error: invalid PCM count %d\n", count);
-            exit(EXIT_FAILURE);
-        }
+        ** We will return an error instead. */
+        if (offset < 0 || offset > 432 || count < 0 || count > 432 - offset)
+            return UTK_ERR_BAD_PCM;
 
         for (i = 0; i < count; i++)
             ctx->decompressed_frame[offset+i] = (float)utk_read_i16(ctx);
     }
+
+    return UTK_OK;
 }
+
+#endif
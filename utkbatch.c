@@ -0,0 +1,421 @@
+/*
+** utkbatch
+** Decode many MicroTalk files (Maxis UTK, PT/M10 and SCxl) to wav at once.
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
+**          -g0 -s -pthread -o utkbatch utkbatch.c libutk.c
+**          (POSIX only: uses pthreads)
+*/
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h and pthreads */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "libutk.h"
+#include "io.h"
+
+#define MAX_JOBS 64
+
+/* samples decoded per write; a multiple of the 432-sample frame */
+#define UTK_BLOCK_SAMPLES (16*432)
+
+typedef struct Job {
+    const char *path;
+    char *out_path;
+    size_t file_size; /* for scheduling; 0 if unknown */
+    int done;
+    int duplicate;    /* another input has the same output name */
+    int io_error;     /* errno value */
+    const char *io_what;
+    int error;        /* UTK_* error code */
+    UTKStreamInfo info;
+    uint64_t out_size;
+} Job;
+
+static Job *jobs;
+static size_t num_jobs;
+static size_t *order;  /* the jobs to start, largest input first */
+static size_t next_job;
+static int force;
+static int use_float;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "error: %s\n", what);
+    exit(EXIT_FAILURE);
+}
+
+/*
+** Decoding.
+*/
+
+typedef struct Worker {
+    UTKDecoder *dec;
+    int16_t pcm[UTK_BLOCK_SAMPLES];
+    float pcm_float[UTK_BLOCK_SAMPLES];
+} Worker;
+
+/* Decode the open stream into out. */
+static int decode_samples(Worker *w, OutputFile *out, uint32_t num_samples)
+{
+    while (num_samples > 0) {
+        size_t count = num_samples < UTK_BLOCK_SAMPLES ? num_samples : UTK_BLOCK_SAMPLES;
+        size_t n;
+        int ret;
+
+        if (use_float) {
+            ret = utk_decoder_read_f32(w->dec, w->pcm_float, count, &n);
+            output_f32(out, w->pcm_float, n);
+        } else {
+            ret = utk_decoder_read_s16(w->dec, w->pcm, count, &n);
+            output_s16(out, w->pcm, n);
+        }
+
+        if (ret != UTK_OK)
+            return ret;
+        if (n == 0)
+            return UTK_ERR_EOF;
+
+        num_samples -= (uint32_t)n;
+    }
+
+    return UTK_OK;
+}
+
+static void decode_file(Worker *w, Job *job)
+{
+    uint8_t header[WAV_MAX_HEADER_SIZE];
+    InputFile in;
+    OutputFile out;
+    int ret;
+
+    job->io_what = "read";
+    job->io_error = load_input(&in, job->path);
+    if (job->io_error)
+        return;
+
+    job->error = utk_decoder_open(w->dec, in.data, in.size);
+    if (job->error == UTK_OK)
+        job->error = utk_decoder_get_info(w->dec, &job->info);
+    if (job->error != UTK_OK) {
+        close_input(&in);
+        return;
+    }
+
+    job->io_what = "create";
+    job->io_error = create_output(&out, job->out_path, force);
+    if (job->io_error) {
+        close_input(&in);
+        return;
+    }
+
+    job->out_size = wav_file_size(job->info.num_samples, use_float);
+    make_wav_header(header, job->info.sample_rate, job->info.num_samples, use_float);
+    output_bytes(&out, header, wav_header_size(job->info.num_samples, use_float));
+    output_map(&out, job->out_size);
+
+    job->error = decode_samples(w, &out, job->info.num_samples);
+
+    job->io_what = "write";
+    ret = finish_output(&out);
+    if (job->error == UTK_OK)
+        job->io_error = ret;
+
+    /* don't leave truncated files behind */
+    if (job->error != UTK_OK || job->io_error)
+        remove(job->out_path);
+
+    close_input(&in);
+}
+
+static void *worker(void *arg)
+{
+    Worker *w = malloc(sizeof(*w));
+
+    (void)arg;
+    if (!w || !(w->dec = utk_decoder_create(NULL)))
+        fail("out of memory");
+
+    for (;;) {
+        Job *job;
+
+        pthread_mutex_lock(&lock);
+        if (next_job == num_jobs) {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        job = &jobs[order[next_job++]];
+        pthread_mutex_unlock(&lock);
+
+        if (!job->duplicate)
+            decode_file(w, job);
+
+        pthread_mutex_lock(&lock);
+        job->done = 1;
+        pthread_cond_broadcast(&job_done);
+        pthread_mutex_unlock(&lock);
+    }
+
+    utk_decoder_destroy(w->dec);
+    free(w);
+
+    return NULL;
+}
+
+/*
+** File list.
+*/
+
+/* The output path: outdir/name.wav, where name is the input file name
+** without its extension. */
+static char *make_out_path(const char *outdir, const char *path)
+{
+    const char *name = strrchr(path, '/') ? strrchr(path, '/') + 1 : path;
+    const char *ext = strrchr(name, '.');
+    size_t len = (ext && ext != name) ? (size_t)(ext - name) : strlen(name);
+    char *out = malloc(strlen(outdir) + len + 6);
+
+    if (!out)
+        fail("out of memory");
+
+    sprintf(out, "%s/%.*s.wav", outdir, (int)len, name);
+
+    return out;
+}
+
+static void add_path(const char *path)
+{
+    static size_t capacity;
+    char *copy;
+
+    if (num_jobs == capacity) {
+        Job *p;
+
+        capacity = capacity ? 2*capacity : 256;
+        p = realloc(jobs, capacity * sizeof(*jobs));
+        if (!p)
+            fail("out of memory");
+        jobs = p;
+    }
+
+    copy = malloc(strlen(path) + 1);
+    if (!copy)
+        fail("out of memory");
+    strcpy(copy, path);
+
+    memset(&jobs[num_jobs], 0, sizeof(*jobs));
+    jobs[num_jobs].path = copy;
+    num_jobs++;
+}
+
+/* Add every line of a manifest file ("-" for stdin) as an input path. */
+static void add_manifest(const char *path)
+{
+    InputFile in;
+    char *text, *line, *end;
+
+    open_input(&in, path);
+
+    text = malloc(in.size + 1);
+    if (!text)
+        fail("out of memory");
+    memcpy(text, in.data, in.size);
+    text[in.size] = '\0';
+    close_input(&in);
+
+    for (line = text; *line; line = end) {
+        size_t len;
+
+        end = line + strcspn(line, "\n");
+        len = end - line;
+        if (*end)
+            *end++ = '\0';
+
+        if (len > 0 && line[len-1] == '\r')
+            line[--len] = '\0';
+        if (len > 0)
+            add_path(line);
+    }
+
+    free(text);
+}
+
+static int compare_size(const void *a, const void *b)
+{
+    const Job *x = &jobs[*(const size_t *)a], *y = &jobs[*(const size_t *)b];
+
+    if (x->file_size != y->file_size)
+        return x->file_size < y->file_size ? 1 : -1;
+    return (*(const size_t *)a > *(const size_t *)b) - (*(const size_t *)a < *(const size_t *)b);
+}
+
+static int compare_out_path(const void *a, const void *b)
+{
+    int ret = strcmp(jobs[*(const size_t *)a].out_path, jobs[*(const size_t *)b].out_path);
+
+    if (ret)
+        return ret;
+    return (*(const size_t *)a > *(const size_t *)b) - (*(const size_t *)a < *(const size_t *)b);
+}
+
+/*
+** Reporting.
+*/
+
+static void print_job(const Job *job)
+{
+    printf("%s: ", job->path);
+
+    if (job->duplicate)
+        printf("error: output name '%s' is used by an earlier file\n", job->out_path);
+    else if (job->io_error == EEXIST && !force && !strcmp(job->io_what, "create"))
+        printf("error: '%s' already exists\n", job->out_path);
+    else if (job->io_error)
+        printf("error: failed to %s '%s': %s\n", job->io_what,
+               strcmp(job->io_what, "read") ? job->out_path : job->path,
+               strerror(job->io_error));
+    else if (job->error != UTK_OK)
+        printf("error: %s\n", utk_strerror(job->error));
+    else
+        printf("%lu samples -> %s\n", (unsigned long)job->info.num_samples, job->out_path);
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[MAX_JOBS];
+    struct timespec t0, t1;
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+    const char *outdir = NULL;
+    size_t i, num_errors = 0;
+    double in_bytes = 0, out_bytes = 0, frames = 0, seconds;
+    int quiet = 0;
+    struct stat st;
+
+    /* Parse arguments. */
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+        if (!strcmp(argv[1], "-f")) {
+            force = 1;
+        } else if (!strcmp(argv[1], "--float")) {
+            use_float = 1;
+        } else if (!strcmp(argv[1], "-q")) {
+            quiet = 1;
+        } else if (!strcmp(argv[1], "-j") && argc > 2) {
+            num_threads = atol(argv[2]);
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "-o") && argc > 2) {
+            outdir = argv[2];
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "-l") && argc > 2) {
+            add_manifest(argv[2]);
+            argv++, argc--;
+        } else {
+            break;
+        }
+        argv++, argc--;
+    }
+
+    for (i = 1; i < (size_t)argc; i++)
+        add_path(argv[i]);
+
+    if (!outdir || num_jobs == 0 || (argc > 1 && argv[1][0] == '-')) {
+        printf("Usage: utkbatch [-f] [--float] [-q] [-j jobs] [-l list] -o outdir [file...]\n");
+        printf("Decode Maxis UTK, PT/M10 and SCxl files to wav files in outdir, several\n");
+        printf("at once. Each output is named after its input, with the extension .wav.\n");
+        printf("  -f       overwrite existing files\n");
+        printf("  --float  write 32-bit float instead of 16-bit wav files\n");
+        printf("  -q       only list files with errors\n");
+        printf("  -j       number of files to decode at once (default: number of CPUs)\n");
+        printf("  -l       also decode the files listed in list, one per line (- for stdin)\n");
+        return EXIT_FAILURE;
+    }
+
+    if (stat(outdir, &st) != 0 || !S_ISDIR(st.st_mode)) {
+        fprintf(stderr, "error: '%s' is not a directory\n", outdir);
+        return EXIT_FAILURE;
+    }
+
+    order = malloc(num_jobs * sizeof(*order));
+    if (!order)
+        fail("out of memory");
+
+    for (i = 0; i < num_jobs; i++) {
+        jobs[i].out_path = make_out_path(outdir, jobs[i].path);
+        if (stat(jobs[i].path, &st) == 0)
+            jobs[i].file_size = (size_t)st.st_size;
+        order[i] = i;
+    }
+
+    /* Only the first input that maps to each output name is decoded. */
+    qsort(order, num_jobs, sizeof(*order), compare_out_path);
+    for (i = 1; i < num_jobs; i++) {
+        if (!strcmp(jobs[order[i]].out_path, jobs[order[i-1]].out_path))
+            jobs[order[i]].duplicate = 1;
+    }
+
+    /* Start the largest files first, so that a few long files at the end of
+    ** the list don't leave one thread working while the others are idle. */
+    qsort(order, num_jobs, sizeof(*order), compare_size);
+
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > MAX_JOBS)
+        num_threads = MAX_JOBS;
+    if ((size_t)num_threads > num_jobs)
+        num_threads = (long)num_jobs;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (i = 0; i < (size_t)num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0)
+            fail("failed to create thread");
+    }
+
+    /* Print the results in order as they come in. */
+    for (i = 0; i < num_jobs; i++) {
+        Job *job = &jobs[i];
+        int has_error;
+
+        pthread_mutex_lock(&lock);
+        while (!job->done)
+            pthread_cond_wait(&job_done, &lock);
+        pthread_mutex_unlock(&lock);
+
+        has_error = job->duplicate || job->io_error || job->error != UTK_OK;
+        if (!quiet || has_error)
+            print_job(job);
+
+        if (has_error) {
+            num_errors++;
+        } else {
+            in_bytes += job->file_size;
+            out_bytes += job->out_size;
+            frames += (job->info.num_samples + 431) / 432;
+        }
+    }
+
+    for (i = 0; i < (size_t)num_threads; i++)
+        pthread_join(threads[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)*1e-9;
+    if (seconds <= 0)
+        seconds = 1e-9;
+
+    fflush(stdout);
+
+    fprintf(stderr, "%lu files, %lu with errors, %.0f frames, %.1f MB in, %.1f MB out in %.2f s\n",
+            (unsigned long)num_jobs, (unsigned long)num_errors, frames,
+            in_bytes/1e6, out_bytes/1e6, seconds);
+    fprintf(stderr, "%.0f frames/s, %.1f MB/s in, %.1f MB/s out\n",
+            frames/seconds, in_bytes/1e6/seconds, out_bytes/1e6/seconds);
+
+    return num_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
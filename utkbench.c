@@ -0,0 +1,1014 @@
+/*
+** utkbench
+** Benchmark decoding MicroTalk (Maxis UTK, PT/M10 and SCxl).
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
+**          -fwhole-program -g0 -s -o utkbench utkbench.c -lm
+*/
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <math.h>
+#include "utk.h"
+#include "utkscan.h"
+#include "utkresample.h"
+#include "utkpar.h"
+#include "utkmix.h"
+#include "io.h"
+#include "eachunk.h"
+
+#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((uint32_t)(d)<<24))
+#define MIN(x,y) ((x)<(y)?(x):(y))
+
+/* frames recorded for the per-stage measurements */
+#define MAX_RECORDS 1024
+
+/* each measurement is the best of this many */
+#define ROUNDS 5
+
+/* segment length in the warm-up measurements */
+#define WARMUP_SEGMENT_FRAMES 64
+
+/* mix block in the mixing measurements; 27 blocks of 256 samples are 16
+** frames, so voices started on each of 27 consecutive blocks decode their
+** frames at 27 different points of a block */
+#define MIX_BLOCK 256
+#define MIX_STAGGER 27
+
+#if defined(UTK_SIMD_AVX)
+#define KERNELS "avx"
+#elif defined(UTK_SIMD_SSE2)
+#define KERNELS "sse2"
+#else
+#define KERNELS "c"
+#endif
+
+/* One bitstream of a file: the whole stream after the header for Maxis UTK
+** and PT, or the payload of one SCDl chunk for SCxl. */
+typedef struct Segment {
+    const uint8_t *ptr, *end;
+    uint32_t num_samples;
+} Segment;
+
+/* A frame, as recorded for the per-stage measurements: where its fields
+** are, and the inputs of its rc_to_lpc and synthesis filter calls. */
+typedef struct FrameRecord {
+    uint32_t segment;
+    uint32_t bit;               /* after any Rev. 3 flag byte and stream header */
+    uint32_t subframe_bit[4];
+    uint32_t excitation_bit[4];
+    int align[4];               /* reduced bandwidth only */
+    int use_multipulse;
+    float rc[4][12];
+    float lpc[4][12];
+    float history[12];
+    float samples[432];
+} FrameRecord;
+
+typedef struct Bench {
+    /* the stream */
+    char container[16];
+    uint32_t sample_rate;
+    uint32_t num_samples;
+    uint32_t num_frames;
+    int rev3;
+    Segment *segments;
+    uint32_t num_segments;
+
+    UTKContext utk;
+    UTKContext scratch;
+    FrameRecord *records;
+    uint32_t num_records;
+    UTKFrame frame;
+    float buffer[5+108+5];
+    float lpc[12];
+    int16_t pcm[432];
+    uint64_t checksum;
+
+    /* resampling */
+    uint32_t out_rate;
+    int quality;
+    UTKResampler resampler;
+    float *decoded;   /* num_samples */
+    float *resampled; /* utk_resample_length(num_samples) */
+    float *fused;
+} Bench;
+
+static double bench_seconds = 0.5;
+
+static void check(int ret)
+{
+    if (ret != UTK_OK) {
+        fprintf(stderr, "error: %s\n", utk_error_string(ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+static void *alloc(size_t size)
+{
+    void *p = malloc(size);
+
+    if (!p)
+        check(UTK_ERR_NOMEM);
+
+    return p;
+}
+
+/*
+** Containers.
+*/
+
+static int add_segment(Bench *b, const uint8_t *ptr, const uint8_t *end, uint32_t num_samples)
+{
+    Segment *s = realloc(b->segments, (b->num_segments + 1) * sizeof(*s));
+
+    if (!s)
+        return UTK_ERR_NOMEM;
+
+    b->segments = s;
+    s[b->num_segments].ptr = ptr;
+    s[b->num_segments].end = end;
+    s[b->num_segments].num_samples = num_samples;
+    b->num_segments++;
+    b->num_frames += (num_samples + 431) / 432;
+
+    return UTK_OK;
+}
+
+static int open_utm0(Bench *b, const uint8_t *data, size_t size)
+{
+    uint32_t dwOutSize;
+
+    if (size < 32)
+        return UTK_ERR_EOF;
+
+    dwOutSize = get_u32(data+4);
+    if ((dwOutSize & 0x01) != 0
+        || get_u32(data+8) != 20 || get_u16(data+12) != 1)
+        return UTK_ERR_BAD_HEADER;
+
+    strcpy(b->container, "UTM0");
+    b->sample_rate = get_u32(data+16);
+    b->num_samples = dwOutSize/2;
+
+    if (get_u16(data+14) != 1 || b->sample_rate < 8000 || b->sample_rate > 192000)
+        return UTK_ERR_UNSUPPORTED;
+
+    return add_segment(b, data + 32, data + size, b->num_samples);
+}
+
+static int open_pt(Bench *b, const uint8_t *data, size_t size)
+{
+    EAStream s;
+    int ret;
+
+    ret = ea_open_pt(&s, data, size);
+
+    if (s.parsed_header) {
+        strcpy(b->container, "PT");
+        b->sample_rate = 22050;
+        b->num_samples = s.hdr.num_samples;
+    }
+
+    if (ret != UTK_OK)
+        return ret;
+
+    return add_segment(b, s.next, s.end, b->num_samples);
+}
+
+static int open_scxl(Bench *b, const uint8_t *data, size_t size)
+{
+    EAStream s;
+    EADataChunk chunk;
+    int ret;
+
+    ret = ea_open_scxl(&s, data, size);
+
+    if (s.parsed_header) {
+        sprintf(b->container, "SCxl rev %u", (unsigned)MIN(s.hdr.codec_revision, 99));
+        b->sample_rate = 22050;
+        b->num_samples = s.hdr.num_samples;
+        b->rev3 = s.hdr.codec_revision >= 3;
+    }
+
+    if (ret != UTK_OK)
+        return ret;
+
+    while ((ret = ea_next_data_chunk(&s, &chunk)) == UTK_OK) {
+        ret = add_segment(b, chunk.ptr, chunk.end, chunk.num_samples);
+        if (ret != UTK_OK)
+            return ret;
+    }
+
+    return s.chunks_left == 0 ? UTK_OK : ret;
+}
+
+static int open_stream(Bench *b, const uint8_t *data, size_t size)
+{
+    uint32_t sig = size >= 4 ? get_u32(data) : 0;
+
+    if (sig == MAKE_U32('U','T','M','0'))
+        return open_utm0(b, data, size);
+    else if (sig == MAKE_U32('S','C','H','l'))
+        return open_scxl(b, data, size);
+    else if ((sig & 0xffff) == MAKE_U32('P','T','\x00','\x00'))
+        return open_pt(b, data, size);
+
+    return UTK_ERR_BAD_SIGNATURE;
+}
+
+/*
+** End-to-end decoding.
+*/
+
+static int decode_frame(Bench *b)
+{
+    if (b->rev3)
+        return utk_rev3_decode_frame(&b->utk);
+
+    utk_decode_frame(&b->utk);
+    return UTK_OK;
+}
+
+/* Decode the whole stream to int16, as utkdecode does. */
+static void decode(Bench *b)
+{
+    uint32_t i, j;
+
+    utk_init(&b->utk);
+
+    for (i = 0; i < b->num_segments; i++) {
+        const Segment *s = &b->segments[i];
+
+        utk_set_ptr(&b->utk, s->ptr, s->end);
+        for (j = 0; j < s->num_samples; j += 432) {
+            decode_frame(b);
+            utk_convert_s16(b->pcm, b->utk.decompressed_frame, (int)MIN(s->num_samples - j, 432));
+        }
+    }
+}
+
+/* FNV-1a over the int16 output, as little-endian bytes. Returns UTK_OK or
+** the first decoding error. */
+static int compute_checksum(Bench *b)
+{
+    uint64_t h = ((uint64_t)0xcbf29ce4 << 32) | 0x84222325;
+    const uint64_t prime = ((uint64_t)0x100 << 32) | 0x1b3;
+    uint32_t i, j;
+    int k, ret = UTK_OK;
+
+    utk_init(&b->utk);
+
+    for (i = 0; i < b->num_segments; i++) {
+        const Segment *s = &b->segments[i];
+
+        utk_set_ptr(&b->utk, s->ptr, s->end);
+        for (j = 0; j < s->num_samples; j += 432) {
+            int n = (int)MIN(s->num_samples - j, 432);
+
+            if (ret == UTK_OK)
+                ret = decode_frame(b);
+            utk_convert_s16(b->pcm, b->utk.decompressed_frame, n);
+
+            for (k = 0; k < n; k++) {
+                h = (h ^ ((uint16_t)b->pcm[k] & 0xff)) * prime;
+                h = (h ^ ((uint16_t)b->pcm[k] >> 8)) * prime;
+            }
+        }
+    }
+
+    b->checksum = h;
+
+    return ret;
+}
+
+/*
+** Per-stage measurements.
+**
+** The stages are timed separately, each in a loop over the first
+** MAX_RECORDS frames: the bit reader is pointed at the recorded position of
+** a frame or subframe, and the stage is run on its own. Moving the bit
+** reader is timed in the same way and subtracted.
+**
+** The bit parsing stage reads the fields of each frame and subframe, as
+** utk_parse_frame does, and moves the bit reader past the excitation
+** instead of decoding it. What is left of the whole decoder (the pitch mix,
+** the interpolation at reduced bandwidth, copies and Rev. 3 PCM patches) is
+** the total less the stages. Each of these is a difference of measurements
+** made separately, with warm caches, so it is off by up to a few ns; one
+** that comes out below zero is within that error, and is shown as 0 and
+** flagged.
+*/
+
+static void seek_bits(UTKContext *ctx, const Segment *s, uint32_t bit)
+{
+    utk_set_bit_ptr(ctx, s->ptr, s->end, bit);
+}
+
+/* Decode the first frames, recording each one. The scratch context is left
+** with the stream header fields. */
+static void record_frames(Bench *b)
+{
+    UTKContext *ctx = &b->utk, *s = &b->scratch;
+    uint32_t i, j;
+    int k;
+
+    utk_init(ctx);
+    b->num_records = 0;
+
+    for (i = 0; i < b->num_segments && b->num_records < MAX_RECORDS; i++) {
+        const Segment *seg = &b->segments[i];
+
+        utk_set_ptr(ctx, seg->ptr, seg->end);
+
+        for (j = 0; j < seg->num_samples && b->num_records < MAX_RECORDS; j += 432) {
+            FrameRecord *r = &b->records[b->num_records++];
+            uint32_t start = utk_tell(ctx, seg->ptr) + (b->rev3 ? 8 : 0);
+            float rc[12], delta[12];
+            UTKFrameInfo info;
+            uint32_t bit;
+
+            r->segment = i;
+            memcpy(rc, ctx->rc, sizeof(rc));
+            memcpy(r->history, ctx->synth_history, sizeof(r->history));
+
+            /* find the fields of the frame */
+            *s = *ctx;
+            seek_bits(s, seg, start);
+            if (!s->parsed_header) {
+                utk_parse_header(s);
+                s->parsed_header = 1;
+            }
+            r->bit = utk_tell(s, seg->ptr);
+
+            utk_scan_frame(s, seg->ptr, &info);
+            bit = r->bit + 64; /* after the reflection coefficients */
+            for (k = 0; k < 4; k++) {
+                r->subframe_bit[k] = bit;
+                r->excitation_bit[k] = bit + 18 + (s->reduced_bw ? 2 : 0);
+                r->align[k] = 0;
+                if (s->reduced_bw) {
+                    seek_bits(s, seg, bit + 18);
+                    r->align[k] = utk_read_bits(s, 1);
+                }
+                bit += info.subframe_bits[k];
+            }
+
+            seek_bits(s, seg, r->bit);
+            utk_parse_frame(s, &b->frame);
+            r->use_multipulse = b->frame.use_multipulse;
+
+            /* the interpolated reflection coefficients of each subframe, as
+            ** in utk_synth_frame */
+            for (k = 0; k < 12; k++)
+                delta[k] = (b->frame.rc[k] - rc[k])*0.25f;
+            for (k = 0; k < 4; k++) {
+                int m;
+
+                for (m = 0; m < 12; m++)
+                    rc[m] += delta[m];
+                memcpy(r->rc[k], rc, sizeof(rc));
+                rc_to_lpc(r->rc[k], r->lpc[k]);
+            }
+
+            decode_frame(b);
+
+            /* (the output stands in for the filter's input, which has a
+            ** similar range) */
+            memcpy(r->samples, ctx->decompressed_frame, sizeof(r->samples));
+        }
+    }
+}
+
+static void stage_seek_frames(Bench *b)
+{
+    uint32_t i;
+
+    for (i = 0; i < b->num_records; i++) {
+        const FrameRecord *r = &b->records[i];
+        seek_bits(&b->scratch, &b->segments[r->segment], r->bit);
+    }
+}
+
+/* The fields of each frame and subframe, without the excitation. */
+static void stage_fields(Bench *b)
+{
+    UTKContext *ctx = &b->scratch;
+    UTKFrame *frame = &b->frame;
+    uint32_t i;
+    int k;
+
+    for (i = 0; i < b->num_records; i++) {
+        const FrameRecord *r = &b->records[i];
+        const Segment *s = &b->segments[r->segment];
+
+        seek_bits(ctx, s, r->bit);
+        frame->use_multipulse = 0;
+        for (k = 0; k < 12; k++) {
+            int idx;
+
+            if (k < 4) {
+                idx = utk_read_bits(ctx, 6);
+                if (k == 0 && idx < ctx->multipulse_thresh)
+                    frame->use_multipulse = 1;
+            } else {
+                idx = 16 + utk_read_bits(ctx, 5);
+            }
+            frame->rc[k] = utk_rc_table[idx];
+        }
+
+        for (k = 0; k < 4; k++) {
+            seek_bits(ctx, s, r->subframe_bit[k]);
+            frame->pitch_lag[k] = utk_read_bits(ctx, 8);
+            frame->pitch_gain[k] = (float)utk_read_bits(ctx, 4)/15.0f;
+            frame->fixed_gain[k] = ctx->fixed_gains[utk_read_bits(ctx, 6)];
+            if (ctx->reduced_bw)
+                utk_read_bits(ctx, 2); /* align and zero */
+        }
+    }
+}
+
+static void stage_seek_subframes(Bench *b)
+{
+    uint32_t i;
+    int k;
+
+    for (i = 0; i < b->num_records; i++) {
+        const FrameRecord *r = &b->records[i];
+        for (k = 0; k < 4; k++)
+            seek_bits(&b->scratch, &b->segments[r->segment], r->excitation_bit[k]);
+    }
+}
+
+static void stage_excitation(Bench *b)
+{
+    int stride = b->scratch.reduced_bw ? 2 : 1;
+    uint32_t i;
+    int k;
+
+    for (i = 0; i < b->num_records; i++) {
+        const FrameRecord *r = &b->records[i];
+
+        for (k = 0; k < 4; k++) {
+            seek_bits(&b->scratch, &b->segments[r->segment], r->excitation_bit[k]);
+            utk_decode_excitation(&b->scratch, r->use_multipulse,
+                                  &b->buffer[5 + r->align[k]], stride);
+        }
+    }
+}
+
+static void stage_rc_to_lpc(Bench *b)
+{
+    uint32_t i;
+    int k;
+
+    for (i = 0; i < b->num_records; i++) {
+        for (k = 0; k < 4; k++)
+            rc_to_lpc(b->records[i].rc[k], b->lpc);
+    }
+}
+
+static void stage_synthesis(Bench *b)
+{
+    float *samples = b->utk.decompressed_frame;
+    float *history = b->utk.synth_history;
+    uint32_t i;
+    int k;
+
+    for (i = 0; i < b->num_records; i++) {
+        const FrameRecord *r = &b->records[i];
+
+        memcpy(history, r->history, sizeof(r->history));
+        for (k = 0; k < 4; k++)
+            utk_synthesize(&samples[12*k], &r->samples[12*k], k < 3 ? 1 : 33, r->lpc[k], history);
+    }
+}
+
+/* A stage time that is a difference of measurements. One below zero is
+** returned as 0, and its name is added to flagged (a '+'-separated list). */
+static double estimate(double seconds, char *flagged, const char *name)
+{
+    if (seconds >= 0)
+        return seconds;
+
+    if (flagged[0])
+        strcat(flagged, "+");
+    strcat(flagged, name);
+
+    return 0;
+}
+
+/* Run fn repeatedly, in ROUNDS rounds. Returns its average time in seconds
+** in the fastest round, which is the least disturbed by other processes. */
+static double run(Bench *b, void (*fn)(Bench *))
+{
+    double best = 0;
+    int i;
+
+    for (i = 0; i < ROUNDS; i++) {
+        clock_t start = clock(), elapsed;
+        long runs = 0;
+        double seconds;
+
+        do {
+            fn(b);
+            runs++;
+            elapsed = clock() - start;
+        } while (elapsed < (clock_t)(bench_seconds / ROUNDS * CLOCKS_PER_SEC));
+
+        seconds = (double)elapsed / CLOCKS_PER_SEC / runs;
+        if (i == 0 || seconds < best)
+            best = seconds;
+    }
+
+    return best;
+}
+
+/*
+** Resampling.
+*/
+
+static void decode_f32(Bench *b)
+{
+    utk_init(&b->utk);
+    utk_set_ptr(&b->utk, b->segments[0].ptr, b->segments[0].end);
+    utk_decode_f32(&b->utk, b->decoded, b->num_samples);
+}
+
+/* decode the whole stream, then resample it in a separate pass */
+static void decode_then_resample(Bench *b)
+{
+    int n;
+
+    decode_f32(b);
+
+    utk_resample_reset(&b->resampler);
+    n = utk_resample(&b->resampler, b->decoded, (int)b->num_samples, b->resampled);
+    utk_resample_flush(&b->resampler, &b->resampled[n]);
+}
+
+/* resample each frame as it is decoded */
+static void decode_resampled(Bench *b)
+{
+    utk_init(&b->utk);
+    utk_set_ptr(&b->utk, b->segments[0].ptr, b->segments[0].end);
+    utk_resample_reset(&b->resampler);
+    utk_decode_resampled_f32(&b->utk, &b->resampler, b->num_samples, b->fused,
+                             utk_resample_length(&b->resampler, b->num_samples));
+}
+
+static void print_time(Bench *b, const char *name, double seconds)
+{
+    printf("  %-24s %9.2f ms %9.1fx realtime\n", name, seconds * 1e3,
+           (double)b->num_samples / b->sample_rate / seconds);
+}
+
+static void bench_resampling(Bench *b)
+{
+    static const char *quality_names[3] = {"fast", "medium", "best"};
+    uint32_t length, i;
+    double max_diff = 0;
+
+    if (b->num_segments != 1 || b->rev3) {
+        printf("  (resampling is only measured on Maxis UTK and PT files)\n");
+        return;
+    }
+
+    check(utk_resample_init(&b->resampler, b->sample_rate, b->out_rate, b->quality));
+    length = utk_resample_length(&b->resampler, b->num_samples);
+
+    b->decoded = alloc(b->num_samples * sizeof(float));
+    b->resampled = alloc((length + utk_resample_max_output(&b->resampler, b->resampler.taps)) * sizeof(float));
+    b->fused = alloc(length * sizeof(float));
+
+    printf("  resampling to %lu Hz (%s, %d taps):\n", (unsigned long)b->out_rate,
+           quality_names[b->quality], b->resampler.taps);
+
+    print_time(b, "decode", run(b, decode_f32));
+    print_time(b, "decode, then resample", run(b, decode_then_resample));
+    print_time(b, "decode and resample", run(b, decode_resampled));
+
+    /* the two differ only in rounding */
+    for (i = 0; i < length; i++) {
+        double diff = fabs(b->resampled[i] - b->fused[i]);
+        if (diff > max_diff)
+            max_diff = diff;
+    }
+    printf("  max difference: %g\n", max_diff);
+
+    free(b->decoded);
+    free(b->resampled);
+    free(b->fused);
+    utk_resample_free(&b->resampler);
+}
+
+/*
+** Approximate parallel decoding.
+*/
+
+static void plan_segments(Bench *b)
+{
+    UTKParPlan plan;
+
+    check(utk_par_plan(&plan, b->segments[0].ptr, b->segments[0].end, b->num_samples,
+                       b->num_frames, 0));
+    utk_par_free(&plan);
+}
+
+/* Compare the approximate parallel decode (utkpar.h) with the exact one,
+** for several numbers of warm-up frames, over many segment boundaries. */
+static void bench_warmup(Bench *b)
+{
+    static const uint32_t warmups[] = {0, 1, 2, 3, 4, 6, 8, 12, 16, 24, 32};
+    const Segment *s = &b->segments[0];
+    uint32_t num_segments = (b->num_frames + WARMUP_SEGMENT_FRAMES - 1) / WARMUP_SEGMENT_FRAMES;
+    int16_t *exact, *approx;
+    size_t k;
+
+    if (b->num_segments != 1 || b->rev3) {
+        printf("  (warm-up is only measured on Maxis UTK and PT files)\n");
+        return;
+    }
+
+    exact = alloc(b->num_samples * sizeof(int16_t) + 1);
+    approx = alloc(b->num_samples * sizeof(int16_t) + 1);
+
+    utk_init(&b->utk);
+    utk_set_ptr(&b->utk, s->ptr, s->end);
+    utk_decode_s16(&b->utk, exact, b->num_samples);
+
+    printf("  scan for the parallel decode: %.0f ns/frame\n",
+           run(b, plan_segments) / b->num_frames * 1e9);
+    printf("  parallel decode in %lu segments of %d frames, against the exact decode:\n",
+           (unsigned long)num_segments, WARMUP_SEGMENT_FRAMES);
+
+    for (k = 0; k < sizeof(warmups)/sizeof(warmups[0]); k++) {
+        UTKParPlan plan;
+        uint32_t i, differ = 0, extra = 0;
+        int max_diff = 0;
+        double sum_sq = 0;
+
+        check(utk_par_plan(&plan, s->ptr, s->end, b->num_samples, num_segments, warmups[k]));
+
+        for (i = 0; i < plan.num_segments; i++) {
+            utk_par_decode_s16(&b->utk, &plan, i, s->ptr, s->end, approx);
+            extra += plan.segments[i].first_frame - plan.segments[i].start_frame;
+        }
+
+        for (i = 0; i < b->num_samples; i++) {
+            int diff = abs(exact[i] - approx[i]);
+
+            if (diff > max_diff)
+                max_diff = diff;
+            differ += diff != 0;
+            sum_sq += (double)diff * diff;
+        }
+
+        printf("  warm-up %2lu frames: max diff %5d, rms %8.3f, %6.3f%% samples differ, %5.1f%% more frames\n",
+               (unsigned long)warmups[k], max_diff, sqrt(sum_sq / b->num_samples),
+               100.0 * differ / b->num_samples, 100.0 * extra / b->num_frames);
+
+        utk_par_free(&plan);
+    }
+
+    free(exact);
+    free(approx);
+}
+
+/*
+** Mixing.
+*/
+
+static double now(void)
+{
+    struct timespec t;
+
+    clock_gettime(CLOCK_MONOTONIC, &t);
+    return t.tv_sec + t.tv_nsec * 1e-9;
+}
+
+/* Mix num_voices voices of the stream (utkmix.h), each restarted as soon
+** as it finishes, and time each mix block. */
+static void bench_mixing(Bench *b, int num_voices)
+{
+    const Segment *s = &b->segments[0];
+    float bus[2*MIX_BLOCK];
+    double block_seconds = (double)MIX_BLOCK / b->sample_rate;
+    double start, total = 0, max = 0;
+    long blocks = 0;
+    UTKMixer mixer;
+    int i;
+
+    if (b->num_segments != 1 || b->rev3) {
+        printf("  (mixing is only measured on Maxis UTK and PT files)\n");
+        return;
+    }
+
+    check(utk_mixer_init(&mixer, num_voices));
+
+    /* start the voices over MIX_STAGGER blocks, so that their frames are
+    ** not all decoded in the same blocks, and spread them across the stereo
+    ** field */
+    for (i = 0; i < MIX_STAGGER; i++) {
+        int k;
+
+        for (k = i; k < num_voices; k += MIX_STAGGER)
+            utk_mixer_play(&mixer, s->ptr, s->end, b->num_samples, 1.0f,
+                           num_voices > 1 ? -1.0f + 2.0f * k / (num_voices - 1) : 0.0f);
+
+        utk_mixer_mix(&mixer, bus, MIX_BLOCK);
+    }
+
+    start = now();
+    do {
+        double t;
+
+        while (mixer.num_playing < num_voices)
+            utk_mixer_play(&mixer, s->ptr, s->end, b->num_samples, 1.0f,
+                           -1.0f + 2.0f * (blocks % 16) / 15);
+
+        t = now();
+        utk_mixer_mix(&mixer, bus, MIX_BLOCK);
+        t = now() - t;
+
+        total += t;
+        if (t > max)
+            max = t;
+        blocks++;
+    } while (now() - start < bench_seconds);
+
+    printf("  mixing %d voices in blocks of %d samples (%.1f ms):\n", num_voices, MIX_BLOCK,
+           block_seconds * 1e3);
+    printf("  mean %.1f us/block, max %.1f us/block, %.0f voices per core in realtime\n",
+           total / blocks * 1e6, max * 1e6, num_voices * block_seconds / (total / blocks));
+
+    utk_mixer_free(&mixer);
+}
+
+/*
+** Synthetic input.
+*/
+
+/* Write seconds of a synthetic speech-like signal at 22050 Hz, to encode
+** with utkencode: voiced stretches with a gliding pitch and moving
+** formants, separated by noise bursts and pauses. */
+static void write_test_wav(const char *path, double seconds)
+{
+    const double pi = 3.14159265358979323846;
+    uint32_t num_samples = (uint32_t)(seconds * 22050), i;
+    uint32_t seed = 1;
+    double phase = 0;
+    OutputFile out;
+
+    open_output(&out, path, 1);
+    write_wav_header(out.fp, 22050, num_samples, 0);
+
+    for (i = 0; i < num_samples; i++) {
+        double t = i / 22050.0;
+        double syllable = fmod(t, 0.25) / 0.25;
+        double env = sin(pi * syllable);
+        double f0 = 110 + 60*sin(2*pi*0.3*t) + 30*syllable;
+        double f1 = 500 + 300*sin(2*pi*1.1*t), f2 = 1500 + 700*sin(2*pi*0.7*t);
+        double x = 0, noise;
+        int16_t sample;
+        int h;
+
+        seed = seed * 1103515245 + 12345;
+        noise = ((seed >> 16) & 0x7fff) / 16384.0 - 1.0;
+
+        phase += 2*pi*f0/22050;
+        if (phase > 2*pi)
+            phase -= 2*pi;
+
+        if (fmod(t, 2.0) < 1.6) {
+            /* voiced: harmonics shaped by two formants */
+            for (h = 1; h * f0 < 5000; h++) {
+                double f = h * f0;
+                double a = 1.0/(1 + pow((f - f1)/150, 2)) + 0.5/(1 + pow((f - f2)/250, 2));
+                x += a * sin(h * phase);
+            }
+            x = 3000 * env * x + 200 * noise;
+        } else if (fmod(t, 2.0) < 1.8) {
+            /* unvoiced */
+            x = 2500 * env * noise;
+        } else {
+            /* pause */
+            x = 20 * noise;
+        }
+
+        sample = (int16_t)(x > 32767 ? 32767 : x < -32768 ? -32768 : x);
+        output_s16(&out, &sample, 1);
+    }
+
+    close_output(&out);
+}
+
+/*
+** Main.
+*/
+
+static int bench_file(const char *path, int csv, int resample, uint32_t out_rate, int quality,
+                      int warmup, int voices)
+{
+    static Bench b;
+    double seek_frame, seek_sub, bits, excitation, lpc, synthesis, other, total, n;
+    char flagged[32] = "";
+    InputFile in;
+    int ret;
+
+    memset(&b, 0, sizeof(b));
+    b.out_rate = out_rate;
+    b.quality = quality;
+
+    ret = load_input(&in, path);
+    if (ret != 0) {
+        fprintf(stderr, "error: failed to read '%s': %s\n", path, strerror(ret));
+        return 1;
+    }
+
+    ret = open_stream(&b, in.data, in.size);
+    if (ret == UTK_OK && b.num_frames == 0)
+        ret = UTK_ERR_EOF;
+    if (ret == UTK_OK)
+        ret = compute_checksum(&b);
+    if (ret != UTK_OK) {
+        fprintf(stderr, "error: '%s': %s\n", path, utk_error_string(ret));
+        free(b.segments);
+        close_input(&in);
+        return 1;
+    }
+
+    b.records = alloc(MIN(b.num_frames, MAX_RECORDS) * sizeof(*b.records));
+    record_frames(&b);
+    n = b.num_records;
+
+    seek_frame = run(&b, stage_seek_frames) / n;
+    seek_sub = run(&b, stage_seek_subframes) / n;
+    bits = estimate(run(&b, stage_fields) / n - seek_frame - seek_sub, flagged, "bits");
+    excitation = estimate(run(&b, stage_excitation) / n - seek_sub, flagged, "excitation");
+    lpc = run(&b, stage_rc_to_lpc) / n;
+    synthesis = run(&b, stage_synthesis) / n;
+    total = run(&b, decode);
+    other = estimate(total / b.num_frames - (bits + excitation + lpc + synthesis),
+                     flagged, "other");
+
+    if (csv) {
+        printf("%s,%s,%lu,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%.1f,%08lx%08lx,%s,%s\n",
+               path, b.container, (unsigned long)b.num_frames,
+               bits*1e9, excitation*1e9, lpc*1e9, synthesis*1e9, other*1e9,
+               total / b.num_frames * 1e9,
+               (double)b.num_samples / b.sample_rate / total,
+               (unsigned long)(b.checksum >> 32), (unsigned long)(b.checksum & 0xffffffff),
+               KERNELS, flagged);
+    } else {
+        printf("%s: %s, %lu frames, checksum %08lx%08lx\n", path, b.container,
+               (unsigned long)b.num_frames,
+               (unsigned long)(b.checksum >> 32), (unsigned long)(b.checksum & 0xffffffff));
+        printf("  ns/frame: bits %.0f, excitation %.0f, rc_to_lpc %.0f, synthesis %.0f, other %.0f\n",
+               bits*1e9, excitation*1e9, lpc*1e9, synthesis*1e9, other*1e9);
+        if (flagged[0])
+            printf("  (%s: below the measurement error)\n", flagged);
+        printf("  total %.0f ns/frame, %.1fx realtime\n", total / b.num_frames * 1e9,
+               (double)b.num_samples / b.sample_rate / total);
+        if (resample)
+            bench_resampling(&b);
+        if (warmup)
+            bench_warmup(&b);
+        if (voices)
+            bench_mixing(&b, voices);
+    }
+
+    free(b.records);
+    free(b.segments);
+    close_input(&in);
+
+    return 0;
+}
+
+/* The synthetic streams of --synth: utkencode options and file names. */
+static const char *const synth_streams[][2] = {
+    { "-b 24000",            "utkbench-synth24.utk" },
+    { "-b 48000 -F -T 16",   "utkbench-synth48F.utk" }
+};
+
+/* Write a synthetic test signal of the given length, encode it with each
+** setting in synth_streams, using the utkencode next to this program, and
+** benchmark the streams. The files are removed afterwards. */
+static int bench_synth(const char *prog, double seconds, int csv, int resample, uint32_t out_rate,
+                       int quality, int warmup, int voices)
+{
+    const char *wav = "utkbench-synth.wav";
+    const char *slash = strrchr(prog, '/');
+    int dir_len = slash ? (int)(slash - prog) + 1 : 0;
+    char command[1024];
+    int errors = 0;
+    size_t i;
+
+    if (strlen(prog) > 512) {
+        fprintf(stderr, "error: program path is too long\n");
+        return 1;
+    }
+
+    write_test_wav(wav, seconds);
+
+    for (i = 0; i < sizeof(synth_streams)/sizeof(synth_streams[0]); i++) {
+        sprintf(command, "\"%.*sutkencode\" -f -q %s %s %s", dir_len, prog,
+                synth_streams[i][0], wav, synth_streams[i][1]);
+        if (system(command) != 0) {
+            fprintf(stderr, "error: failed to run '%s'\n", command);
+            errors++;
+            continue;
+        }
+        errors += bench_file(synth_streams[i][1], csv, resample, out_rate, quality, warmup, voices);
+        remove(synth_streams[i][1]);
+    }
+
+    remove(wav);
+
+    return errors;
+}
+
+int main(int argc, char *argv[])
+{
+    uint32_t out_rate = 48000;
+    int quality = UTK_RESAMPLE_MEDIUM;
+    int csv = 0, resample = 0, warmup = 0, voices = 0, errors = 0, i;
+    const char *prog = argv[0];
+    double synth = 0;
+
+    /* Parse arguments. */
+    while (argc > 1 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "--csv")) {
+            csv = 1;
+        } else if (!strcmp(argv[1], "-t") && argc > 2) {
+            bench_seconds = atof(argv[2]);
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "-r") && argc > 2) {
+            resample = 1;
+            out_rate = (uint32_t)strtoul(argv[2], NULL, 10);
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "-w")) {
+            warmup = 1;
+        } else if (!strcmp(argv[1], "-m") && argc > 2) {
+            voices = atoi(argv[2]);
+            if (voices < 1 || voices > UTK_MIXER_MAX_VOICES) {
+                fprintf(stderr, "error: invalid number of voices '%s'\n", argv[2]);
+                return EXIT_FAILURE;
+            }
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "-q") && argc > 2) {
+            quality = atoi(argv[2]);
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "--synth") && argc > 2) {
+            synth = atof(argv[2]);
+            if (!(synth > 0 && synth < 86400)) {
+                fprintf(stderr, "error: invalid length '%s'\n", argv[2]);
+                return EXIT_FAILURE;
+            }
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "--wav") && argc == 4) {
+            write_test_wav(argv[2], atof(argv[3]));
+            return EXIT_SUCCESS;
+        } else {
+            break;
+        }
+        argv++, argc--;
+    }
+
+    if ((argc < 2 && !synth) || (argc > 1 && argv[1][0] == '-')) {
+        printf("Usage: utkbench [--csv] [-t seconds] [-r rate] [-q quality] [-w] [-m voices]\n");
+        printf("                [--synth seconds] file...\n");
+        printf("       utkbench --wav outfile.wav seconds\n");
+        printf("Time decoding Maxis UTK, PT/M10 and SCxl files: each stage of the decoder\n");
+        printf("in ns/frame, the whole decoder as a realtime factor, and a checksum of\n");
+        printf("the 16-bit output.\n");
+        printf("  --csv  print one line of comma-separated values per file\n");
+        printf("  -t     time spent on each measurement (default 0.5)\n");
+        printf("  -r     also time decoding and resampling to rate, separately and fused\n");
+        printf("  -q     resampling quality 0-2 (default 1)\n");
+        printf("  -w     also compare the approximate parallel decode (utkpar.h) with the\n");
+        printf("         exact one, for several numbers of warm-up frames\n");
+        printf("  -m     also time mixing this many voices of each file (utkmix.h): the\n");
+        printf("         time per mix block and the voices per core\n");
+        printf("  --synth also time this many seconds of a synthetic test signal, encoded\n");
+        printf("         with the utkencode next to utkbench at 24 and 48 kbit/s\n");
+        printf("  --wav  write a synthetic speech-like test signal, to encode with utkencode\n");
+        return EXIT_FAILURE;
+    }
+
+    if (csv)
+        printf("file,container,frames,bits_ns,excitation_ns,rc_to_lpc_ns,synthesis_ns,"
+               "other_ns,total_ns,realtime,checksum,kernels,flagged\n");
+
+    for (i = 1; i < argc; i++)
+        errors += bench_file(argv[i], csv, resample, out_rate, quality, warmup, voices);
+    if (synth)
+        errors += bench_synth(prog, synth, csv, resample, out_rate, quality, warmup, voices);
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
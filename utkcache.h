@@ -0,0 +1,453 @@
+#ifndef UTKCACHE_H
+#define UTKCACHE_H
+
+#include <stdlib.h>
+#include <string.h>
+#include "libutk.h"
+
+#ifndef UTK_NO_THREADS
+#include <pthread.h>
+#endif
+
+/* A cache of decoded clips, for servers that play the same clips over and
+** over (e.g. common voice lines).
+**
+**     UTKCache cache;
+**     const UTKCacheClip *clip;
+**     utk_cache_init(&cache, 64 << 20, NULL);
+**     ...
+**     any thread: utk_cache_get(&cache, data, size, &clip);
+**                 play clip->samples[0 .. clip->num_samples-1]
+**                 utk_cache_release(&cache, clip);
+**     ...
+**     utk_cache_free(&cache);
+**
+** A clip is any file that libutk decodes (Maxis UTK, PT or SCxl), and is
+** looked up by a 64-bit hash of its bytes and its size, so the same clip
+** loaded from two places is decoded once. The first utk_cache_get of a clip
+** decodes all of it to int16 samples; later ones return the same samples
+** without decoding or copying them. If several threads ask for a clip that
+** is still being decoded, they wait for that one decode instead of each
+** starting their own.
+**
+** The decoded clips are kept within a budget of bytes, and when a new clip
+** does not fit, the least recently used ones are dropped. A clip is
+** reference-counted: every utk_cache_get must be matched by a
+** utk_cache_release, and the samples of a dropped clip stay valid until its
+** last reference has been released (so clips in use can take the memory
+** used over the budget). A clip larger than the whole budget is decoded for
+** its callers but not kept.
+**
+** The cache is thread-safe: one mutex guards the table, and decoding runs
+** outside of it, so misses on different clips decode in parallel. Build with
+** -pthread (the including file should define _POSIX_C_SOURCE 200112L first),
+** or with -DUTK_NO_THREADS to use the cache from one thread only. */
+
+typedef struct UTKCacheClip {
+    const int16_t *samples;
+    uint32_t num_samples;
+    uint32_t sample_rate;
+    /* private */
+    uint64_t hash;
+    size_t size;                    /* of the encoded clip */
+    size_t bytes;                   /* counted against the budget */
+    int refs;
+    int state;                      /* UTK_CACHE_* */
+    int error;                      /* if the decode failed */
+    struct UTKCacheClip *hash_next; /* in its bucket */
+    struct UTKCacheClip *newer, *older; /* in the LRU list, if cached */
+} UTKCacheClip;
+
+enum {
+    UTK_CACHE_DECODING,             /* in the table, being decoded */
+    UTK_CACHE_CACHED,               /* in the table and the LRU list */
+    UTK_CACHE_DROPPED               /* in neither; freed on the last release */
+};
+
+typedef struct UTKCacheStats {
+    uint64_t hits;          /* found decoded */
+    uint64_t waits;         /* found being decoded, and waited for */
+    uint64_t misses;        /* decoded */
+    uint64_t errors;        /* decodes that failed */
+    uint64_t evictions;     /* clips dropped to stay within the budget */
+    size_t bytes;           /* used by the clips in the cache */
+    size_t budget;
+    uint32_t clips;         /* in the cache */
+} UTKCacheStats;
+
+typedef struct UTKCache {
+    UTKAllocator allocator;
+    UTKCacheClip **buckets;
+    uint32_t num_buckets;           /* a power of 2 */
+    uint32_t num_entries;           /* in the table, cached or decoding */
+    UTKCacheClip *newest, *oldest;
+    UTKCacheStats stats;
+#ifndef UTK_NO_THREADS
+    pthread_mutex_t lock;
+    pthread_cond_t decoded;
+#endif
+} UTKCache;
+
+#ifndef UTK_NO_THREADS
+#define UTK_CACHE_LOCK(c) pthread_mutex_lock(&(c)->lock)
+#define UTK_CACHE_UNLOCK(c) pthread_mutex_unlock(&(c)->lock)
+#else
+#define UTK_CACHE_LOCK(c) ((void)0)
+#define UTK_CACHE_UNLOCK(c) ((void)0)
+#endif
+
+static void *utk_cache_default_alloc(void *opaque, size_t size)
+{
+    (void)opaque;
+    return malloc(size);
+}
+
+static void utk_cache_default_free(void *opaque, void *ptr)
+{
+    (void)opaque;
+    free(ptr);
+}
+
+static void utk_cache_destroy_clip(UTKCache *cache, UTKCacheClip *clip)
+{
+    if (clip->samples)
+        cache->allocator.free(cache->allocator.opaque, (void *)clip->samples);
+    cache->allocator.free(cache->allocator.opaque, clip);
+}
+
+static UTKCacheClip **utk_cache_bucket(UTKCache *cache, uint64_t hash)
+{
+    return &cache->buckets[(uint32_t)(hash ^ (hash >> 32)) & (cache->num_buckets - 1)];
+}
+
+/* Double the number of buckets once the table has more entries than
+** buckets. If that fails, the chains just get longer. */
+static void utk_cache_grow(UTKCache *cache)
+{
+    UTKCacheClip **old = cache->buckets;
+    uint32_t n = cache->num_buckets, i;
+
+    if (cache->num_entries <= n || n >= 0x40000000)
+        return;
+
+    cache->buckets = cache->allocator.alloc(cache->allocator.opaque, 2 * (size_t)n * sizeof(*old));
+    if (!cache->buckets) {
+        cache->buckets = old;
+        return;
+    }
+    memset(cache->buckets, 0, 2 * (size_t)n * sizeof(*old));
+    cache->num_buckets = 2*n;
+
+    for (i = 0; i < n; i++) {
+        while (old[i]) {
+            UTKCacheClip *clip = old[i], **bucket = utk_cache_bucket(cache, clip->hash);
+
+            old[i] = clip->hash_next;
+            clip->hash_next = *bucket;
+            *bucket = clip;
+        }
+    }
+
+    cache->allocator.free(cache->allocator.opaque, old);
+}
+
+static void utk_cache_unlink_hash(UTKCache *cache, UTKCacheClip *clip)
+{
+    UTKCacheClip **p = utk_cache_bucket(cache, clip->hash);
+
+    while (*p != clip)
+        p = &(*p)->hash_next;
+    *p = clip->hash_next;
+    cache->num_entries--;
+}
+
+static void utk_cache_unlink_lru(UTKCache *cache, UTKCacheClip *clip)
+{
+    if (clip->newer)
+        clip->newer->older = clip->older;
+    else
+        cache->newest = clip->older;
+
+    if (clip->older)
+        clip->older->newer = clip->newer;
+    else
+        cache->oldest = clip->newer;
+}
+
+static void utk_cache_push_lru(UTKCache *cache, UTKCacheClip *clip)
+{
+    clip->newer = NULL;
+    clip->older = cache->newest;
+    if (cache->newest)
+        cache->newest->newer = clip;
+    else
+        cache->oldest = clip;
+    cache->newest = clip;
+}
+
+/* Take a cached clip out of the cache; it is freed once it is released. */
+static void utk_cache_drop(UTKCache *cache, UTKCacheClip *clip)
+{
+    utk_cache_unlink_hash(cache, clip);
+    utk_cache_unlink_lru(cache, clip);
+    cache->stats.bytes -= clip->bytes;
+    cache->stats.clips--;
+    clip->state = UTK_CACHE_DROPPED;
+
+    if (clip->refs == 0)
+        utk_cache_destroy_clip(cache, clip);
+}
+
+/* Decode a whole clip into clip->samples. Called without the lock. */
+static int utk_cache_decode(UTKCache *cache, UTKCacheClip *clip, const void *data, size_t size)
+{
+    UTKDecoder *dec = utk_decoder_create(&cache->allocator);
+    UTKStreamInfo info;
+    int16_t *samples;
+    size_t n = 0;
+    int ret;
+
+    if (!dec)
+        return UTK_ERR_NOMEM;
+
+    ret = utk_decoder_open(dec, data, size);
+    if (ret == UTK_OK)
+        ret = utk_decoder_get_info(dec, &info);
+    if (ret != UTK_OK) {
+        utk_decoder_destroy(dec);
+        return ret;
+    }
+
+    samples = cache->allocator.alloc(cache->allocator.opaque,
+                                     info.num_samples ? info.num_samples * sizeof(int16_t) : 1);
+    if (!samples) {
+        utk_decoder_destroy(dec);
+        return UTK_ERR_NOMEM;
+    }
+
+    ret = utk_decoder_read_s16(dec, samples, info.num_samples, &n);
+    utk_decoder_destroy(dec);
+    if (ret == UTK_OK && n != info.num_samples)
+        ret = UTK_ERR_EOF;
+    if (ret != UTK_OK) {
+        cache->allocator.free(cache->allocator.opaque, samples);
+        return ret;
+    }
+
+    clip->samples = samples;
+    clip->num_samples = info.num_samples;
+    clip->sample_rate = info.sample_rate;
+    clip->bytes = sizeof(*clip) + info.num_samples * sizeof(int16_t);
+
+    return UTK_OK;
+}
+
+/*
+** Public functions.
+*/
+
+/* The hash of a clip's bytes that it is looked up by (64-bit FNV-1a). */
+static uint64_t utk_cache_hash(const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    uint64_t hash = (uint64_t)0xcbf29ce4 << 32 | 0x84222325;
+    size_t i;
+
+    for (i = 0; i < size; i++) {
+        hash ^= p[i];
+        hash *= (uint64_t)0x100 << 32 | 0x1b3;
+    }
+
+    return hash;
+}
+
+/* Set up a cache that keeps up to budget bytes of decoded clips, allocating
+** through allocator (NULL for malloc/free). Returns UTK_OK or
+** UTK_ERR_NOMEM. */
+static int utk_cache_init(UTKCache *cache, size_t budget, const UTKAllocator *allocator)
+{
+    memset(cache, 0, sizeof(*cache));
+
+    if (allocator) {
+        cache->allocator = *allocator;
+    } else {
+        cache->allocator.alloc = utk_cache_default_alloc;
+        cache->allocator.free = utk_cache_default_free;
+    }
+
+    cache->num_buckets = 64;
+    cache->buckets = cache->allocator.alloc(cache->allocator.opaque,
+                                            cache->num_buckets * sizeof(*cache->buckets));
+    if (!cache->buckets)
+        return UTK_ERR_NOMEM;
+    memset(cache->buckets, 0, cache->num_buckets * sizeof(*cache->buckets));
+
+    cache->stats.budget = budget;
+
+#ifndef UTK_NO_THREADS
+    if (pthread_mutex_init(&cache->lock, NULL) != 0) {
+        cache->allocator.free(cache->allocator.opaque, cache->buckets);
+        return UTK_ERR_NOMEM;
+    }
+    if (pthread_cond_init(&cache->decoded, NULL) != 0) {
+        pthread_mutex_destroy(&cache->lock);
+        cache->allocator.free(cache->allocator.opaque, cache->buckets);
+        return UTK_ERR_NOMEM;
+    }
+#endif
+
+    return UTK_OK;
+}
+
+/* Free the cache and its clips. Every clip must have been released, and no
+** other thread may be using the cache. */
+static void utk_cache_free(UTKCache *cache)
+{
+    while (cache->oldest)
+        utk_cache_drop(cache, cache->oldest);
+
+    cache->allocator.free(cache->allocator.opaque, cache->buckets);
+#ifndef UTK_NO_THREADS
+    pthread_cond_destroy(&cache->decoded);
+    pthread_mutex_destroy(&cache->lock);
+#endif
+    memset(cache, 0, sizeof(*cache));
+}
+
+/* Get the decoded samples of the clip in [data, data+size), decoding it if
+** it is not in the cache. hash is utk_cache_hash(data, size), e.g. computed
+** once when the clip was loaded. On success, *out holds a reference, to be
+** released with utk_cache_release. Returns UTK_OK, UTK_ERR_NOMEM, or the
+** error from decoding the clip. */
+static int utk_cache_get_hashed(UTKCache *cache, uint64_t hash, const void *data, size_t size,
+                                const UTKCacheClip **out)
+{
+    UTKCacheClip *clip, **bucket;
+    int ret;
+
+    *out = NULL;
+
+    UTK_CACHE_LOCK(cache);
+
+    bucket = utk_cache_bucket(cache, hash);
+    for (clip = *bucket; clip; clip = clip->hash_next) {
+        if (clip->hash == hash && clip->size == size)
+            break;
+    }
+
+    if (clip) {
+        clip->refs++;
+
+        if (clip->state == UTK_CACHE_CACHED) {
+            cache->stats.hits++;
+            utk_cache_unlink_lru(cache, clip);
+            utk_cache_push_lru(cache, clip);
+            UTK_CACHE_UNLOCK(cache);
+            *out = clip;
+            return UTK_OK;
+        }
+
+        /* another thread is decoding it */
+        cache->stats.waits++;
+#ifndef UTK_NO_THREADS
+        while (clip->state == UTK_CACHE_DECODING)
+            pthread_cond_wait(&cache->decoded, &cache->lock);
+#endif
+
+        ret = clip->error;
+        if (ret != UTK_OK) {
+            if (--clip->refs == 0)
+                utk_cache_destroy_clip(cache, clip);
+            UTK_CACHE_UNLOCK(cache);
+            return ret;
+        }
+
+        UTK_CACHE_UNLOCK(cache);
+        *out = clip;
+        return UTK_OK;
+    }
+
+    /* a miss: add the clip to the table first, so that other threads wait
+    ** for this decode */
+    clip = cache->allocator.alloc(cache->allocator.opaque, sizeof(*clip));
+    if (!clip) {
+        UTK_CACHE_UNLOCK(cache);
+        return UTK_ERR_NOMEM;
+    }
+    memset(clip, 0, sizeof(*clip));
+    clip->hash = hash;
+    clip->size = size;
+    clip->refs = 1;
+    clip->state = UTK_CACHE_DECODING;
+    clip->hash_next = *bucket;
+    *bucket = clip;
+    cache->num_entries++;
+    cache->stats.misses++;
+
+    UTK_CACHE_UNLOCK(cache);
+
+    ret = utk_cache_decode(cache, clip, data, size);
+
+    UTK_CACHE_LOCK(cache);
+
+    clip->error = ret;
+
+    if (ret != UTK_OK) {
+        cache->stats.errors++;
+        utk_cache_unlink_hash(cache, clip);
+        clip->state = UTK_CACHE_DROPPED;
+        if (--clip->refs == 0)
+            utk_cache_destroy_clip(cache, clip);
+    } else if (clip->bytes > cache->stats.budget) {
+        utk_cache_unlink_hash(cache, clip);
+        clip->state = UTK_CACHE_DROPPED;
+        *out = clip;
+    } else {
+        while (cache->stats.bytes + clip->bytes > cache->stats.budget) {
+            cache->stats.evictions++;
+            utk_cache_drop(cache, cache->oldest);
+        }
+
+        clip->state = UTK_CACHE_CACHED;
+        utk_cache_push_lru(cache, clip);
+        cache->stats.bytes += clip->bytes;
+        cache->stats.clips++;
+        utk_cache_grow(cache);
+        *out = clip;
+    }
+
+#ifndef UTK_NO_THREADS
+    pthread_cond_broadcast(&cache->decoded);
+#endif
+    UTK_CACHE_UNLOCK(cache);
+
+    return ret;
+}
+
+/* Same as utk_cache_get_hashed, hashing the clip first. */
+static int utk_cache_get(UTKCache *cache, const void *data, size_t size,
+                         const UTKCacheClip **out)
+{
+    return utk_cache_get_hashed(cache, utk_cache_hash(data, size), data, size, out);
+}
+
+/* Release a reference from utk_cache_get. */
+static void utk_cache_release(UTKCache *cache, const UTKCacheClip *clip)
+{
+    UTKCacheClip *c = (UTKCacheClip *)clip;
+
+    UTK_CACHE_LOCK(cache);
+    if (--c->refs == 0 && c->state == UTK_CACHE_DROPPED)
+        utk_cache_destroy_clip(cache, c);
+    UTK_CACHE_UNLOCK(cache);
+}
+
+/* A snapshot of the counters, e.g. to export to a monitoring system. */
+static void utk_cache_get_stats(UTKCache *cache, UTKCacheStats *stats)
+{
+    UTK_CACHE_LOCK(cache);
+    *stats = cache->stats;
+    UTK_CACHE_UNLOCK(cache);
+}
+
+#endif
@@ -0,0 +1,369 @@
+/*
+** utkcheck
+** Check the vectorized kernels of utkdsp.h against their reference versions
+** on the frames of MicroTalk files (Maxis UTK, PT/M10 and SCxl).
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2
+**          -fwhole-program -g0 -s -o utkcheck utkcheck.c
+**          (add -mavx2 to check the AVX kernels as well as the SSE2 ones; do
+**          not add -ffast-math, which lets the compiler reorder the sums of
+**          the reference kernels)
+*/
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "utk.h"
+#include "io.h"
+#include "eachunk.h"
+
+#ifdef __FAST_MATH__
+#error "compile utkcheck without -ffast-math"
+#endif
+
+#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((uint32_t)(d)<<24))
+
+/* The tolerance of the block synthesis filter (UTK_BLOCK_SYNTH), in LSB of
+** the 16-bit output. The pitch mix and interpolation kernels must be exact. */
+#define SYNTH_LSB 1
+
+/* report at most this many failures of each kernel in each file */
+#define MAX_REPORTS 5
+
+#if defined(UTK_SIMD_AVX) || defined(UTK_SIMD_SSE2)
+
+/* A set of kernels to check, with the start argument of the SSE2 ones
+** bound to 0 as in the dispatch functions of utkdsp.h. */
+typedef struct Kernels {
+    const char *name;
+    void (*pitch_mix)(float *out, const float *excitation, const float *cb,
+                      float fixed_gain, float pitch_gain);
+    void (*interpolate)(float *x, int align);
+    void (*synthesize)(float *out, const float *in, int num_blocks,
+                       const float *lpc, float *history);
+} Kernels;
+
+static void pitch_mix_sse2(float *out, const float *excitation, const float *cb,
+                           float fixed_gain, float pitch_gain)
+{
+    utk_pitch_mix_sse2(out, excitation, cb, fixed_gain, pitch_gain, 0);
+}
+
+static void interpolate_sse2(float *x, int align)
+{
+    utk_interpolate_sse2(x, align, 0);
+}
+
+static const Kernels kernels[] = {
+    { "sse2", pitch_mix_sse2, interpolate_sse2, utk_synthesize_sse2 }
+#ifdef UTK_SIMD_AVX
+  , { "avx", utk_pitch_mix_avx, utk_interpolate_avx, utk_synthesize_avx }
+#endif
+};
+
+#define NUM_KERNELS (sizeof(kernels)/sizeof(kernels[0]))
+
+typedef struct Result {
+    unsigned long pitch_mix_calls, pitch_mix_failures;
+    unsigned long interpolate_calls, interpolate_failures;
+    unsigned long synth_calls, synth_failures;
+    int synth_lsb;
+} Result;
+
+typedef struct Check {
+    const char *path;
+    int rev3;
+    uint32_t frame;
+    int subframe;
+    Result results[NUM_KERNELS];
+} Check;
+
+static void report(Check *c, unsigned long failures, size_t k, const char *fmt, int arg)
+{
+    if (failures > MAX_REPORTS)
+        return;
+
+    printf("%s: frame %lu, subframe %d: %s ", c->path, (unsigned long)c->frame,
+           c->subframe, kernels[k].name);
+    printf(fmt, arg);
+    printf("%s\n", failures == MAX_REPORTS ? " (further failures not shown)" : "");
+}
+
+/*
+** Kernels.
+*/
+
+static void check_pitch_mix(Check *c, float *out, const float *excitation, const float *cb,
+                            float fixed_gain, float pitch_gain)
+{
+    float test[108];
+    size_t k;
+
+    utk_pitch_mix_c(out, excitation, cb, fixed_gain, pitch_gain);
+
+    for (k = 0; k < NUM_KERNELS; k++) {
+        Result *r = &c->results[k];
+
+        kernels[k].pitch_mix(test, excitation, cb, fixed_gain, pitch_gain);
+        r->pitch_mix_calls++;
+        if (memcmp(test, out, sizeof(test)) != 0)
+            report(c, ++r->pitch_mix_failures, k, "pitch mix differs", 0);
+    }
+}
+
+/* Interpolate a subframe of excitation, with either alignment. The samples
+** that are filled in are never read, so this checks the kernel on the coded
+** samples whichever alignment the subframe had. */
+static void check_interpolate(Check *c, const float *excitation)
+{
+    float ref[5+108+5], test[5+108+5];
+    int align;
+    size_t k;
+
+    for (align = 0; align < 2; align++) {
+        memcpy(ref, excitation, sizeof(ref));
+        utk_interpolate_c(&ref[5], align);
+
+        for (k = 0; k < NUM_KERNELS; k++) {
+            Result *r = &c->results[k];
+
+            memcpy(test, excitation, sizeof(test));
+            kernels[k].interpolate(&test[5], align);
+            r->interpolate_calls++;
+            if (memcmp(test, ref, sizeof(test)) != 0)
+                report(c, ++r->interpolate_failures, k, "interpolation differs (align %d)", align);
+        }
+    }
+}
+
+static int max_lsb(const int16_t *a, const int16_t *b, int n)
+{
+    int i, max = 0;
+
+    for (i = 0; i < n; i++) {
+        int d = a[i] > b[i] ? a[i] - b[i] : b[i] - a[i];
+
+        if (d > max)
+            max = d;
+    }
+
+    return max;
+}
+
+/* Run the synthesis filter from in to out, with the reference kernel, and
+** check the block filter against it on the same input. */
+static void check_synthesize(Check *c, float *out, const float *in, int num_blocks,
+                             const float *lpc, float *history)
+{
+    int n = 12*num_blocks;
+    float test[432], h[12];
+    int16_t ref_s16[432], test_s16[432];
+    size_t k;
+
+    memcpy(h, history, sizeof(h));
+    utk_synthesize_c(out, in, num_blocks, lpc, history);
+    utk_convert_s16_c(ref_s16, out, n);
+
+    for (k = 0; k < NUM_KERNELS; k++) {
+        Result *r = &c->results[k];
+        float test_history[12];
+        int lsb;
+
+        memcpy(test_history, h, sizeof(h));
+        kernels[k].synthesize(test, in, num_blocks, lpc, test_history);
+        utk_convert_s16_c(test_s16, test, n);
+        lsb = max_lsb(test_s16, ref_s16, n);
+
+        r->synth_calls++;
+        if (lsb > r->synth_lsb)
+            r->synth_lsb = lsb;
+        if (lsb > SYNTH_LSB)
+            report(c, ++r->synth_failures, k, "synthesis differs by %d LSB", lsb);
+    }
+}
+
+/*
+** Frames.
+*/
+
+/* Decode the next frame on a copy of ctx as utk_decode_frame does, running
+** the reference kernels and checking the others against them. */
+static void check_frame(Check *c, const UTKContext *ctx)
+{
+    static UTKContext copy;
+    UTKFrame frame;
+    float rc_delta[12], lpc[12];
+    float *out;
+    int i, j;
+
+    copy = *ctx;
+    if (c->rev3)
+        utk_read_byte(&copy);
+    utk_parse_frame(&copy, &frame);
+
+    for (i = 0; i < 4; i++) {
+        c->subframe = i;
+        check_interpolate(c, frame.excitation[i]);
+    }
+
+    for (i = 0; i < 12; i++)
+        rc_delta[i] = (frame.rc[i] - copy.rc[i])*0.25f;
+
+    /* as in utk_mix_frame */
+    out = &copy.cb_ring[copy.cb_pos];
+    if (frame.pitch_lag[0] > 216)
+        utk_fill_cb_prefix(&copy);
+
+    for (i = 0; i < 4; i++) {
+        int pos = copy.cb_pos + 108*i - 108 - frame.pitch_lag[i];
+
+        if (pos < 0)
+            pos += UTK_RING_SIZE;
+
+        c->subframe = i;
+        check_pitch_mix(c, &out[108*i], &frame.excitation[i][5], &copy.cb_ring[pos],
+                        frame.fixed_gain[i], frame.pitch_gain[i]);
+
+        if (copy.cb_pos == 0 && i == 0)
+            memcpy(&copy.cb_ring[UTK_RING_SIZE], out, 108*sizeof(float));
+    }
+
+    /* as in utk_synth_frame */
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 12; j++)
+            copy.rc[j] += rc_delta[j];
+        rc_to_lpc(copy.rc, lpc);
+
+        c->subframe = i;
+        check_synthesize(c, &copy.decompressed_frame[12*i], &out[12*i], i < 3 ? 1 : 33,
+                         lpc, copy.synth_history);
+    }
+}
+
+/* Check each frame of a bitstream, then decode it. */
+static int check_bitstream(Check *c, UTKContext *ctx, const uint8_t *ptr, const uint8_t *end,
+                           uint32_t num_samples)
+{
+    uint32_t i;
+    int ret = UTK_OK;
+
+    utk_set_ptr(ctx, ptr, end);
+
+    for (i = 0; i < num_samples && ret == UTK_OK; i += 432) {
+        check_frame(c, ctx);
+
+        if (c->rev3)
+            ret = utk_rev3_decode_frame(ctx);
+        else
+            utk_decode_frame(ctx);
+        c->frame++;
+    }
+
+    return ret;
+}
+
+static int check_stream(Check *c, const uint8_t *data, size_t size)
+{
+    static UTKContext ctx;
+    uint32_t sig = size >= 4 ? get_u32(data) : 0;
+    EAStream s;
+    EADataChunk chunk;
+    int ret;
+
+    utk_init(&ctx);
+
+    if (sig == MAKE_U32('U','T','M','0')) {
+        if (size < 32)
+            return UTK_ERR_EOF;
+        return check_bitstream(c, &ctx, data + 32, data + size, get_u32(data+4)/2);
+    } else if ((sig & 0xffff) == MAKE_U32('P','T','\x00','\x00')) {
+        ret = ea_open_pt(&s, data, size);
+        if (ret != UTK_OK)
+            return ret;
+        return check_bitstream(c, &ctx, s.next, s.end, s.hdr.num_samples);
+    } else if (sig == MAKE_U32('S','C','H','l')) {
+        ret = ea_open_scxl(&s, data, size);
+        if (ret != UTK_OK)
+            return ret;
+        c->rev3 = s.hdr.codec_revision >= 3;
+        while ((ret = ea_next_data_chunk(&s, &chunk)) == UTK_OK) {
+            ret = check_bitstream(c, &ctx, chunk.ptr, chunk.end, chunk.num_samples);
+            if (ret != UTK_OK)
+                return ret;
+        }
+        return s.chunks_left == 0 ? UTK_OK : ret;
+    }
+
+    return UTK_ERR_BAD_SIGNATURE;
+}
+
+static int check_file(const char *path)
+{
+    static Check c;
+    InputFile in;
+    unsigned long failures = 0;
+    size_t k;
+    int ret;
+
+    memset(&c, 0, sizeof(c));
+    c.path = path;
+
+    ret = load_input(&in, path);
+    if (ret != 0) {
+        fprintf(stderr, "error: failed to read '%s': %s\n", path, strerror(ret));
+        return 1;
+    }
+
+    ret = check_stream(&c, in.data, in.size);
+    close_input(&in);
+    if (ret != UTK_OK) {
+        fprintf(stderr, "error: '%s': %s\n", path, utk_error_string(ret));
+        return 1;
+    }
+
+    printf("%s: %lu frames\n", path, (unsigned long)c.frame);
+    for (k = 0; k < NUM_KERNELS; k++) {
+        const Result *r = &c.results[k];
+
+        printf("  %-4s pitch mix: %lu calls, %lu differ\n", kernels[k].name,
+               r->pitch_mix_calls, r->pitch_mix_failures);
+        printf("       interpolation: %lu calls, %lu differ\n",
+               r->interpolate_calls, r->interpolate_failures);
+        printf("       block synthesis: %lu calls, max %d LSB, %lu over\n",
+               r->synth_calls, r->synth_lsb, r->synth_failures);
+        failures += r->pitch_mix_failures + r->interpolate_failures + r->synth_failures;
+    }
+
+    return failures != 0;
+}
+
+#endif
+
+int main(int argc, char *argv[])
+{
+    int errors = 0, i;
+
+    if (argc < 2 || argv[1][0] == '-') {
+        printf("Usage: utkcheck file...\n");
+        printf("Check the vectorized pitch mix and interpolation kernels of utkdsp.h, and\n");
+        printf("its block synthesis filter (used with -DUTK_BLOCK_SYNTH), against their\n");
+        printf("reference versions on each frame of the files. The first two must match\n");
+        printf("exactly, and the block filter must be within %d LSB. Exits with an error\n",
+               SYNTH_LSB);
+        printf("if any kernel is off.\n");
+        return EXIT_FAILURE;
+    }
+
+#if defined(UTK_SIMD_AVX) || defined(UTK_SIMD_SSE2)
+    for (i = 1; i < argc; i++)
+        errors += check_file(argv[i]);
+#else
+    (void)i;
+    printf("utkcheck: built without vectorized kernels, nothing to check\n");
+#endif
+
+    return errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
@@ -0,0 +1,109 @@
+#ifndef UTKCODEBOOK_H
+#define UTKCODEBOOK_H
+
+#include <stdint.h>
+
+/* MicroTalk quantization tables. utkgentables.c derives the multi-symbol
+** decoding tables in utktables.h from these. */
+
+enum {
+    MDL_NORMAL = 0,
+    MDL_LARGEPULSE = 1
+};
+
+static const float utk_rc_table[64] = {
+    +0.0f,
+    -.99677598476409912109375f, -.99032700061798095703125f, -.983879029750823974609375f, -.977430999279022216796875f,
+    -.970982015132904052734375f, -.964533984661102294921875f, -.958085000514984130859375f, -.9516370296478271484375f,
+    -.930754005908966064453125f, -.904959976673126220703125f, -.879167020320892333984375f, -.853372991085052490234375f,
+    -.827579021453857421875f, -.801786005496978759765625f, -.775991976261138916015625f, -.75019800662994384765625f,
+    -.724404990673065185546875f, -.6986110210418701171875f, -.6706349849700927734375f, -.61904799938201904296875f,
+    -.567460000514984130859375f, -.515873014926910400390625f, -.4642859995365142822265625f, -.4126980006694793701171875f,
+    -.361110985279083251953125f, -.309523999691009521484375f, -.257937014102935791015625f, -.20634900033473968505859375f,
+    -.1547619998455047607421875f, -.10317499935626983642578125f, -.05158700048923492431640625f,
+    +0.0f,
+    +.05158700048923492431640625f, +.10317499935626983642578125f, +.1547619998455047607421875f, +.20634900033473968505859375f,
+    +.257937014102935791015625f, +.309523999691009521484375f, +.361110985279083251953125f, +.4126980006694793701171875f,
+    +.4642859995365142822265625f, +.515873014926910400390625f, +.567460000514984130859375f, +.61904799938201904296875f,
+    +.6706349849700927734375f, +.6986110210418701171875f, +.724404990673065185546875f, +.75019800662994384765625f,
+    +.775991976261138916015625f, +.801786005496978759765625f, +.827579021453857421875f, +.853372991085052490234375f,
+    +.879167020320892333984375f, +.904959976673126220703125f, +.930754005908966064453125f, +.9516370296478271484375f,
+    +.958085000514984130859375f, +.964533984661102294921875f, +.970982015132904052734375f, +.977430999279022216796875f,
+    +.983879029750823974609375f, +.99032700061798095703125f, +.99677598476409912109375f
+};
+
+static const uint8_t utk_codebooks[2][256] = {
+    { /* normal model */
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 21,
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 25,
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 22,
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5,  0,
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 21,
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 26,
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 17,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5, 22,
+        4,  6,  5,  9,  4,  6,  5, 13,  4,  6,  5, 10,  4,  6,  5, 18,
+        4,  6,  5,  9,  4,  6,  5, 14,  4,  6,  5, 10,  4,  6,  5,  2
+    }, { /* large-pulse model */
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 27,
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  1,
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 28,
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  3,
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 27,
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  1,
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 23,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8, 28,
+        4, 11,  7, 15,  4, 12,  8, 19,  4, 11,  7, 16,  4, 12,  8, 24,
+        4, 11,  7, 15,  4, 12,  8, 20,  4, 11,  7, 16,  4, 12,  8,  3
+    }
+};
+
+static const struct {
+    int next_model;
+    int code_size;
+    float pulse_value;
+} utk_commands[29] = {
+    {MDL_LARGEPULSE, 8,  0.0f},
+    {MDL_LARGEPULSE, 7,  0.0f},
+    {MDL_NORMAL,     8,  0.0f},
+    {MDL_NORMAL,     7,  0.0f},
+    {MDL_NORMAL,     2,  0.0f},
+    {MDL_NORMAL,     2, -1.0f},
+    {MDL_NORMAL,     2, +1.0f},
+    {MDL_NORMAL,     3, -1.0f},
+    {MDL_NORMAL,     3, +1.0f},
+    {MDL_LARGEPULSE, 4, -2.0f},
+    {MDL_LARGEPULSE, 4, +2.0f},
+    {MDL_LARGEPULSE, 3, -2.0f},
+    {MDL_LARGEPULSE, 3, +2.0f},
+    {MDL_LARGEPULSE, 5, -3.0f},
+    {MDL_LARGEPULSE, 5, +3.0f},
+    {MDL_LARGEPULSE, 4, -3.0f},
+    {MDL_LARGEPULSE, 4, +3.0f},
+    {MDL_LARGEPULSE, 6, -4.0f},
+    {MDL_LARGEPULSE, 6, +4.0f},
+    {MDL_LARGEPULSE, 5, -4.0f},
+    {MDL_LARGEPULSE, 5, +4.0f},
+    {MDL_LARGEPULSE, 7, -5.0f},
+    {MDL_LARGEPULSE, 7, +5.0f},
+    {MDL_LARGEPULSE, 6, -5.0f},
+    {MDL_LARGEPULSE, 6, +5.0f},
+    {MDL_LARGEPULSE, 8, -6.0f},
+    {MDL_LARGEPULSE, 8, +6.0f},
+    {MDL_LARGEPULSE, 7, -6.0f},
+    {MDL_LARGEPULSE, 7, +6.0f}
+};
+
+#endif
@@ -6,6 +6,7 @@
 ** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
 **          -fwhole-program -g0 -s -o utkdecode-bnb utkdecode-bnb.c
 */
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h */
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
@@ -15,56 +16,35 @@
 #include "io.h"
 #include "eachunk.h"
 
-#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((d)<<24))
-#define ROUND(x) ((x) >= 0.0f ? ((x)+0.5f) : ((x)-0.5f))
 #define MIN(x,y) ((x)<(y)?(x):(y))
-#define MAX(x,y) ((x)>(y)?(x):(y))
-#define CLAMP(x,min,max) MIN(MAX(x,min),max)
+
+/* samples decoded per write; a multiple of the 432-sample frame */
+#define UTK_BLOCK_SAMPLES (16*432)
 
 typedef struct PTContext {
-    FILE *infp, *outfp;
-    uint32_t num_samples;
-    uint32_t compression_type;
+    OutputFile *out;
+    int use_float;
+    EAStream stream;
     UTKContext utk;
+    int16_t pcm[UTK_BLOCK_SAMPLES];
+    float pcm_float[UTK_BLOCK_SAMPLES];
 } PTContext;
 
-static void pt_read_header(PTContext *pt)
+static void pt_read_header(PTContext *pt, const uint8_t *data, size_t size)
 {
-    EAChunk *chunk = read_chunk(pt->infp);
+    EAStream *s = &pt->stream;
+    int ret;
 
-    if ((chunk->type & 0xffff) != MAKE_U32('P','T','\x00','\x00')) {
+    ret = ea_open_pt(s, data, size);
+    if (ret == UTK_ERR_BAD_SIGNATURE) {
         fprintf(stderr, "error: expected PT chunk\n");
         exit(EXIT_FAILURE);
-    }
-
-    while (1) {
-        uint8_t cmd = chunk_read_u8(chunk);
-        if (cmd == 0xFD) {
-            while (1) {
-                uint8_t key = chunk_read_u8(chunk);
-                uint32_t value = chunk_read_var_int(chunk);
-
-                if (key == 0xFF)
-                    break;
-                else if (key == 0x85)
-                    pt->num_samples = value;
-                else if (key == 0x83)
-                    pt->compression_type = value;
-            }
-            break;
-        } else {
-            chunk_read_var_int(chunk);
-        }
-    }
-
-    if (pt->compression_type != 9) {
+    } else if (ret == UTK_ERR_UNSUPPORTED) {
         fprintf(stderr, "error: invalid compression type %u (expected 9 for MicroTalk 10:1)\n",
-                (unsigned)pt->compression_type);
+                (unsigned)s->hdr.compression_type);
         exit(EXIT_FAILURE);
-    }
-
-    if (pt->num_samples >= 0x01000000) {
-        fprintf(stderr, "error: invalid num_samples %u\n", pt->num_samples);
+    } else if (ret != UTK_OK) {
+        fprintf(stderr, "error: invalid PT header: %s\n", utk_error_string(ret));
         exit(EXIT_FAILURE);
     }
 
@@ -72,37 +52,26 @@ static void pt_read_header(PTContext *pt)
     utk_init(&pt->utk);
 
     /* Write the WAV header. */
-    write_u32(pt->outfp, MAKE_U32('R','I','F','F'));
-    write_u32(pt->outfp, 36 + pt->num_samples*2);
-    write_u32(pt->outfp, MAKE_U32('W','A','V','E'));
-    write_u32(pt->outfp, MAKE_U32('f','m','t',' '));
-    write_u32(pt->outfp, 16);
-    write_u16(pt->outfp, 1);
-    write_u16(pt->outfp, 1);
-    write_u32(pt->outfp, 22050);
-    write_u32(pt->outfp, 22050*2);
-    write_u16(pt->outfp, 2);
-    write_u16(pt->outfp, 16);
-    write_u32(pt->outfp, MAKE_U32('d','a','t','a'));
-    write_u32(pt->outfp, pt->num_samples*2);
+    write_wav_header(pt->out->fp, 22050, s->hdr.num_samples, pt->use_float);
+    output_map(pt->out, wav_file_size(s->hdr.num_samples, pt->use_float));
 }
 
 static void pt_decode(PTContext *pt)
 {
     UTKContext *utk = &pt->utk;
-    uint32_t num_samples = pt->num_samples;
+    uint32_t num_samples = pt->stream.hdr.num_samples;
 
-    utk_set_fp(utk, pt->infp);
+    utk_set_ptr(utk, pt->stream.next, pt->stream.end);
 
     while (num_samples > 0) {
-        int count = MIN(num_samples, 432);
-        int i;
+        uint32_t count = MIN(num_samples, UTK_BLOCK_SAMPLES);
 
-        utk_decode_frame(utk);
-
-        for (i = 0; i < count; i++) {
-            int x = ROUND(pt->utk.decompressed_frame[i]);
-            write_u16(pt->outfp, (int16_t)CLAMP(x, -32768, 32767));
+        if (pt->use_float) {
+            utk_decode_f32(utk, pt->pcm_float, count);
+            output_f32(pt->out, pt->pcm_float, count);
+        } else {
+            utk_decode_s16(utk, pt->pcm, count);
+            output_s16(pt->out, pt->pcm, count);
         }
 
         num_samples -= count;
@@ -111,20 +80,28 @@ static void pt_decode(PTContext *pt)
 
 int main(int argc, char *argv[])
 {
-    PTContext pt;
+    static PTContext pt;
     const char *infile, *outfile;
-    FILE *infp, *outfp;
+    InputFile in;
+    OutputFile out;
     int force = 0;
+    int use_float = 0;
 
     /* Parse arguments. */
-    if (argc == 4 && !strcmp(argv[1], "-f")) {
-        force = 1;
+    while (argc > 3 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-f"))
+            force = 1;
+        else if (!strcmp(argv[1], "--float"))
+            use_float = 1;
+        else
+            break;
         argv++, argc--;
     }
 
     if (argc != 3) {
-        printf("Usage: utkdecode-bnb [-f] infile outfile\n");
-        printf("Decode Beasts & Bumpkins M10 to wav.\n");
+        printf("Usage: utkdecode-bnb [-f] [--float] infile outfile\n");
+        printf("Decode Beasts & Bumpkins M10 to wav (16-bit, or 32-bit float with --float).\n");
+        printf("Use - to read from stdin or write to stdout.\n");
         return EXIT_FAILURE;
     }
 
@@ -132,36 +109,18 @@ int main(int argc, char *argv[])
     outfile = argv[2];
 
     /* Open the input/output files. */
-    infp = fopen(infile, "rb");
-    if (!infp) {
-        fprintf(stderr, "error: failed to open '%s' for reading: %s\n", infile, strerror(errno));
-        return EXIT_FAILURE;
-    }
-
-    if (!force && fopen(outfile, "rb")) {
-        fprintf(stderr, "error: '%s' already exists\n", outfile);
-        return EXIT_FAILURE;
-    }
-
-    outfp = fopen(outfile, "wb");
-    if (!outfp) {
-        fprintf(stderr, "error: failed to create '%s': %s\n", outfile, strerror(errno));
-        return EXIT_FAILURE;
-    }
+    open_input(&in, infile);
+    open_output(&out, outfile, force);
 
     memset(&pt, 0, sizeof(pt));
-    pt.infp = infp;
-    pt.outfp = outfp;
+    pt.out = &out;
+    pt.use_float = use_float;
 
-    pt_read_header(&pt);
+    pt_read_header(&pt, in.data, in.size);
     pt_decode(&pt);
 
-    if (fclose(outfp) != 0) {
-        fprintf(stderr, "error: failed to close '%s': %s\n", outfile, strerror(errno));
-        return EXIT_FAILURE;
-    }
-
-    fclose(infp);
+    close_output(&out);
+    close_input(&in);
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -4,226 +4,549 @@
 ** Authors: Andrew D'Addesio
 ** License: Public domain
 ** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
-**          -fwhole-program -g0 -s -o utkdecode-fifa utkdecode-fifa.c
+**          -fwhole-program -g0 -s -pthread -o utkdecode-fifa utkdecode-fifa.c
+**          (add -DUTK_NO_THREADS where pthreads are not available)
 */
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h and pthreads */
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
+#ifndef UTK_NO_THREADS
+#include <pthread.h>
+#include <unistd.h>
+#endif
 #include "utk.h"
 #include "io.h"
 #include "eachunk.h"
 
-#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((d)<<24))
-#define ROUND(x) ((x) >= 0.0f ? ((x)+0.5f) : ((x)-0.5f))
 #define MIN(x,y) ((x)<(y)?(x):(y))
-#define MAX(x,y) ((x)>(y)?(x):(y))
-#define CLAMP(x,min,max) MIN(MAX(x,min),max)
 
+#define MAX_THREADS 64
+
+/* samples buffered per write */
+#define UTK_BLOCK_SAMPLES (16*432)
+
+/* The decoder of one stream at a time. */
 typedef struct EAContext {
-    FILE *infp, *outfp;
-    uint32_t audio_pos;
-    uint32_t num_samples;
-    uint32_t num_data_chunks;
-    uint32_t compression_type;
-    uint32_t codec_revision;
+    OutputFile *out;
+    EAStream stream;
+    EADataChunk *index; /* of the SCDl chunks */
+    char error[160];
     UTKContext utk;
+    uint32_t out_pos;
+    int16_t pcm[UTK_BLOCK_SAMPLES];
+    float pcm_float[UTK_BLOCK_SAMPLES];
 } EAContext;
 
-static void ea_read_schl(EAContext *ea)
+/* One SCxl stream of the input, from its SCHl chunk up to the next stream. */
+typedef struct Job {
+    const uint8_t *data;
+    size_t size;
+    EAStream stream;  /* as found by ea_skip_scxl */
+    int scan_error;
+    int selected;
+    char *out_path;
+    int done;
+    int io_error;     /* errno value */
+    const char *io_what;
+    int error;        /* UTK_* error code; the message is in error_string */
+    char error_string[160];
+} Job;
+
+static Job *jobs;
+static size_t num_jobs;
+static size_t *order;  /* the selected jobs, largest first */
+static size_t num_selected;
+static size_t next_job;
+static int force;
+static int use_float;
+#ifndef UTK_NO_THREADS
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t job_done = PTHREAD_COND_INITIALIZER;
+#define LOCK() pthread_mutex_lock(&lock)
+#define UNLOCK() pthread_mutex_unlock(&lock)
+#define SIGNAL_DONE() pthread_cond_broadcast(&job_done)
+#else
+#define LOCK() ((void)0)
+#define UNLOCK() ((void)0)
+#define SIGNAL_DONE() ((void)0)
+#endif
+
+static void fail(const char *what)
 {
-    uint32_t id;
-    EAChunk *chunk = read_chunk(ea->infp);
-
-    if (chunk->type != MAKE_U32('S','C','H','l')) {
-        fprintf(stderr, "error: expected SCHl chunk\n");
-        exit(EXIT_FAILURE);
-    }
-
-    id = chunk_read_u32(chunk);
-    if ((id & 0xffff) != MAKE_U32('P','T','\x00','\x00')) {
-        fprintf(stderr, "error: expected PT chunk in SCHl header\n");
-        exit(EXIT_FAILURE);
-    }
-
-    while (1) {
-        uint8_t cmd = chunk_read_u8(chunk);
-        if (cmd == 0xFD) {
-            while (1) {
-                uint8_t key = chunk_read_u8(chunk);
-                uint32_t value = chunk_read_var_int(chunk);
-
-                if (key == 0xFF)
-                    break;
-                else if (key == 0x80)
-                    ea->codec_revision = value;
-                else if (key == 0x85)
-                    ea->num_samples = value;
-                else if (key == 0xA0)
-                    ea->compression_type = value;
-            }
-            break;
-        } else {
-            chunk_read_var_int(chunk);
-        }
+    fprintf(stderr, "error: %s\n", what);
+    exit(EXIT_FAILURE);
+}
+
+/*
+** Decoding.
+*/
+
+static void ea_flush(EAContext *ea)
+{
+    if (use_float)
+        output_f32(ea->out, ea->pcm_float, ea->out_pos);
+    else
+        output_s16(ea->out, ea->pcm, ea->out_pos);
+
+    ea->out_pos = 0;
+}
+
+/* Parse the stream and index its SCDl chunks, before writing anything. On
+** failure, the error is described in ea->error. */
+static int ea_open(EAContext *ea, const uint8_t *data, size_t size)
+{
+    EAStream *s = &ea->stream;
+    int ret;
+
+    ret = ea_open_scxl(s, data, size);
+    if (ret == UTK_ERR_UNSUPPORTED) {
+        sprintf(ea->error, "invalid compression type %u (expected 4 for MicroTalk 10:1 or 22 for MicroTalk 5:1)",
+                (unsigned)s->hdr.codec_type);
+        return ret;
+    } else if (ret != UTK_OK) {
+        sprintf(ea->error, "failed to read SCHl/SCCl header: %s", utk_error_string(ret));
+        return ret;
+    }
+
+    /* an SCDl chunk takes at least 17 bytes, which bounds the index */
+    if (s->num_chunks > (size_t)(s->end - s->next) / 17) {
+        sprintf(ea->error, "failed to read SCDl chunk: %s", utk_error_string(UTK_ERR_EOF));
+        return UTK_ERR_EOF;
+    }
+
+    free(ea->index);
+    ea->index = malloc(s->num_chunks * sizeof(*ea->index) + 1);
+    if (!ea->index) {
+        strcpy(ea->error, utk_error_string(UTK_ERR_NOMEM));
+        return UTK_ERR_NOMEM;
+    }
+
+    ret = ea_index_scxl(s, ea->index);
+    if (ret != UTK_OK) {
+        sprintf(ea->error, "failed to read SCDl chunk: %s", utk_error_string(ret));
+        return ret;
     }
 
-    if (ea->compression_type != 4 && ea->compression_type != 22) {
-        fprintf(stderr, "error: invalid compression type %u (expected 4 for MicroTalk 10:1 or 22 for MicroTalk 5:1)\n",
-                (unsigned)ea->compression_type);
-        exit(EXIT_FAILURE);
+    if (s->sample_pos != s->hdr.num_samples) {
+        strcpy(ea->error, "failed to decode the correct number of samples");
+        return UTK_ERR_BAD_CHUNK;
     }
 
-    if (ea->num_samples >= 0x01000000) {
-        fprintf(stderr, "error: invalid num_samples %u\n", ea->num_samples);
-        exit(EXIT_FAILURE);
+    ret = ea_read_scel(s);
+    if (ret != UTK_OK) {
+        sprintf(ea->error, "failed to read SCEl chunk: %s", utk_error_string(ret));
+        return ret;
     }
 
     /* Initialize the decoder. */
     utk_init(&ea->utk);
+    ea->out_pos = 0;
 
-    /* Write the WAV header. */
-    write_u32(ea->outfp, MAKE_U32('R','I','F','F'));
-    write_u32(ea->outfp, 36 + ea->num_samples*2);
-    write_u32(ea->outfp, MAKE_U32('W','A','V','E'));
-    write_u32(ea->outfp, MAKE_U32('f','m','t',' '));
-    write_u32(ea->outfp, 16);
-    write_u16(ea->outfp, 1);
-    write_u16(ea->outfp, 1);
-    write_u32(ea->outfp, 22050);
-    write_u32(ea->outfp, 22050*2);
-    write_u16(ea->outfp, 2);
-    write_u16(ea->outfp, 16);
-    write_u32(ea->outfp, MAKE_U32('d','a','t','a'));
-    write_u32(ea->outfp, ea->num_samples*2);
+    return UTK_OK;
 }
 
-static void ea_read_sccl(EAContext *ea)
+static int ea_decode_chunk(EAContext *ea, const EADataChunk *chunk)
 {
-    EAChunk *chunk = read_chunk(ea->infp);
+    UTKContext *utk = &ea->utk;
+    uint32_t num_samples = chunk->num_samples;
+
+    utk_set_ptr(utk, chunk->ptr, chunk->end);
+
+    while (num_samples > 0) {
+        int count = MIN(num_samples, 432);
 
-    if (chunk->type != MAKE_U32('S','C','C','l')) {
-        fprintf(stderr, "error: expected SCCl chunk\n");
-        exit(EXIT_FAILURE);
+        if (ea->stream.hdr.codec_revision >= 3) {
+            if (utk_rev3_decode_frame(utk) != UTK_OK) {
+                strcpy(ea->error, utk_error_string(UTK_ERR_BAD_PCM));
+                return UTK_ERR_BAD_PCM;
+            }
+        } else {
+            utk_decode_frame(utk);
+        }
+
+        if (ea->out_pos + count > UTK_BLOCK_SAMPLES)
+            ea_flush(ea);
+
+        if (use_float)
+            utk_convert_f32(&ea->pcm_float[ea->out_pos], utk->decompressed_frame, count);
+        else
+            utk_convert_s16(&ea->pcm[ea->out_pos], utk->decompressed_frame, count);
+
+        ea->out_pos += count;
+        num_samples -= count;
     }
 
-    ea->num_data_chunks = chunk_read_u32(chunk);
-    if (ea->num_data_chunks >= 0x01000000) {
-        fprintf(stderr, "error: invalid num_data_chunks %u\n", (unsigned)ea->num_data_chunks);
-        exit(EXIT_FAILURE);
+    return UTK_OK;
+}
+
+static void decode_stream(EAContext *ea, Job *job)
+{
+    OutputFile out;
+    uint32_t i;
+    int ret;
+
+    job->error = ea_open(ea, job->data, job->size);
+    if (job->error != UTK_OK) {
+        strcpy(job->error_string, ea->error);
+        return;
     }
+
+    job->io_what = "create";
+    job->io_error = create_output(&out, job->out_path, force);
+    if (job->io_error)
+        return;
+
+    /* Write the WAV header. */
+    ea->out = &out;
+    write_wav_header(out.fp, 22050, ea->stream.hdr.num_samples, use_float);
+    output_map(&out, wav_file_size(ea->stream.hdr.num_samples, use_float));
+
+    for (i = 0; i < ea->stream.num_chunks && job->error == UTK_OK; i++)
+        job->error = ea_decode_chunk(ea, &ea->index[i]);
+
+    if (job->error == UTK_OK)
+        ea_flush(ea);
+    else
+        strcpy(job->error_string, ea->error);
+
+    job->io_what = "write";
+    ret = finish_output(&out);
+    if (job->error == UTK_OK)
+        job->io_error = ret;
+
+    /* don't leave truncated files behind */
+    if ((job->error != UTK_OK || job->io_error) && strcmp(job->out_path, "-"))
+        remove(job->out_path);
 }
 
-static void ea_read_scdl(EAContext *ea)
+static void *worker(void *arg)
 {
-    EAChunk *chunk = read_chunk(ea->infp);
-    UTKContext *utk = &ea->utk;
-    uint32_t num_samples;
+    EAContext *ea = malloc(sizeof(*ea));
+
+    (void)arg;
+    if (!ea)
+        fail("out of memory");
+    memset(ea, 0, sizeof(*ea));
+
+    for (;;) {
+        Job *job;
+
+        LOCK();
+        if (next_job == num_selected) {
+            UNLOCK();
+            break;
+        }
+        job = &jobs[order[next_job++]];
+        UNLOCK();
+
+        decode_stream(ea, job);
 
-    if (chunk->type != MAKE_U32('S','C','D','l')) {
-        fprintf(stderr, "error: expected SCDl chunk\n");
-        exit(EXIT_FAILURE);
+        LOCK();
+        job->done = 1;
+        SIGNAL_DONE();
+        UNLOCK();
     }
 
-    num_samples = chunk_read_u32(chunk);
-    chunk_read_u32(chunk); /* unknown */
-    chunk_read_u8(chunk);  /* unknown */
+    free(ea->index);
+    free(ea);
 
-    if (num_samples > ea->num_samples - ea->audio_pos)
-        num_samples = ea->num_samples - ea->audio_pos;
+    return NULL;
+}
 
-    utk_set_ptr(utk, chunk->ptr, chunk->end);
+/*
+** Streams.
+*/
 
-    while (num_samples > 0) {
-        int count = MIN(num_samples, 432);
-        int i;
+static Job *add_job(const uint8_t *data)
+{
+    static size_t capacity;
 
-        if (ea->codec_revision >= 3)
-            utk_rev3_decode_frame(utk);
+    if (num_jobs == capacity) {
+        Job *p;
+
+        capacity = capacity ? 2*capacity : 64;
+        p = realloc(jobs, capacity * sizeof(*jobs));
+        if (!p)
+            fail("out of memory");
+        jobs = p;
+    }
+
+    memset(&jobs[num_jobs], 0, sizeof(*jobs));
+    jobs[num_jobs].data = data;
+
+    return &jobs[num_jobs++];
+}
+
+/* Find the SCxl streams in the input. The first one starts at the start of
+** the input; each of the others at the next SCHl tag after the end of the
+** one before, or, if that one is corrupt, after its SCHl tag. */
+static void find_streams(const uint8_t *data, size_t size)
+{
+    const uint8_t *ptr = data, *end = data + size;
+
+    do {
+        Job *job = add_job(ptr);
+
+        job->scan_error = ea_skip_scxl(&job->stream, ptr, (size_t)(end - ptr));
+        if (job->scan_error == UTK_OK)
+            ptr = job->stream.next;
         else
-            utk_decode_frame(utk);
+            ptr = end - ptr > 4 ? ea_find_scxl(ptr + 4, end) : end;
+
+        job->size = (size_t)(ptr - job->data);
+        ptr = ea_find_scxl(ptr, end);
+    } while (ptr != end);
+}
 
-        for (i = 0; i < count; i++) {
-            int x = ROUND(ea->utk.decompressed_frame[i]);
-            write_u16(ea->outfp, (int16_t)CLAMP(x, -32768, 32767));
+/* Select the streams in a list like 0,2-5 (or all of them). */
+static void select_streams(const char *list)
+{
+    const char *p = list;
+    size_t i;
+
+    if (!list) {
+        for (i = 0; i < num_jobs; i++)
+            jobs[i].selected = 1;
+        return;
+    }
+
+    for (;;) {
+        char *q;
+        unsigned long first, last;
+
+        first = last = strtoul(p, &q, 10);
+        if (q == p)
+            break;
+        if (*q == '-') {
+            p = q + 1;
+            last = strtoul(p, &q, 10);
+            if (q == p || last < first)
+                break;
         }
 
-        ea->audio_pos += count;
-        num_samples -= count;
+        if (last >= num_jobs) {
+            fprintf(stderr, "error: no stream %lu (the input has %lu)\n",
+                    last, (unsigned long)num_jobs);
+            exit(EXIT_FAILURE);
+        }
+
+        for (i = first; i <= last; i++)
+            jobs[i].selected = 1;
+
+        if (*q == '\0')
+            return;
+        if (*q != ',')
+            break;
+        p = q + 1;
     }
+
+    fprintf(stderr, "error: invalid stream list '%s'\n", list);
+    exit(EXIT_FAILURE);
 }
 
-static void ea_read_scel(const EAContext *ea)
+/* The output path of stream i when several are selected: outfile without
+** its extension, then -i.wav (e.g. out.wav -> out-003.wav). */
+static char *make_out_path(const char *outfile, size_t i)
 {
-    EAChunk *chunk = read_chunk(ea->infp);
+    const char *name = strrchr(outfile, '/') ? strrchr(outfile, '/') + 1 : outfile;
+    const char *ext = strrchr(name, '.');
+    size_t len = (ext && ext != name) ? (size_t)(ext - outfile) : strlen(outfile);
+    char *out = malloc(len + 32);
 
-    if (chunk->type != MAKE_U32('S','C','E','l')) {
-        fprintf(stderr, "error: expected SCEl chunk\n");
-        exit(EXIT_FAILURE);
-    }
+    if (!out)
+        fail("out of memory");
+
+    sprintf(out, "%.*s-%03lu.wav", (int)len, outfile, (unsigned long)i);
+
+    return out;
+}
+
+static int compare_size(const void *a, const void *b)
+{
+    const Job *x = &jobs[*(const size_t *)a], *y = &jobs[*(const size_t *)b];
+
+    if (x->stream.hdr.num_samples != y->stream.hdr.num_samples)
+        return x->stream.hdr.num_samples < y->stream.hdr.num_samples ? 1 : -1;
+    return (*(const size_t *)a > *(const size_t *)b) - (*(const size_t *)a < *(const size_t *)b);
+}
+
+/*
+** Reporting.
+*/
+
+static void list_streams(void)
+{
+    size_t i;
 
-    if (ea->audio_pos != ea->num_samples) {
-        fprintf(stderr, "error: failed to decode the correct number of samples\n");
-        exit(EXIT_FAILURE);
+    for (i = 0; i < num_jobs; i++) {
+        const Job *job = &jobs[i];
+
+        printf("%3lu: offset %lu, ", (unsigned long)i, (unsigned long)(job->data - jobs[0].data));
+
+        if (job->stream.parsed_header)
+            printf("SCxl rev %u, %lu samples (%.2f s)", (unsigned)MIN(job->stream.hdr.codec_revision, 99),
+                   (unsigned long)job->stream.hdr.num_samples, job->stream.hdr.num_samples / 22050.0);
+        if (job->scan_error != UTK_OK)
+            printf("%serror: %s", job->stream.parsed_header ? ", " : "", utk_error_string(job->scan_error));
+
+        printf("\n");
     }
 }
 
+/* Print the result of a job, to stderr with one stream, or as one line per
+** stream to stdout with several. */
+static void print_job(const Job *job, size_t i)
+{
+    FILE *fp = num_selected > 1 ? stdout : stderr;
+
+    if (num_selected > 1)
+        fprintf(fp, "stream %lu: ", (unsigned long)i);
+
+    if (job->io_error == EEXIST && !force && !strcmp(job->io_what, "create"))
+        fprintf(fp, "error: '%s' already exists\n", job->out_path);
+    else if (job->io_error)
+        fprintf(fp, "error: failed to %s '%s': %s\n", job->io_what, job->out_path,
+                strerror(job->io_error));
+    else if (job->error != UTK_OK)
+        fprintf(fp, "error: %s\n", job->error_string);
+    else if (num_selected > 1)
+        fprintf(fp, "%lu samples -> %s\n", (unsigned long)job->stream.hdr.num_samples, job->out_path);
+}
+
 int main(int argc, char *argv[])
 {
-    EAContext ea;
-    const char *infile, *outfile;
-    FILE *infp, *outfp;
-    int force = 0;
-    unsigned int i;
-
-    if (argc == 4 && !strcmp(argv[1], "-f")) {
-        force = 1;
+#ifndef UTK_NO_THREADS
+    pthread_t threads[MAX_THREADS];
+    long num_threads = sysconf(_SC_NPROCESSORS_ONLN);
+#endif
+    const char *infile, *outfile = NULL;
+    const char *select = "0";
+    int select_given = 0;
+    InputFile in;
+    size_t i, num_errors = 0;
+    int list = 0;
+
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+        if (!strcmp(argv[1], "-f")) {
+            force = 1;
+        } else if (!strcmp(argv[1], "--float")) {
+            use_float = 1;
+        } else if (!strcmp(argv[1], "-l")) {
+            list = 1;
+        } else if (!strcmp(argv[1], "-a")) {
+            select = NULL;
+            select_given = 1;
+        } else if (!strcmp(argv[1], "-s") && argc > 2) {
+            select = argv[2];
+            select_given = 1;
+            argv++, argc--;
+#ifndef UTK_NO_THREADS
+        } else if (!strcmp(argv[1], "-j") && argc > 2) {
+            num_threads = atol(argv[2]);
+            argv++, argc--;
+#endif
+        } else {
+            break;
+        }
         argv++, argc--;
     }
 
-    if (argc != 3) {
-        printf("Usage: utkdecode-fifa [-f] infile outfile\n");
-        printf("Decode FIFA 2001/2002 MicroTalk to wav.\n");
+    if (argc != (list ? 2 : 3) || (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0')) {
+        printf("Usage: utkdecode-fifa [-f] [--float] [-a | -s list] [-j jobs] infile outfile\n");
+        printf("       utkdecode-fifa -l infile\n");
+        printf("Decode FIFA 2001/2002 MicroTalk to wav (16-bit, or 32-bit float with --float).\n");
+        printf("Use - to read from stdin or write to stdout.\n");
+        printf("An input may hold several SCxl streams (e.g. a sound bank):\n");
+        printf("  -l       list the streams\n");
+        printf("  -s list  decode the streams in list, e.g. 0,2-5 (default: 0)\n");
+        printf("  -a       decode all of the streams\n");
+        printf("  -j       number of streams to decode at once (default: number of CPUs)\n");
+        printf("With several streams, outfile is a name pattern: out.wav -> out-000.wav, ...\n");
         return EXIT_FAILURE;
     }
 
     infile = argv[1];
-    outfile = argv[2];
+    if (!list)
+        outfile = argv[2];
 
-    infp = fopen(infile, "rb");
-    if (!infp) {
-        fprintf(stderr, "error: failed to open '%s' for reading: %s\n", infile, strerror(errno));
-        return EXIT_FAILURE;
-    }
+    open_input(&in, infile);
+    find_streams(in.data, in.size);
 
-    if (!force && fopen(outfile, "rb")) {
-        fprintf(stderr, "error: '%s' already exists\n", outfile);
-        return EXIT_FAILURE;
+    if (list) {
+        list_streams();
+        close_input(&in);
+        return EXIT_SUCCESS;
     }
 
-    outfp = fopen(outfile, "wb");
-    if (!outfp) {
-        fprintf(stderr, "error: failed to create '%s': %s\n", outfile, strerror(errno));
-        return EXIT_FAILURE;
+    select_streams(select);
+
+    order = malloc(num_jobs * sizeof(*order));
+    if (!order)
+        fail("out of memory");
+
+    for (i = 0; i < num_jobs; i++) {
+        if (jobs[i].selected)
+            order[num_selected++] = i;
     }
 
-    memset(&ea, 0, sizeof(ea));
-    ea.infp = infp;
-    ea.outfp = outfp;
+    if (num_selected > 1 && !strcmp(outfile, "-"))
+        fail("several streams can't be written to stdout");
 
-    ea_read_schl(&ea);
-    ea_read_sccl(&ea);
+    for (i = 0; i < num_selected; i++)
+        jobs[order[i]].out_path = num_selected > 1 ? make_out_path(outfile, order[i]) : (char *)outfile;
 
-    for (i = 0; i < ea.num_data_chunks; i++)
-        ea_read_scdl(&ea);
+    if (!select_given && num_jobs > 1)
+        fprintf(stderr, "note: decoding stream 0 of %lu (use -a or -s to decode the others)\n",
+                (unsigned long)num_jobs);
 
-    ea_read_scel(&ea);
+    /* Start the longest streams first, so that a few long streams at the end
+    ** don't leave one thread working while the others are idle. */
+    qsort(order, num_selected, sizeof(*order), compare_size);
 
-    if (!outfp) {
-        fprintf(stderr, "error: failed to close '%s': %s\n", outfile, strerror(errno));
-        return EXIT_FAILURE;
+#ifndef UTK_NO_THREADS
+    if (num_threads < 1)
+        num_threads = 1;
+    if (num_threads > MAX_THREADS)
+        num_threads = MAX_THREADS;
+    if ((size_t)num_threads > num_selected)
+        num_threads = (long)num_selected;
+
+    for (i = 0; i < (size_t)num_threads; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0)
+            fail("failed to create thread");
+    }
+#else
+    worker(NULL);
+#endif
+
+    /* Print the results in order as they come in. */
+    for (i = 0; i < num_jobs; i++) {
+        Job *job = &jobs[i];
+
+        if (!job->selected)
+            continue;
+
+#ifndef UTK_NO_THREADS
+        pthread_mutex_lock(&lock);
+        while (!job->done)
+            pthread_cond_wait(&job_done, &lock);
+        pthread_mutex_unlock(&lock);
+#endif
+
+        print_job(job, i);
+        if (job->io_error || job->error != UTK_OK)
+            num_errors++;
     }
 
-    return EXIT_SUCCESS;
-}
\ No newline at end of file
+#ifndef UTK_NO_THREADS
+    for (i = 0; i < (size_t)num_threads; i++)
+        pthread_join(threads[i], NULL);
+#endif
+
+    close_input(&in);
+
+    return num_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
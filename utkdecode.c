@@ -4,26 +4,146 @@
 ** Authors: Andrew D'Addesio
 ** License: Public domain
 ** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
-**          -fwhole-program -g0 -s -o utkdecode utkdecode.c
+**          -fwhole-program -g0 -s -pthread -o utkdecode utkdecode.c -lm
+**          (add -DUTK_FIXED to use the fixed-point decoder, -DUTK_STATS
+**          for --stats, or -DUTK_NO_THREADS where pthreads are not
+**          available)
 */
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h and pthreads */
 #include <stdint.h>
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
 #include <errno.h>
 #include "utk.h"
+#include "utkpar.h"
+#ifdef UTK_FIXED
+#include "utkfixed.h"
+#else
+#include "utkresample.h"
+#ifdef UTK_STATS
+#include "utkstats.h"
+#endif
+#ifndef UTK_NO_THREADS
+#include <pthread.h>
+#endif
+#endif
 #include "io.h"
 
 #define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((d)<<24))
-#define ROUND(x) ((x) >= 0.0f ? ((x)+0.5f) : ((x)-0.5f))
 #define MIN(x,y) ((x)<(y)?(x):(y))
-#define MAX(x,y) ((x)>(y)?(x):(y))
-#define CLAMP(x,min,max) MIN(MAX(x,min),max)
+
+/* the most segments that --parallel decodes at once */
+#define MAX_THREADS 64
+
+/* samples decoded per write; a multiple of the 432-sample frame */
+#define UTK_BLOCK_SAMPLES (16*432)
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "error: %s\n", what);
+    exit(EXIT_FAILURE);
+}
+
+#ifndef UTK_FIXED
+/* One segment of a --parallel decode. */
+typedef struct ParJob {
+    const UTKParPlan *plan;
+    uint32_t segment;
+    const uint8_t *ptr, *end;
+    int16_t *pcm;      /* all of the samples of the stream, */
+    float *pcm_float;  /* or with --float, these */
+} ParJob;
+
+static void *decode_segment(void *arg)
+{
+    const ParJob *job = arg;
+    UTKContext *ctx = malloc(sizeof(*ctx));
+
+    if (!ctx)
+        fail(utk_error_string(UTK_ERR_NOMEM));
+
+    if (job->pcm_float)
+        utk_par_decode_f32(ctx, job->plan, job->segment, job->ptr, job->end, job->pcm_float);
+    else
+        utk_par_decode_s16(ctx, job->plan, job->segment, job->ptr, job->end, job->pcm);
+
+    free(ctx);
+
+    return NULL;
+}
+
+/* Decode the bitstream in [ptr, end) in num_threads segments at once, each
+** starting warmup frames early (see utkpar.h), and write it to out. */
+static void decode_parallel(OutputFile *out, const uint8_t *ptr, const uint8_t *end,
+                            uint32_t num_samples, int use_float,
+                            uint32_t num_threads, uint32_t warmup)
+{
+    UTKParPlan plan;
+    ParJob jobs[MAX_THREADS];
+#ifndef UTK_NO_THREADS
+    pthread_t threads[MAX_THREADS];
+#endif
+    int16_t *pcm = NULL;
+    float *pcm_float = NULL;
+    uint32_t i;
+    int ret;
+
+    ret = utk_par_plan(&plan, ptr, end, num_samples, num_threads, warmup);
+    if (ret != UTK_OK)
+        fail(utk_error_string(ret));
+
+    if (use_float)
+        pcm_float = malloc((size_t)num_samples * sizeof(float) + 1);
+    else
+        pcm = malloc((size_t)num_samples * sizeof(int16_t) + 1);
+    if (!pcm && !pcm_float)
+        fail(utk_error_string(UTK_ERR_NOMEM));
+
+    for (i = 0; i < plan.num_segments; i++) {
+        jobs[i].plan = &plan;
+        jobs[i].segment = i;
+        jobs[i].ptr = ptr;
+        jobs[i].end = end;
+        jobs[i].pcm = pcm;
+        jobs[i].pcm_float = pcm_float;
+#ifndef UTK_NO_THREADS
+        if (pthread_create(&threads[i], NULL, decode_segment, &jobs[i]) != 0)
+            fail("failed to create thread");
+#else
+        decode_segment(&jobs[i]);
+#endif
+    }
+
+#ifndef UTK_NO_THREADS
+    for (i = 0; i < plan.num_segments; i++)
+        pthread_join(threads[i], NULL);
+#endif
+
+    if (use_float)
+        output_f32(out, pcm_float, num_samples);
+    else
+        output_s16(out, pcm, num_samples);
+
+    free(pcm);
+    free(pcm_float);
+    utk_par_free(&plan);
+}
+#endif
 
 int main(int argc, char *argv[])
 {
     const char *infile, *outfile;
+#ifdef UTK_FIXED
+    UTKFixedContext ctx;
+#else
     UTKContext ctx;
+    UTKResampler resampler;
+#ifdef UTK_STATS
+    UTKStats stats;
+#endif
+#endif
+    UTKFileBuffer file;
     uint32_t sID;
     uint32_t dwOutSize;
     uint32_t dwWfxSize;
@@ -34,62 +154,125 @@ int main(int argc, char *argv[])
     uint16_t nBlockAlign;
     uint16_t wBitsPerSample;
     uint16_t cbSize;
-    uint32_t num_samples;
-    FILE *infp, *outfp;
+    uint64_t num_samples;
+    InputFile in;
+    OutputFile out;
+    const uint8_t *hdr;
+    uint8_t header[32];
+    int streaming = 0;
     int force = 0;
+    int use_float = 0;
+    uint32_t out_rate = 0;
+    int quality = 1;
+    const char *stats_path = NULL;
+    uint32_t num_threads = 0;
+    uint32_t warmup = UTK_PAR_DEFAULT_WARMUP;
     int error = 0;
-    int i;
+    static int16_t pcm[UTK_BLOCK_SAMPLES];
+    static float pcm_float[UTK_BLOCK_SAMPLES];
 
     /* Parse arguments. */
-    if (argc == 4 && !strcmp(argv[1], "-f")) {
-        force = 1;
+    while (argc > 3 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-f"))
+            force = 1;
+        else if (!strcmp(argv[1], "--float"))
+            use_float = 1;
+        else if (!strcmp(argv[1], "--rate") && argc > 4)
+            out_rate = (uint32_t)strtoul(argv[2], NULL, 10), argv++, argc--;
+        else if (!strcmp(argv[1], "--quality") && argc > 4)
+            quality = atoi(argv[2]), argv++, argc--;
+        else if (!strcmp(argv[1], "--stats") && argc > 4)
+            stats_path = argv[2], argv++, argc--;
+        else if (!strcmp(argv[1], "--parallel") && argc > 4)
+            num_threads = (uint32_t)strtoul(argv[2], NULL, 10), argv++, argc--;
+        else if (!strcmp(argv[1], "--warmup") && argc > 4)
+            warmup = (uint32_t)strtoul(argv[2], NULL, 10), argv++, argc--;
+        else
+            break;
         argv++, argc--;
     }
 
     if (argc != 3) {
-        printf("Usage: utkdecode [-f] infile outfile\n");
-        printf("Decode Maxis UTK to wav.\n");
+        printf("Usage: utkdecode [-f] [--float] [--rate hz] [--quality 0-2] [--stats file]\n");
+        printf("                 [--parallel threads [--warmup frames]] infile outfile\n");
+        printf("Decode Maxis UTK to wav (16-bit, or 32-bit float with --float).\n");
+        printf("With --rate, resample to the given rate (e.g. 44100 or 48000) at\n");
+        printf("quality 0 (fast), 1 (default) or 2 (best).\n");
+        printf("With --stats, write per-stream decoder statistics to file, as CSV if its\n");
+        printf("name ends in .csv, or else as JSON (needs a build with -DUTK_STATS).\n");
+        printf("With --parallel, decode the stream in that many segments (at most %d) at\n",
+               MAX_THREADS);
+        printf("once, each starting --warmup frames (default 12) early. This is faster on\n");
+        printf("long streams, but the first samples of each segment after the first are\n");
+        printf("approximate.\n");
+        printf("Use - to read from stdin or write to stdout.\n");
         return EXIT_FAILURE;
     }
 
-    infile = argv[1];
-    outfile = argv[2];
-
-    /* Open the input/output files. */
-    infp = fopen(infile, "rb");
-    if (!infp) {
-        fprintf(stderr, "error: failed to open '%s' for reading: %s\n", infile, strerror(errno));
+#ifdef UTK_FIXED
+    if (out_rate != 0) {
+        fprintf(stderr, "error: --rate is not supported by the fixed-point decoder\n");
         return EXIT_FAILURE;
     }
-
-    if (!force && fopen(outfile, "rb")) {
-        fprintf(stderr, "error: '%s' already exists\n", outfile);
+    (void)quality;
+    if (num_threads != 0) {
+        fprintf(stderr, "error: --parallel is not supported by the fixed-point decoder\n");
         return EXIT_FAILURE;
     }
-
-    outfp = fopen(outfile, "wb");
-    if (!outfp) {
-        fprintf(stderr, "error: failed to create '%s': %s\n", outfile, strerror(errno));
+    (void)warmup;
+#endif
+    if (num_threads > MAX_THREADS)
+        num_threads = MAX_THREADS;
+    if (num_threads != 0 && (out_rate != 0 || stats_path)) {
+        fprintf(stderr, "error: --parallel can't be combined with --rate or --stats\n");
+        return EXIT_FAILURE;
+    }
+#if !defined(UTK_STATS) || defined(UTK_FIXED)
+    if (stats_path) {
+        fprintf(stderr, "error: --stats needs the float decoder built with -DUTK_STATS\n");
+        return EXIT_FAILURE;
+    }
+#endif
+    if (out_rate != 0 && (out_rate < 8000 || out_rate > 192000)) {
+        fprintf(stderr, "error: invalid --rate %u\n", (unsigned)out_rate);
         return EXIT_FAILURE;
     }
 
-    /* Parse the UTK header. */
-    sID = read_u32(infp);
-    dwOutSize = read_u32(infp);
-    dwWfxSize = read_u32(infp);
-    wFormatTag = read_u16(infp);
-    nChannels = read_u16(infp);
-    nSamplesPerSec = read_u32(infp);
-    nAvgBytesPerSec = read_u32(infp);
-    nBlockAlign = read_u16(infp);
-    wBitsPerSample = read_u16(infp);
-    cbSize = read_u16(infp);
-    read_u16(infp); /* padding */
+    infile = argv[1];
+    outfile = argv[2];
+
+    /* Parse the UTK header. Standard input is decoded as it is read, so that
+    ** a stream of any length takes constant memory (except with --parallel,
+    ** which needs all of it). */
+    if (!strcmp(infile, "-") && num_threads == 0) {
+        read_bytes(stdin, header, 32);
+        hdr = header;
+        streaming = 1;
+    } else {
+        open_input(&in, infile);
+        if (in.size < 32) {
+            fprintf(stderr, "error: unexpected end of file\n");
+            return EXIT_FAILURE;
+        }
+        hdr = in.data;
+    }
+
+    sID = get_u32(hdr);
+    dwOutSize = get_u32(hdr+4);
+    dwWfxSize = get_u32(hdr+8);
+    wFormatTag = get_u16(hdr+12);
+    nChannels = get_u16(hdr+14);
+    nSamplesPerSec = get_u32(hdr+16);
+    nAvgBytesPerSec = get_u32(hdr+20);
+    nBlockAlign = get_u16(hdr+24);
+    wBitsPerSample = get_u16(hdr+26);
+    cbSize = get_u16(hdr+28);
+    /* (2 bytes of padding) */
 
     if (sID != MAKE_U32('U','T','M','0')) {
         fprintf(stderr, "error: not a valid UTK file (expected UTM0 signature)\n");
         return EXIT_FAILURE;
-    } else if ((dwOutSize & 0x01) != 0 || dwOutSize >= 0x01000000) {
+    } else if ((dwOutSize & 0x01) != 0) {
         fprintf(stderr, "error: invalid dwOutSize %u\n", (unsigned)dwOutSize);
         return EXIT_FAILURE;
     } else if (dwWfxSize != 20) {
@@ -129,44 +312,111 @@ int main(int argc, char *argv[])
 
     num_samples = dwOutSize/2;
 
+#ifndef UTK_FIXED
+    if (out_rate == nSamplesPerSec)
+        out_rate = 0;
+
+    if (out_rate != 0) {
+        int ret = utk_resample_init(&resampler, nSamplesPerSec, out_rate, quality);
+        if (ret != UTK_OK) {
+            fprintf(stderr, "error: cannot resample from %u to %u Hz: %s\n",
+                (unsigned)nSamplesPerSec, (unsigned)out_rate, utk_error_string(ret));
+            return EXIT_FAILURE;
+        }
+        nSamplesPerSec = out_rate;
+        num_samples = utk_resample_length(&resampler, num_samples);
+    }
+#endif
+
     /* Write the WAV header. */
-    write_u32(outfp, MAKE_U32('R','I','F','F'));
-    write_u32(outfp, 36 + num_samples*2);
-    write_u32(outfp, MAKE_U32('W','A','V','E'));
-    write_u32(outfp, MAKE_U32('f','m','t',' '));
-    write_u32(outfp, 16);
-    write_u16(outfp, wFormatTag);
-    write_u16(outfp, nChannels);
-    write_u32(outfp, nSamplesPerSec);
-    write_u32(outfp, nAvgBytesPerSec);
-    write_u16(outfp, nBlockAlign);
-    write_u16(outfp, wBitsPerSample);
-    write_u32(outfp, MAKE_U32('d','a','t','a'));
-    write_u32(outfp, num_samples*2);
+    open_output(&out, outfile, force);
+    write_wav_header(out.fp, nSamplesPerSec, num_samples, use_float);
+    output_map(&out, wav_file_size(num_samples, use_float));
 
     /* Decode. */
+#ifdef UTK_FIXED
+    utk_fixed_init(&ctx);
+    if (streaming)
+        utk_fixed_set_fp(&ctx, stdin, &file);
+    else
+        utk_fixed_set_ptr(&ctx, in.data + 32, in.data + in.size);
+#else
     utk_init(&ctx);
-    utk_set_fp(&ctx, infp);
+    if (streaming)
+        utk_set_fp(&ctx, stdin, &file);
+    else
+        utk_set_ptr(&ctx, in.data + 32, in.data + in.size);
+#ifdef UTK_STATS
+    utk_stats_init(&stats);
+    utk_stats_attach(&ctx, &stats);
+#endif
+#endif
 
-    while (num_samples > 0) {
-        int count = MIN(num_samples, 432);
+#ifndef UTK_FIXED
+    if (num_threads != 0) {
+        decode_parallel(&out, in.data + 32, in.data + in.size, (uint32_t)num_samples, use_float,
+                        num_threads, warmup);
+        num_samples = 0;
+    }
+#endif
 
-        utk_decode_frame(&ctx);
+    while (num_samples > 0) {
+        uint32_t count = (uint32_t)MIN(num_samples, UTK_BLOCK_SAMPLES);
 
-        for (i = 0; i < count; i++) {
-            int x = ROUND(ctx.decompressed_frame[i]);
-            write_u16(outfp, (int16_t)CLAMP(x, -32768, 32767));
+        if (use_float) {
+#ifdef UTK_FIXED
+            utk_fixed_decode_f32(&ctx, pcm_float, count);
+#else
+            if (out_rate != 0)
+                utk_decode_resampled_f32(&ctx, &resampler, dwOutSize/2, pcm_float, count);
+            else
+                utk_decode_f32(&ctx, pcm_float, count);
+#endif
+            output_f32(&out, pcm_float, count);
+        } else {
+#ifdef UTK_FIXED
+            utk_fixed_decode_s16(&ctx, pcm, count);
+#else
+            if (out_rate != 0)
+                utk_decode_resampled_s16(&ctx, &resampler, dwOutSize/2, pcm, count);
+            else
+                utk_decode_s16(&ctx, pcm, count);
+#endif
+            output_s16(&out, pcm, count);
         }
 
         num_samples -= count;
     }
 
-    if (fclose(outfp) != 0) {
-        fprintf(stderr, "error: failed to close '%s': %s\n", outfile, strerror(errno));
-        return EXIT_FAILURE;
-    }
+#ifndef UTK_FIXED
+    if (out_rate != 0)
+        utk_resample_free(&resampler);
+#endif
+    close_output(&out);
+    if (!streaming)
+        close_input(&in);
 
-    fclose(infp);
+#if defined(UTK_STATS) && !defined(UTK_FIXED)
+    if (stats_path) {
+        size_t len = strlen(stats_path);
+        FILE *fp = fopen(stats_path, "w");
+
+        if (!fp) {
+            fprintf(stderr, "error: failed to create '%s': %s\n", stats_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+
+        if (len >= 4 && !strcmp(stats_path + len - 4, ".csv"))
+            utk_stats_write_csv(fp, &stats);
+        else
+            utk_stats_write_json(fp, &stats);
+
+        if (fclose(fp) != 0) {
+            fprintf(stderr, "error: failed to write '%s': %s\n", stats_path, strerror(errno));
+            return EXIT_FAILURE;
+        }
+    }
+#endif
 
     return EXIT_SUCCESS;
-}
\ No newline at end of file
+}
@@ -0,0 +1,607 @@
+#ifndef UTKDSP_H
+#define UTKDSP_H
+
+/*
+** Subframe reconstruction kernels used by utk_decode_frame, the output
+** sample conversion used by utk_decode_s16 and utk_decode_f32, the FIR
+** dot product used by the resampler in utkresample.h, and the stereo
+** accumulation used by the mixer in utkmix.h.
+**
+** Each kernel has a plain C reference version (suffix _c). When the compiler
+** targets SSE2 or AVX (e.g. -msse2, -mavx2 or any x86-64 build), the
+** vectorized versions are used instead. Define UTK_NO_SIMD to force the
+** reference versions.
+**
+** The pitch mix and interpolation kernels perform the same operations in the
+** same order as the reference versions, so their output is identical. With
+** -ffast-math, the compiler may reorder the sums of the reference
+** interpolation. Such a build runs the reference interpolation, so that it
+** still decodes exactly as the reference does.
+**
+** The synthesis filter runs the reference recursion unless UTK_BLOCK_SYNTH
+** is defined. With it, subframes of UTK_SYNTH_BLOCK_MIN blocks or more go
+** through a vectorized filter instead. That filter evaluates the IIR twelve
+** samples at a time in state-space form (see utk_synth_matrix), in double
+** precision, so it rounds differently. On the sample files its 16-bit output
+** is within 1 LSB of the reference. On near-unstable frames it is not: the
+** float reference drifts from the exact filter, and the block filter does
+** not. Where the filter diverges (e.g. on some frames of re-encoded 48 kbit/s
+** streams with -F), the two differ by up to the full range. utkcheck.c
+** reports every such difference.
+**
+** The conversion kernels are exact. The vectorized dot product sums in a
+** different order. The stereo accumulation kernels are exact.
+*/
+
+#include <stdint.h>
+#include <string.h>
+
+#if !defined(UTK_NO_SIMD) && defined(__AVX__)
+#define UTK_SIMD_AVX 1
+#include <immintrin.h>
+#elif !defined(UTK_NO_SIMD) && (defined(__SSE2__) || defined(_M_X64))
+#define UTK_SIMD_SSE2 1
+#include <emmintrin.h>
+#endif
+
+#define UTK_INTERP_C0 0.01803267933428287506103515625f
+#define UTK_INTERP_C1 0.114591561257839202880859375f
+#define UTK_INTERP_C2 0.597385942935943603515625f
+
+/* With UTK_BLOCK_SYNTH, use the block synthesis filter only when it can
+** amortize its setup. */
+#define UTK_SYNTH_BLOCK_MIN 4
+
+/*
+** Reference kernels.
+*/
+
+/* out[j] = fixed_gain * excitation[j] + pitch_gain * cb[j], j < 108 */
+static void utk_pitch_mix_c(float *out, const float *excitation, const float *cb,
+                            float fixed_gain, float pitch_gain)
+{
+    int j;
+
+    for (j = 0; j < 108; j++)
+        out[j] = fixed_gain * excitation[j] + pitch_gain * cb[j];
+}
+
+/* Fill in the samples of x[0..107] not coded at reduced bandwidth (those with
+** parity 1-align) with a 6-tap half-band interpolation of their neighbours.
+** x[-5..-1] and x[108..112] must be readable. */
+static void utk_interpolate_c(float *x, int align)
+{
+    float *ptr = x + (1-align);
+    int j;
+
+    for (j = 0; j < 108; j += 2)
+        ptr[j] =   ptr[j-5] * UTK_INTERP_C0
+                 - ptr[j-3] * UTK_INTERP_C1
+                 + ptr[j-1] * UTK_INTERP_C2
+                 + ptr[j+1] * UTK_INTERP_C2
+                 - ptr[j+3] * UTK_INTERP_C1
+                 + ptr[j+5] * UTK_INTERP_C0;
+}
+
+/* Run the 12-tap all-pole filter 1/A(z) over num_blocks blocks of 12 samples
+** from in to out, which may be the same. history[k] holds the output k+1
+** samples back. */
+static void utk_synthesize_c(float *out, const float *in, int num_blocks,
+                             const float *lpc, float *history)
+{
+    int i, j, k;
+    float a[12], h[12];
+
+    /* (local copies tell the compiler that the coefficients and the history
+    ** do not alias the samples) */
+    memcpy(a, lpc, sizeof(a));
+    memcpy(h, history, sizeof(h));
+
+    for (i = 0; i < num_blocks; i++) {
+        for (j = 0; j < 12; j++) {
+            float x = *in++;
+
+            for (k = 0; k < j; k++)
+                x += a[k] * h[k-j+12];
+            for (; k < 12; k++)
+                x += a[k] * h[k-j];
+
+            h[11-j] = x;
+            *out++ = x;
+        }
+    }
+
+    memcpy(history, h, sizeof(h));
+}
+
+/* out[i] = in[i] rounded half away from zero and saturated to int16 (the
+** same as CLAMP(ROUND(x), -32768, 32767) in the tools, but also defined for
+** samples beyond the range of int). */
+static void utk_convert_s16_c(int16_t *out, const float *in, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        float x = in[i];
+
+        x = x < -32768.0f ? -32768.0f : x > 32767.0f ? 32767.0f : x;
+        out[i] = (int16_t)(x >= 0.0f ? (x+0.5f) : (x-0.5f));
+    }
+}
+
+/* out[i] = in[i] scaled so that int16 full scale is +-1.0, without clipping */
+static void utk_convert_f32_c(float *out, const float *in, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        out[i] = in[i] * (1.0f/32768.0f);
+}
+
+/* sum of a[i]*b[i], i < n, where n is a multiple of 8 */
+static float utk_dot_c(const float *a, const float *b, int n)
+{
+    float sum = 0.0f;
+    int i;
+
+    for (i = 0; i < n; i++)
+        sum += a[i] * b[i];
+
+    return sum;
+}
+
+/* bus[2*i] += gain_l * in[i] and bus[2*i+1] += gain_r * in[i], i < n (in is
+** mono, bus interleaved stereo) */
+static void utk_mix_stereo_c(float *bus, const float *in, int n, float gain_l, float gain_r)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        bus[2*i] += gain_l * in[i];
+        bus[2*i+1] += gain_r * in[i];
+    }
+}
+
+/* Build the state-space form of the filter for one block of 12 samples:
+** column k (k < 12) of m is the block's response to a unit previous output
+** y[-1-k] (i.e. history[k]), and column 12+c is its response to a unit input
+** x[c]. Each column is stored as 12 consecutive doubles.
+**
+** The input columns are shifted copies of the impulse response h. A unit
+** y[-1-k] acts like the input sequence lpc[k], ..., lpc[11], so the state
+** columns are sums of shifted impulse responses. The matrix and the block
+** products are computed in double precision: near-unstable frames have
+** large matrix entries, and float accumulation would lose far more than the
+** recursive form does. */
+static void utk_synth_matrix(double *m, const float *lpc)
+{
+    double h[12];
+    int k, n, r;
+
+    for (n = 0; n < 12; n++) {
+        double x = (n == 0) ? 1.0 : 0.0;
+
+        for (k = 0; k < n; k++)
+            x += lpc[k] * h[n-1-k];
+
+        h[n] = x;
+    }
+
+    for (k = 0; k < 12; k++) {
+        for (n = 0; n < 12; n++)
+            m[12*(12+k)+n] = (n >= k) ? h[n-k] : 0.0;
+    }
+
+    for (k = 0; k < 12; k++) {
+        double *col = &m[12*k];
+
+        for (n = 0; n < 12; n++)
+            col[n] = 0.0;
+
+        for (r = 0; r + k < 12; r++) {
+            double a = lpc[r+k];
+
+            for (n = r; n < 12; n++)
+                col[n] += a * h[n-r];
+        }
+    }
+}
+
+/*
+** Vectorized kernels.
+*/
+
+#if defined(UTK_SIMD_AVX) || defined(UTK_SIMD_SSE2)
+
+static void utk_pitch_mix_sse2(float *out, const float *excitation, const float *cb,
+                               float fixed_gain, float pitch_gain, int start)
+{
+    __m128 fg = _mm_set1_ps(fixed_gain);
+    __m128 pg = _mm_set1_ps(pitch_gain);
+    int j;
+
+    for (j = start; j < 108; j += 4) {
+        __m128 e = _mm_mul_ps(fg, _mm_loadu_ps(&excitation[j]));
+        __m128 p = _mm_mul_ps(pg, _mm_loadu_ps(&cb[j]));
+        _mm_storeu_ps(&out[j], _mm_add_ps(e, p));
+    }
+}
+
+static void utk_interpolate_sse2(float *x, int align, int start)
+{
+    /* Interpolate every sample and keep the result only at the positions
+    ** being filled in. The taps are all at odd distances, so they only read
+    ** samples that are never overwritten. */
+    const __m128 c0 = _mm_set1_ps(UTK_INTERP_C0);
+    const __m128 c1 = _mm_set1_ps(UTK_INTERP_C1);
+    const __m128 c2 = _mm_set1_ps(UTK_INTERP_C2);
+    const __m128 mask = align ? _mm_castsi128_ps(_mm_set_epi32(0, -1, 0, -1))
+                              : _mm_castsi128_ps(_mm_set_epi32(-1, 0, -1, 0));
+    int j;
+
+    for (j = start; j < 108; j += 4) {
+        __m128 y = _mm_mul_ps(_mm_loadu_ps(&x[j-5]), c0);
+        y = _mm_sub_ps(y, _mm_mul_ps(_mm_loadu_ps(&x[j-3]), c1));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_loadu_ps(&x[j-1]), c2));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_loadu_ps(&x[j+1]), c2));
+        y = _mm_sub_ps(y, _mm_mul_ps(_mm_loadu_ps(&x[j+3]), c1));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_loadu_ps(&x[j+5]), c0));
+        y = _mm_or_ps(_mm_and_ps(mask, y), _mm_andnot_ps(mask, _mm_loadu_ps(&x[j])));
+        _mm_storeu_ps(&x[j], y);
+    }
+}
+
+static void utk_synthesize_sse2(float *out, const float *in, int num_blocks,
+                                const float *lpc, float *history)
+{
+    double m[24*12];
+    __m128d y[6];
+    double prev[12];
+    int i, k;
+
+    utk_synth_matrix(m, lpc);
+
+    for (k = 0; k < 12; k++)
+        prev[k] = history[k];
+
+    for (i = 0; i < num_blocks; i++) {
+        for (k = 0; k < 6; k++)
+            y[k] = _mm_setzero_pd();
+
+        /* the input terms first: they do not depend on the previous block */
+        for (k = 0; k < 12; k++) {
+            __m128d x = _mm_set1_pd(in[k]);
+            const double *col = &m[12*(12+k)];
+            y[0] = _mm_add_pd(y[0], _mm_mul_pd(x, _mm_loadu_pd(&col[0])));
+            y[1] = _mm_add_pd(y[1], _mm_mul_pd(x, _mm_loadu_pd(&col[2])));
+            y[2] = _mm_add_pd(y[2], _mm_mul_pd(x, _mm_loadu_pd(&col[4])));
+            y[3] = _mm_add_pd(y[3], _mm_mul_pd(x, _mm_loadu_pd(&col[6])));
+            y[4] = _mm_add_pd(y[4], _mm_mul_pd(x, _mm_loadu_pd(&col[8])));
+            y[5] = _mm_add_pd(y[5], _mm_mul_pd(x, _mm_loadu_pd(&col[10])));
+        }
+
+        for (k = 0; k < 12; k++) {
+            __m128d s = _mm_set1_pd(prev[k]);
+            const double *col = &m[12*k];
+            y[0] = _mm_add_pd(y[0], _mm_mul_pd(s, _mm_loadu_pd(&col[0])));
+            y[1] = _mm_add_pd(y[1], _mm_mul_pd(s, _mm_loadu_pd(&col[2])));
+            y[2] = _mm_add_pd(y[2], _mm_mul_pd(s, _mm_loadu_pd(&col[4])));
+            y[3] = _mm_add_pd(y[3], _mm_mul_pd(s, _mm_loadu_pd(&col[6])));
+            y[4] = _mm_add_pd(y[4], _mm_mul_pd(s, _mm_loadu_pd(&col[8])));
+            y[5] = _mm_add_pd(y[5], _mm_mul_pd(s, _mm_loadu_pd(&col[10])));
+        }
+
+        /* prev[k] = y[11-k] */
+        for (k = 0; k < 6; k++) {
+            _mm_storeu_pd(&prev[10-2*k], _mm_shuffle_pd(y[k], y[k], 1));
+            _mm_storel_pi((__m64 *)&out[2*k], _mm_cvtpd_ps(y[k]));
+        }
+
+        in += 12;
+        out += 12;
+    }
+
+    for (k = 0; k < 12; k++)
+        history[k] = (float)prev[k];
+}
+
+static void utk_convert_s16_sse2(int16_t *out, const float *in, int n)
+{
+    const __m128 lo = _mm_set1_ps(-32768.0f);
+    const __m128 hi = _mm_set1_ps(32767.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128 sign = _mm_set1_ps(-0.0f);
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m128 a = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&in[i]), lo), hi);
+        __m128 b = _mm_min_ps(_mm_max_ps(_mm_loadu_ps(&in[i+4]), lo), hi);
+
+        /* add copysign(0.5f, x), then truncate */
+        a = _mm_add_ps(a, _mm_or_ps(half, _mm_and_ps(a, sign)));
+        b = _mm_add_ps(b, _mm_or_ps(half, _mm_and_ps(b, sign)));
+
+        _mm_storeu_si128((__m128i *)&out[i],
+                         _mm_packs_epi32(_mm_cvttps_epi32(a), _mm_cvttps_epi32(b)));
+    }
+
+    utk_convert_s16_c(&out[i], &in[i], n - i);
+}
+
+static void utk_convert_f32_sse2(float *out, const float *in, int n)
+{
+    const __m128 scale = _mm_set1_ps(1.0f/32768.0f);
+    int i;
+
+    for (i = 0; i + 4 <= n; i += 4)
+        _mm_storeu_ps(&out[i], _mm_mul_ps(_mm_loadu_ps(&in[i]), scale));
+
+    utk_convert_f32_c(&out[i], &in[i], n - i);
+}
+
+static float utk_dot_sse2(const float *a, const float *b, int n)
+{
+    __m128 x = _mm_mul_ps(_mm_loadu_ps(a), _mm_loadu_ps(b));
+    __m128 y = _mm_mul_ps(_mm_loadu_ps(a+4), _mm_loadu_ps(b+4));
+    int i;
+
+    for (i = 8; i < n; i += 8) {
+        x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(a+i), _mm_loadu_ps(b+i)));
+        y = _mm_add_ps(y, _mm_mul_ps(_mm_loadu_ps(a+i+4), _mm_loadu_ps(b+i+4)));
+    }
+
+    x = _mm_add_ps(x, y);
+    x = _mm_add_ps(x, _mm_movehl_ps(x, x));
+    x = _mm_add_ss(x, _mm_shuffle_ps(x, x, 1));
+
+    return _mm_cvtss_f32(x);
+}
+
+static void utk_mix_stereo_sse2(float *bus, const float *in, int n, float gain_l, float gain_r,
+                                int start)
+{
+    const __m128 gain = _mm_setr_ps(gain_l, gain_r, gain_l, gain_r);
+    int i;
+
+    for (i = start; i + 4 <= n; i += 4) {
+        __m128 x = _mm_loadu_ps(&in[i]);
+        __m128 lo = _mm_mul_ps(_mm_unpacklo_ps(x, x), gain); /* x0 x0 x1 x1 */
+        __m128 hi = _mm_mul_ps(_mm_unpackhi_ps(x, x), gain); /* x2 x2 x3 x3 */
+
+        _mm_storeu_ps(&bus[2*i], _mm_add_ps(_mm_loadu_ps(&bus[2*i]), lo));
+        _mm_storeu_ps(&bus[2*i+4], _mm_add_ps(_mm_loadu_ps(&bus[2*i+4]), hi));
+    }
+
+    utk_mix_stereo_c(&bus[2*i], &in[i], n - i, gain_l, gain_r);
+}
+
+#endif
+
+#ifdef UTK_SIMD_AVX
+
+static void utk_pitch_mix_avx(float *out, const float *excitation, const float *cb,
+                              float fixed_gain, float pitch_gain)
+{
+    __m256 fg = _mm256_set1_ps(fixed_gain);
+    __m256 pg = _mm256_set1_ps(pitch_gain);
+    int j;
+
+    for (j = 0; j + 8 <= 108; j += 8) {
+        __m256 e = _mm256_mul_ps(fg, _mm256_loadu_ps(&excitation[j]));
+        __m256 p = _mm256_mul_ps(pg, _mm256_loadu_ps(&cb[j]));
+        _mm256_storeu_ps(&out[j], _mm256_add_ps(e, p));
+    }
+
+    utk_pitch_mix_sse2(out, excitation, cb, fixed_gain, pitch_gain, j);
+}
+
+static void utk_interpolate_avx(float *x, int align)
+{
+    const __m256 c0 = _mm256_set1_ps(UTK_INTERP_C0);
+    const __m256 c1 = _mm256_set1_ps(UTK_INTERP_C1);
+    const __m256 c2 = _mm256_set1_ps(UTK_INTERP_C2);
+    int j;
+
+    for (j = 0; j + 8 <= 108; j += 8) {
+        __m256 y = _mm256_mul_ps(_mm256_loadu_ps(&x[j-5]), c0);
+        y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_loadu_ps(&x[j-3]), c1));
+        y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_loadu_ps(&x[j-1]), c2));
+        y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_loadu_ps(&x[j+1]), c2));
+        y = _mm256_sub_ps(y, _mm256_mul_ps(_mm256_loadu_ps(&x[j+3]), c1));
+        y = _mm256_add_ps(y, _mm256_mul_ps(_mm256_loadu_ps(&x[j+5]), c0));
+        if (align)
+            y = _mm256_blend_ps(_mm256_loadu_ps(&x[j]), y, 0x55);
+        else
+            y = _mm256_blend_ps(_mm256_loadu_ps(&x[j]), y, 0xaa);
+        _mm256_storeu_ps(&x[j], y);
+    }
+
+    utk_interpolate_sse2(x, align, j);
+}
+
+static void utk_synthesize_avx(float *out, const float *in, int num_blocks,
+                               const float *lpc, float *history)
+{
+    double m[24*12];
+    double prev[12];
+    int i, k;
+
+    utk_synth_matrix(m, lpc);
+
+    for (k = 0; k < 12; k++)
+        prev[k] = history[k];
+
+    for (i = 0; i < num_blocks; i++) {
+        /* The input terms do not depend on the previous block, and the state
+        ** terms are split two ways to shorten the loop-carried chain. */
+        __m256d in0 = _mm256_setzero_pd(), in1 = in0, in2 = in0;
+        __m256d a0 = in0, a1 = in0, a2 = in0;
+        __m256d b0 = in0, b1 = in0, b2 = in0;
+        __m256d y[3];
+
+        for (k = 0; k < 12; k++) {
+            __m256d x = _mm256_set1_pd(in[k]);
+            const double *col = &m[12*(12+k)];
+            in0 = _mm256_add_pd(in0, _mm256_mul_pd(x, _mm256_loadu_pd(&col[0])));
+            in1 = _mm256_add_pd(in1, _mm256_mul_pd(x, _mm256_loadu_pd(&col[4])));
+            in2 = _mm256_add_pd(in2, _mm256_mul_pd(x, _mm256_loadu_pd(&col[8])));
+        }
+
+        for (k = 0; k < 12; k += 2) {
+            __m256d s0 = _mm256_broadcast_sd(&prev[k]);
+            __m256d s1 = _mm256_broadcast_sd(&prev[k+1]);
+            const double *col0 = &m[12*k], *col1 = &m[12*(k+1)];
+            a0 = _mm256_add_pd(a0, _mm256_mul_pd(s0, _mm256_loadu_pd(&col0[0])));
+            a1 = _mm256_add_pd(a1, _mm256_mul_pd(s0, _mm256_loadu_pd(&col0[4])));
+            a2 = _mm256_add_pd(a2, _mm256_mul_pd(s0, _mm256_loadu_pd(&col0[8])));
+            b0 = _mm256_add_pd(b0, _mm256_mul_pd(s1, _mm256_loadu_pd(&col1[0])));
+            b1 = _mm256_add_pd(b1, _mm256_mul_pd(s1, _mm256_loadu_pd(&col1[4])));
+            b2 = _mm256_add_pd(b2, _mm256_mul_pd(s1, _mm256_loadu_pd(&col1[8])));
+        }
+
+        y[0] = _mm256_add_pd(in0, _mm256_add_pd(a0, b0));
+        y[1] = _mm256_add_pd(in1, _mm256_add_pd(a1, b1));
+        y[2] = _mm256_add_pd(in2, _mm256_add_pd(a2, b2));
+
+        /* prev[k] = y[11-k] */
+        for (k = 0; k < 3; k++) {
+            __m256d r = _mm256_permute_pd(_mm256_permute2f128_pd(y[k], y[k], 1), 5);
+            _mm256_storeu_pd(&prev[8-4*k], r);
+            _mm_storeu_ps(&out[4*k], _mm256_cvtpd_ps(y[k]));
+        }
+
+        in += 12;
+        out += 12;
+    }
+
+    for (k = 0; k < 12; k++)
+        history[k] = (float)prev[k];
+}
+
+static float utk_dot_avx(const float *a, const float *b, int n)
+{
+    __m256 x = _mm256_mul_ps(_mm256_loadu_ps(a), _mm256_loadu_ps(b));
+    __m128 y;
+    int i;
+
+    for (i = 8; i < n; i += 8)
+        x = _mm256_add_ps(x, _mm256_mul_ps(_mm256_loadu_ps(a+i), _mm256_loadu_ps(b+i)));
+
+    y = _mm_add_ps(_mm256_castps256_ps128(x), _mm256_extractf128_ps(x, 1));
+    y = _mm_add_ps(y, _mm_movehl_ps(y, y));
+    y = _mm_add_ss(y, _mm_shuffle_ps(y, y, 1));
+
+    return _mm_cvtss_f32(y);
+}
+
+static void utk_mix_stereo_avx(float *bus, const float *in, int n, float gain_l, float gain_r)
+{
+    const __m256 gain = _mm256_setr_ps(gain_l, gain_r, gain_l, gain_r,
+                                       gain_l, gain_r, gain_l, gain_r);
+    int i;
+
+    for (i = 0; i + 8 <= n; i += 8) {
+        __m256 x = _mm256_loadu_ps(&in[i]);
+        /* unpack works within each 128-bit half: x0 x0 x1 x1 x4 x4 x5 x5 and
+        ** x2 x2 x3 x3 x6 x6 x7 x7 */
+        __m256 a = _mm256_unpacklo_ps(x, x);
+        __m256 b = _mm256_unpackhi_ps(x, x);
+        __m256 lo = _mm256_mul_ps(_mm256_permute2f128_ps(a, b, 0x20), gain);
+        __m256 hi = _mm256_mul_ps(_mm256_permute2f128_ps(a, b, 0x31), gain);
+
+        _mm256_storeu_ps(&bus[2*i], _mm256_add_ps(_mm256_loadu_ps(&bus[2*i]), lo));
+        _mm256_storeu_ps(&bus[2*i+8], _mm256_add_ps(_mm256_loadu_ps(&bus[2*i+8]), hi));
+    }
+
+    utk_mix_stereo_sse2(bus, in, n, gain_l, gain_r, i);
+}
+
+#endif
+
+/*
+** Dispatch.
+*/
+
+static void utk_pitch_mix(float *out, const float *excitation, const float *cb,
+                          float fixed_gain, float pitch_gain)
+{
+#if defined(UTK_SIMD_AVX)
+    utk_pitch_mix_avx(out, excitation, cb, fixed_gain, pitch_gain);
+#elif defined(UTK_SIMD_SSE2)
+    utk_pitch_mix_sse2(out, excitation, cb, fixed_gain, pitch_gain, 0);
+#else
+    utk_pitch_mix_c(out, excitation, cb, fixed_gain, pitch_gain);
+#endif
+}
+
+static void utk_interpolate(float *x, int align)
+{
+#if defined(__FAST_MATH__)
+    utk_interpolate_c(x, align);
+#elif defined(UTK_SIMD_AVX)
+    utk_interpolate_avx(x, align);
+#elif defined(UTK_SIMD_SSE2)
+    utk_interpolate_sse2(x, align, 0);
+#else
+    utk_interpolate_c(x, align);
+#endif
+}
+
+static void utk_synthesize(float *out, const float *in, int num_blocks,
+                           const float *lpc, float *history)
+{
+#if defined(UTK_BLOCK_SYNTH) && defined(UTK_SIMD_AVX)
+    if (num_blocks >= UTK_SYNTH_BLOCK_MIN) {
+        utk_synthesize_avx(out, in, num_blocks, lpc, history);
+        return;
+    }
+#elif defined(UTK_BLOCK_SYNTH) && defined(UTK_SIMD_SSE2)
+    if (num_blocks >= UTK_SYNTH_BLOCK_MIN) {
+        utk_synthesize_sse2(out, in, num_blocks, lpc, history);
+        return;
+    }
+#endif
+    utk_synthesize_c(out, in, num_blocks, lpc, history);
+}
+
+static void utk_convert_s16(int16_t *out, const float *in, int n)
+{
+#if defined(UTK_SIMD_AVX) || defined(UTK_SIMD_SSE2)
+    utk_convert_s16_sse2(out, in, n);
+#else
+    utk_convert_s16_c(out, in, n);
+#endif
+}
+
+static void utk_convert_f32(float *out, const float *in, int n)
+{
+#if defined(UTK_SIMD_AVX) || defined(UTK_SIMD_SSE2)
+    utk_convert_f32_sse2(out, in, n);
+#else
+    utk_convert_f32_c(out, in, n);
+#endif
+}
+
+static float utk_dot(const float *a, const float *b, int n)
+{
+#if defined(UTK_SIMD_AVX)
+    return utk_dot_avx(a, b, n);
+#elif defined(UTK_SIMD_SSE2)
+    return utk_dot_sse2(a, b, n);
+#else
+    return utk_dot_c(a, b, n);
+#endif
+}
+
+static void utk_mix_stereo(float *bus, const float *in, int n, float gain_l, float gain_r)
+{
+#if defined(UTK_SIMD_AVX)
+    utk_mix_stereo_avx(bus, in, n, gain_l, gain_r);
+#elif defined(UTK_SIMD_SSE2)
+    utk_mix_stereo_sse2(bus, in, n, gain_l, gain_r, 0);
+#else
+    utk_mix_stereo_c(bus, in, n, gain_l, gain_r);
+#endif
+}
+
+#endif
@@ -121,7 +121,14 @@ static FILE *outfp = NULL;
 
 static uint8_t wav_buffer[432*2];
 static float input_samples[12+432];
-static float adaptive_codebook[324+432];
+/* The excitation is kept in a ring of 8 subframes (the current frame and the
+** previous one), so the adaptive codebook never has to be moved. The current
+** frame goes at cb_pos, which alternates between 0 and 432. The first
+** subframe is mirrored after the end of the ring, so that the 108 samples
+** at any pitch lag are contiguous (see past_excitation). */
+#define RING_SIZE 864
+static float adaptive_codebook[RING_SIZE+108];
+static int cb_pos;
 static uint8_t compressed_buffer[1024];
 static uint8_t inn_buffers[2][256];
 static float prev_rc[12];
@@ -354,9 +361,19 @@ static void find_excitation(float *excitation, const float *source,
 	}
 }
 
-static void find_pitch(int *pitch_lag, float *pitch_gain,
-	const float *excitation)
+/* The 108 samples of excitation lag samples before the subframe at pos in
+** the ring, where 108 <= lag < 324. */
+static const float *past_excitation(int pos, int lag)
 {
+	pos -= lag;
+	if (pos < 0)
+		pos += RING_SIZE;
+	return &adaptive_codebook[pos];
+}
+
+static void find_pitch(int *pitch_lag, float *pitch_gain, int pos)
+{
+	const float *excitation = &adaptive_codebook[pos];
 	int max_corr_offset = 108;
 	float max_corr_value = 0.0f;
 	float history_energy;
@@ -365,9 +382,10 @@ static void find_pitch(int *pitch_lag, float *pitch_gain,
 
 	/* Find the optimal pitch lag. */
 	for (i = 108; i < 324; i++) {
+		const float *past = past_excitation(pos, i);
 		float corr = 0.0f;
 		for (j = 0; j < 108; j++)
-			corr += excitation[j]*excitation[j-i];
+			corr += excitation[j]*past[j];
 		if (corr > max_corr_value) {
 			max_corr_offset = i;
 			max_corr_value = corr;
@@ -377,7 +395,7 @@ static void find_pitch(int *pitch_lag, float *pitch_gain,
 	/* Find the optimal pitch gain. */
 	history_energy = 0.0f;
 	for (i = 0; i < 108; i++) {
-		float value = excitation[i-max_corr_offset];
+		float value = past_excitation(pos, max_corr_offset)[i];
 		history_energy += value*value;
 	}
 
@@ -1005,7 +1023,8 @@ int main(int argc, char *argv[])
 
 	for (i = 0; i < 12; i++)
 		input_samples[i] = 0.0f;
-	for (i = 0; i < 324; i++)
+	cb_pos = 0;
+	for (i = RING_SIZE-324; i < RING_SIZE; i++)
 		adaptive_codebook[i] = 0.0f;
 	for (i = 0; i < 12; i++)
 		prev_rc[i] = 0.0f;
@@ -1071,7 +1090,7 @@ int main(int argc, char *argv[])
 
 			rc_to_lpc(lpc, rc);
 
-			find_excitation(adaptive_codebook+324+12*i,
+			find_excitation(adaptive_codebook+cb_pos+12*i,
 				input_samples+12+12*i,
 				i < 3 ? 12 : 396, lpc);
 		}
@@ -1081,13 +1100,15 @@ int main(int argc, char *argv[])
 
 		for (i = 0; i < 4; i++) {
 			/* Encode the i'th subframe. */
-			float *excitation = adaptive_codebook+324+108*i;
+			float *excitation = adaptive_codebook+cb_pos+108*i;
+			const float *past;
 			int pitch_lag;
 			float pitch_gain;
 			int idx;
 			int bits_used;
 
-			find_pitch(&pitch_lag, &pitch_gain, excitation);
+			find_pitch(&pitch_lag, &pitch_gain, cb_pos+108*i);
+			past = past_excitation(cb_pos+108*i, pitch_lag);
 
 			bwc_write_bits(&bwc, pitch_lag - 108, 8);
 
@@ -1097,7 +1118,7 @@ int main(int argc, char *argv[])
 
 			for (j = 0; j < 108; j++)
 				innovation[5+j] = excitation[j]
-					- pitch_gain*excitation[j-pitch_lag];
+					- pitch_gain*past[j];
 
 			encode_innovation(&bwc, &innovation[5],
 				halved_innovation, use_huffman, &bits_used,
@@ -1107,13 +1128,16 @@ int main(int argc, char *argv[])
 			** innovation signal. */
 			for (j = 0; j < 108; j++)
 				excitation[j] = innovation[5+j]
-					+ pitch_gain*excitation[j-pitch_lag];
+					+ pitch_gain*past[j];
+
+			if (cb_pos == 0 && i == 0)
+				memcpy(&adaptive_codebook[RING_SIZE], excitation,
+					108*sizeof(float));
 		}
 
-		/* Copy the last 3 subframes to the beginning of the
-		** adaptive codebook. */
-		memcpy(adaptive_codebook, &adaptive_codebook[432],
-			324*sizeof(float));
+		/* The last 3 subframes are the next frame's adaptive
+		** codebook. */
+		cb_pos = 432 - cb_pos;
 
 		bwc_flush(&bwc, outfp);
 	}
@@ -0,0 +1,19 @@
+#ifndef UTKERROR_H
+#define UTKERROR_H
+
+/* Error codes shared by the decoder, the container parsers and libutk.
+** Nothing in the decoding path calls exit(); errors are returned to the
+** caller, which decides whether to report them and give up. */
+enum {
+    UTK_OK = 0,
+    UTK_ERR_NOMEM = -1,
+    UTK_ERR_INVALID_ARG = -2,
+    UTK_ERR_EOF = -3,
+    UTK_ERR_BAD_SIGNATURE = -4,
+    UTK_ERR_BAD_HEADER = -5,
+    UTK_ERR_BAD_CHUNK = -6,
+    UTK_ERR_UNSUPPORTED = -7,
+    UTK_ERR_BAD_PCM = -8
+};
+
+#endif
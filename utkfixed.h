@@ -0,0 +1,378 @@
+#ifndef UTKFIXED_H
+#define UTKFIXED_H
+
+#include "utk.h"
+
+/* Fixed-point MicroTalk decoder with int16 output.
+**
+** This decodes the same bitstreams as utk_decode_frame (Maxis UTK, PT/M10
+** and SCxl revision 2 frames) using only integer arithmetic, so its output
+** is the same on every compiler and CPU, and does not depend on -ffast-math
+** or on an FPU. Formats:
+**   reflection and LPC coefficients  Q24 (UTK_RC_FRAC_BITS)
+**   excitation                       Q12
+**   fixed gains, residual and output Q8
+**   pitch gain                       Q16
+**
+** Error bound: against the float decoder (ROUND and CLAMP of
+** utk_decode_frame's output), 95% of the int16 samples are identical and
+** 99.98% are within 1 LSB on the sample files and on re-encoded 32-64 kbit/s
+** streams. The largest differences (up to 5 LSB) are on frames with
+** near-unstable synthesis filters, where the float decoder's own rounding
+** errors are amplified just as much. On streams that drive the filter far
+** past full scale (and so clip anyway), the two decoders may diverge. */
+
+#define UTK_FIX_LPC_BITS 24
+#define UTK_FIX_EXC_BITS 12
+#define UTK_FIX_OUT_BITS 8
+#define UTK_FIX_PG_BITS 16
+#define UTK_FIX_INTERP_BITS 15
+
+#define UTK_FIX_SYNTH_MAX (((int32_t)1 << 27) - 1)
+
+/* UTK_INTERP_C0..C2 in Q15 */
+#define UTK_FIX_INTERP_C0 591
+#define UTK_FIX_INTERP_C1 3755
+#define UTK_FIX_INTERP_C2 19575
+
+/* Number of samples that a subframe-0 pitch lag > 216 reads from in front
+** of the adaptive codebook (see utk_fixed_decode_frame). */
+#define UTK_FIX_CB_PAD 39
+
+typedef struct UTKFixedContext {
+    UTKContext utk; /* bit reader and header flags only */
+    int32_t fixed_gains[64];
+    int32_t rc[12];
+    /* the padding, adapt_cb[324], then the current frame's 432 samples */
+    int32_t residual[UTK_FIX_CB_PAD+324+432];
+    /* the previous frame's last 12 samples, then the current frame */
+    int32_t synth[12+432];
+    int16_t decompressed_frame[432];
+} UTKFixedContext;
+
+#define UTK_FIX_SHR(x, n) (((x) + ((int64_t)1 << ((n)-1))) >> (n))
+
+static void utk_fixed_parse_header(UTKFixedContext *ctx)
+{
+    int i;
+    uint64_t gain, multiplier;
+
+    ctx->utk.reduced_bw = utk_read_bits(&ctx->utk, 1);
+    ctx->utk.multipulse_thresh = 32 - utk_read_bits(&ctx->utk, 4);
+
+    /* gain[0] = 8*(1+n), gain[i] = gain[i-1] * (1.04 + m*0.001), in Q16 */
+    gain = (uint64_t)(8 * (1 + utk_read_bits(&ctx->utk, 4))) << 16;
+    multiplier = 1040 + utk_read_bits(&ctx->utk, 6);
+
+    for (i = 0; i < 64; i++) {
+        ctx->fixed_gains[i] = (int32_t)((gain + 128) >> 8);
+        gain = (gain * multiplier + 500) / 1000;
+    }
+}
+
+/* utk_decode_excitation with Q12 integer output. */
+static void utk_fixed_decode_excitation(UTKContext *ctx, int use_multipulse,
+                                        int32_t *out, int stride)
+{
+    static const int32_t relp_values[4] = {0, -(2 << UTK_FIX_EXC_BITS), 2 << UTK_FIX_EXC_BITS, 0};
+    int i;
+
+    if (use_multipulse) {
+        int model, cmd;
+        model = 0;
+        i = 0;
+        while (i < 108) {
+            uint32_t entry;
+            int n;
+
+            if (ctx->bits_count < UTK_PULSE_BITS)
+                utk_refill_bits(ctx);
+
+            entry = utk_pulse_table[model][ctx->bits_value & ((1 << UTK_PULSE_BITS) - 1)];
+            n = (entry >> 20) & 7;
+
+            if (n > 0 && i + (n-1)*stride < 108) {
+                int k;
+
+                utk_read_bits(ctx, (entry >> 23) & 15);
+                model = entry >> 27;
+
+                for (k = 0; k < n; k++) {
+                    out[i] = ((int32_t)((entry >> 4*k) & 15) - 8) * (1 << UTK_FIX_EXC_BITS);
+                    i += stride;
+                }
+                continue;
+            }
+
+            cmd = utk_codebooks[model][ctx->bits_value & 0xff];
+            model = utk_commands[cmd].next_model;
+            utk_read_bits(ctx, utk_commands[cmd].code_size);
+
+            if (cmd > 3) {
+                out[i] = (int32_t)utk_commands[cmd].pulse_value * (1 << UTK_FIX_EXC_BITS);
+                i += stride;
+            } else if (cmd > 1) {
+                int count = 7 + utk_read_bits(ctx, 6);
+                if (i + count * stride > 108)
+                    count = (108 - i)/stride;
+
+                while (count > 0) {
+                    out[i] = 0;
+                    i += stride;
+                    count--;
+                }
+            } else {
+                int32_t x = 7;
+
+                while (utk_read_bits(ctx, 1))
+                    x++;
+
+                if (!utk_read_bits(ctx, 1))
+                    x *= -1;
+
+                out[i] = x * (1 << UTK_FIX_EXC_BITS);
+                i += stride;
+            }
+        }
+    } else {
+        i = 0;
+        while (i < 108) {
+            uint32_t entry = utk_relp_table[ctx->bits_value & 0xff];
+            int n = (entry >> 16) & 15;
+
+            if (i + (n-1)*stride < 108) {
+                int k;
+
+                utk_read_bits(ctx, (entry >> 20) & 15);
+
+                for (k = 0; k < n; k++) {
+                    out[i] = relp_values[(entry >> 2*k) & 3];
+                    i += stride;
+                }
+                continue;
+            }
+
+            if (!utk_read_bits(ctx, 1))
+                out[i] = relp_values[0];
+            else if (!utk_read_bits(ctx, 1))
+                out[i] = relp_values[1];
+            else
+                out[i] = relp_values[2];
+
+            i += stride;
+        }
+    }
+}
+
+static void utk_fixed_interpolate(int32_t *x, int align)
+{
+    int32_t *ptr = x + (1-align);
+    int j;
+
+    for (j = 0; j < 108; j += 2) {
+        int64_t sum = (int64_t)(ptr[j-5] + ptr[j+5]) * UTK_FIX_INTERP_C0
+                    - (int64_t)(ptr[j-3] + ptr[j+3]) * UTK_FIX_INTERP_C1
+                    + (int64_t)(ptr[j-1] + ptr[j+1]) * UTK_FIX_INTERP_C2;
+        ptr[j] = (int32_t)UTK_FIX_SHR(sum, UTK_FIX_INTERP_BITS);
+    }
+}
+
+/* Convert reflection coefficients to LPC coefficients with the step-up
+** recursion, which gives the same result as rc_to_lpc with far fewer
+** roundings. The intermediate coefficients are kept in Q30. */
+static void utk_fixed_rc_to_lpc(const int32_t *rc, int32_t *lpc)
+{
+    int i, j;
+    int64_t a[12], tmp[12];
+
+    for (i = 0; i < 12; i++) {
+        for (j = 0; j < i; j++)
+            tmp[j] = a[j] + UTK_FIX_SHR(rc[i] * a[i-1-j], UTK_RC_FRAC_BITS);
+        for (j = 0; j < i; j++)
+            a[j] = tmp[j];
+        a[i] = (int64_t)rc[i] * (1 << (30 - UTK_RC_FRAC_BITS));
+    }
+
+    for (i = 0; i < 12; i++) {
+        int64_t x = -UTK_FIX_SHR(a[i], 30 - UTK_FIX_LPC_BITS);
+        lpc[i] = (int32_t)(x < -0x7fffffff ? -0x7fffffff : x > 0x7fffffff ? 0x7fffffff : x);
+    }
+}
+
+/* y[n] = x[n] + sum(lpc[k] * y[n-1-k]), in place on y[0..num_samples-1].
+** The 12 previous outputs are read from y[-12..-1]. The output saturates at
+** 16x full scale, which keeps the sum within 64 bits. */
+static void utk_fixed_synthesize(int32_t *y, int num_samples, const int32_t *lpc)
+{
+    int i;
+    int32_t a[12];
+
+    memcpy(a, lpc, sizeof(a));
+
+    for (i = 0; i < num_samples; i++) {
+        const int32_t *h = &y[i-12];
+        int64_t acc = (int64_t)y[i] * ((int64_t)1 << UTK_FIX_LPC_BITS)
+            + (int64_t)a[11] * h[0] + (int64_t)a[10] * h[1]
+            + (int64_t)a[9] * h[2] + (int64_t)a[8] * h[3]
+            + (int64_t)a[7] * h[4] + (int64_t)a[6] * h[5]
+            + (int64_t)a[5] * h[6] + (int64_t)a[4] * h[7]
+            + (int64_t)a[3] * h[8] + (int64_t)a[2] * h[9]
+            + (int64_t)a[1] * h[10] + (int64_t)a[0] * h[11];
+
+        acc = UTK_FIX_SHR(acc, UTK_FIX_LPC_BITS);
+        y[i] = (int32_t)(acc < -UTK_FIX_SYNTH_MAX ? -UTK_FIX_SYNTH_MAX
+                         : acc > UTK_FIX_SYNTH_MAX ? UTK_FIX_SYNTH_MAX : acc);
+    }
+}
+
+/*
+** Public functions.
+*/
+
+static void utk_fixed_init(UTKFixedContext *ctx)
+{
+    memset(ctx, 0, sizeof(*ctx));
+}
+
+static void utk_fixed_set_fp(UTKFixedContext *ctx, FILE *fp, UTKFileBuffer *file)
+{
+    utk_set_fp(&ctx->utk, fp, file);
+}
+
+static void utk_fixed_set_ptr(UTKFixedContext *ctx, const uint8_t *ptr, const uint8_t *end)
+{
+    utk_set_ptr(&ctx->utk, ptr, end);
+}
+
+static void utk_fixed_decode_frame(UTKFixedContext *ctx)
+{
+    int32_t *adapt_cb = &ctx->residual[UTK_FIX_CB_PAD];
+    int32_t *frame = &ctx->residual[UTK_FIX_CB_PAD+324];
+    int32_t excitation[5+108+5];
+    int32_t rc[12];
+    int32_t rc_delta[12];
+    int32_t lpc[12];
+    int use_multipulse = 0;
+    int i, j;
+
+    if (!ctx->utk.bits_count)
+        utk_refill_bits(&ctx->utk);
+
+    if (!ctx->utk.parsed_header) {
+        utk_fixed_parse_header(ctx);
+        ctx->utk.parsed_header = 1;
+    }
+
+    /* A pitch lag above 216 on the first subframe reads in front of
+    ** adapt_cb. In the float decoder, that is the tail of fixed_gains, then
+    ** rc, then synth_history (see utk_fill_cb_prefix); mirror it. */
+    for (i = 0; i < 15; i++)
+        ctx->residual[i] = ctx->fixed_gains[49+i];
+    for (i = 0; i < 12; i++) {
+        ctx->residual[15+i] = (int32_t)UTK_FIX_SHR(ctx->rc[i], UTK_RC_FRAC_BITS - UTK_FIX_OUT_BITS);
+        ctx->residual[27+i] = ctx->synth[11-i];
+    }
+
+    memset(excitation, 0, sizeof(excitation));
+
+    for (i = 0; i < 12; i++) {
+        int idx;
+        if (i == 0) {
+            idx = utk_read_bits(&ctx->utk, 6);
+            if (idx < ctx->utk.multipulse_thresh)
+                use_multipulse = 1;
+        } else if (i < 4) {
+            idx = utk_read_bits(&ctx->utk, 6);
+        } else {
+            idx = 16 + utk_read_bits(&ctx->utk, 5);
+        }
+
+        rc[i] = utk_rc_table_fixed[idx];
+    }
+
+    for (i = 0; i < 4; i++) {
+        int pitch_lag = utk_read_bits(&ctx->utk, 8);
+        int32_t pitch_gain = (int32_t)(((uint32_t)utk_read_bits(&ctx->utk, 4) << UTK_FIX_PG_BITS) + 7) / 15;
+        int32_t fixed_gain = ctx->fixed_gains[utk_read_bits(&ctx->utk, 6)];
+        const int32_t *cb = &adapt_cb[108*i+216-pitch_lag];
+        int32_t *out = &frame[108*i];
+
+        if (!ctx->utk.reduced_bw) {
+            utk_fixed_decode_excitation(&ctx->utk, use_multipulse, &excitation[5], 1);
+        } else {
+            int align = utk_read_bits(&ctx->utk, 1);
+            int zero = utk_read_bits(&ctx->utk, 1);
+
+            utk_fixed_decode_excitation(&ctx->utk, use_multipulse, &excitation[5+align], 2);
+
+            if (zero) {
+                for (j = 0; j < 54; j++)
+                    excitation[5+(1-align)+2*j] = 0;
+            } else {
+                utk_fixed_interpolate(&excitation[5], align);
+                fixed_gain >>= 1;
+            }
+        }
+
+        /* out = fixed_gain*excitation + pitch_gain*cb, rounded to Q8 */
+        for (j = 0; j < 108; j++) {
+            int64_t acc = (int64_t)fixed_gain * excitation[5+j]
+                            * (1 << (UTK_FIX_PG_BITS - UTK_FIX_EXC_BITS))
+                        + (int64_t)pitch_gain * cb[j];
+            out[j] = (int32_t)UTK_FIX_SHR(acc, UTK_FIX_PG_BITS);
+        }
+    }
+
+    memmove(adapt_cb, &frame[108], 324*sizeof(int32_t));
+    memcpy(&ctx->synth[12], frame, 432*sizeof(int32_t));
+
+    for (i = 0; i < 12; i++)
+        rc_delta[i] = (rc[i] - ctx->rc[i]) / 4;
+
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 12; j++)
+            ctx->rc[j] += rc_delta[j];
+
+        utk_fixed_rc_to_lpc(ctx->rc, lpc);
+        utk_fixed_synthesize(&ctx->synth[12+12*i], i < 3 ? 12 : 396, lpc);
+    }
+
+    for (i = 0; i < 432; i++) {
+        int32_t x = (int32_t)UTK_FIX_SHR(ctx->synth[12+i], UTK_FIX_OUT_BITS);
+        ctx->decompressed_frame[i] = (int16_t)(x < -32768 ? -32768 : x > 32767 ? 32767 : x);
+    }
+
+    memcpy(ctx->synth, &ctx->synth[432], 12*sizeof(int32_t));
+}
+
+/* Decode frames until count samples have been written to out. As with
+** utk_decode_s16, the samples of the last frame beyond count are discarded. */
+static void utk_fixed_decode_s16(UTKFixedContext *ctx, int16_t *out, size_t count)
+{
+    while (count > 0) {
+        int n = count < 432 ? (int)count : 432;
+
+        utk_fixed_decode_frame(ctx);
+        memcpy(out, ctx->decompressed_frame, n*sizeof(int16_t));
+        out += n;
+        count -= n;
+    }
+}
+
+/* Same as utk_fixed_decode_s16, but output float samples with full scale at
+** +-1.0. */
+static void utk_fixed_decode_f32(UTKFixedContext *ctx, float *out, size_t count)
+{
+    while (count > 0) {
+        int n = count < 432 ? (int)count : 432;
+        int i;
+
+        utk_fixed_decode_frame(ctx);
+        for (i = 0; i < n; i++)
+            out[i] = ctx->decompressed_frame[i] * (1.0f/32768.0f);
+        out += n;
+        count -= n;
+    }
+}
+
+#endif
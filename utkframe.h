@@ -0,0 +1,175 @@
+/* Frame parsing specialized for one stream configuration. This file has no
+** include guard: utk.h includes it once per variant, with
+**
+**     UTK_STRIDE       1, or 2 for a reduced bandwidth stream
+**     UTK_MULTIPULSE   1 for the multi-pulse model, 0 for RELP
+**     UTK_VARIANT(x)   x with the variant's suffix appended
+**
+** defined, so that the excitation decoder and the subframe loop have no
+** branches on the configuration left in them. utk_parse_header picks the
+** variants for the stream, and utk_parse_frame the one for each frame's
+** model. The parameters are undefined again at the end. */
+
+static void UTK_VARIANT(utk_decode_excitation)(UTKContext *ctx, float *out)
+{
+    int i = 0;
+
+#if UTK_MULTIPULSE
+    /* multi-pulse model: n pulses are coded explicitly; the rest are zero */
+    int model = 0, cmd;
+
+    while (i < 108) {
+        uint32_t entry;
+        int n;
+
+        /* decode up to 5 pulses with one lookup (see utkgentables.c) */
+        if (ctx->bits_count < UTK_PULSE_BITS)
+            utk_refill_bits(ctx);
+
+        entry = utk_pulse_table[model][ctx->bits_value & ((1 << UTK_PULSE_BITS) - 1)];
+        n = (entry >> 20) & 7;
+
+        if (n > 0 && i + (n-1)*UTK_STRIDE < 108) {
+            int k;
+
+            utk_read_bits(ctx, (entry >> 23) & 15);
+            model = entry >> 27;
+
+            for (k = 0; k < n; k++) {
+                out[i] = (float)(int)((entry >> 4*k) & 15) - 8.0f;
+                i += UTK_STRIDE;
+            }
+            continue;
+        }
+
+        /* otherwise decode a single command */
+        cmd = utk_codebooks[model][ctx->bits_value & 0xff];
+        model = utk_commands[cmd].next_model;
+        utk_read_bits(ctx, utk_commands[cmd].code_size);
+
+        if (cmd > 3) {
+            /* insert a pulse with magnitude <= 6.0f */
+            out[i] = utk_commands[cmd].pulse_value;
+            i += UTK_STRIDE;
+        } else if (cmd > 1) {
+            /* insert between 7 and 70 zeros */
+            int count = 7 + utk_read_bits(ctx, 6);
+            UTK_STAT(ctx->stats.zero_runs++);
+            if (i + count * UTK_STRIDE > 108)
+                count = (108 - i)/UTK_STRIDE;
+
+#if UTK_STRIDE == 1
+            memset(&out[i], 0, count*sizeof(float));
+            i += count;
+#else
+            while (count > 0) {
+                out[i] = 0.0f;
+                i += UTK_STRIDE;
+                count--;
+            }
+#endif
+        } else {
+            /* insert a pulse with magnitude >= 7.0f */
+            int x = 7;
+            UTK_STAT(ctx->stats.large_pulses++);
+
+            while (utk_read_bits(ctx, 1))
+                x++;
+
+            if (!utk_read_bits(ctx, 1))
+                x *= -1;
+
+            out[i] = (float)x;
+            i += UTK_STRIDE;
+        }
+    }
+#else
+    /* RELP model: entire residual (excitation) signal is coded explicitly */
+    static const float relp_values[4] = {0.0f, -2.0f, 2.0f, 0.0f};
+
+    while (i < 108) {
+        /* decode up to 8 samples with one lookup (see utkgentables.c) */
+        uint32_t entry = utk_relp_table[ctx->bits_value & 0xff];
+        int n = (entry >> 16) & 15;
+
+        if (i + (n-1)*UTK_STRIDE < 108) {
+            int k;
+
+            utk_read_bits(ctx, (entry >> 20) & 15);
+
+            for (k = 0; k < n; k++) {
+                out[i] = relp_values[(entry >> 2*k) & 3];
+                i += UTK_STRIDE;
+            }
+            continue;
+        }
+
+        if (!utk_read_bits(ctx, 1))
+            out[i] = 0.0f;
+        else if (!utk_read_bits(ctx, 1))
+            out[i] = -2.0f;
+        else
+            out[i] = 2.0f;
+
+        i += UTK_STRIDE;
+    }
+#endif
+}
+
+/* Read the four subframes of a frame, after its reflection coefficients. */
+static void UTK_VARIANT(utk_parse_subframes)(UTKContext *ctx, UTKFrame *frame)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        float *excitation = frame->excitation[i];
+#if UTK_STRIDE == 2
+        int align, zero;
+#endif
+        UTK_STAT(uint32_t start = ctx->bits_read;)
+
+        frame->pitch_lag[i] = utk_read_bits(ctx, 8);
+#ifdef UTK_STATS
+        ctx->stats.pitch_lag[i] = frame->pitch_lag[i];
+        ctx->stats.pitch_gain[i] = utk_read_bits(ctx, 4);
+        ctx->stats.fixed_gain[i] = utk_read_bits(ctx, 6);
+        frame->pitch_gain[i] = (float)ctx->stats.pitch_gain[i]/15.0f;
+        frame->fixed_gain[i] = ctx->fixed_gains[ctx->stats.fixed_gain[i]];
+#else
+        frame->pitch_gain[i] = (float)utk_read_bits(ctx, 4)/15.0f;
+        frame->fixed_gain[i] = ctx->fixed_gains[utk_read_bits(ctx, 6)];
+#endif
+
+#if UTK_STRIDE == 1
+        UTK_VARIANT(utk_decode_excitation)(ctx, &excitation[5]);
+#else
+        /* residual (excitation) signal is encoded at reduced bandwidth */
+        align = utk_read_bits(ctx, 1);
+        zero = utk_read_bits(ctx, 1);
+
+        UTK_VARIANT(utk_decode_excitation)(ctx, &excitation[5+align]);
+
+        if (zero) {
+            /* fill the remaining samples with zero
+            ** (spectrum is duplicated into high frequencies) */
+            int j;
+
+            for (j = 0; j < 54; j++)
+                excitation[5+(1-align)+2*j] = 0.0f;
+        } else {
+            /* interpolate the remaining samples
+            ** (spectrum is low-pass filtered) */
+            utk_interpolate(&excitation[5], align);
+
+            /* scale by 0.5f to give the sinc impulse response unit energy */
+            frame->fixed_gain[i] *= 0.5f;
+        }
+#endif
+
+        UTK_STAT(ctx->stats.subframe_bits[i] = (int)(ctx->bits_read - start));
+    }
+}
+
+#undef UTK_STRIDE
+#undef UTK_MULTIPULSE
+#undef UTK_VARIANT
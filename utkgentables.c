@@ -0,0 +1,157 @@
+/*
+** utkgentables
+** Generate utktables.h, the multi-symbol excitation decoding tables and the
+** fixed-point reflection coefficient table.
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2
+**          -o utkgentables utkgentables.c -lm
+** Usage: ./utkgentables > utktables.h
+*/
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <math.h>
+#include "utkcodebook.h"
+
+#define PULSE_BITS 10
+#define PULSE_MAX 5
+#define RELP_BITS 8
+#define RC_FRAC_BITS 24
+
+/* Decode as many whole pulse commands as fit in a PULSE_BITS-bit window,
+** stopping before the first escape command (cmd <= 3), which needs bits
+** beyond its code. The codes are prefix-free, so looking up a window whose
+** unknown high bits are zero either yields the real command or one that is
+** too long to fit. */
+static uint32_t make_pulse_entry(int model, unsigned window)
+{
+    uint32_t values = 0;
+    int used = 0;
+    int count = 0;
+
+    while (count < PULSE_MAX) {
+        int cmd = utk_codebooks[model][(window >> used) & 0xff];
+        int size = utk_commands[cmd].code_size;
+        int value;
+
+        if (cmd <= 3 || used + size > PULSE_BITS)
+            break;
+
+        value = (int)utk_commands[cmd].pulse_value;
+        values |= (uint32_t)(value + 8) << (4*count);
+        model = utk_commands[cmd].next_model;
+        used += size;
+        count++;
+    }
+
+    return values | ((uint32_t)count << 20) | ((uint32_t)used << 23)
+        | ((uint32_t)model << 27);
+}
+
+/* Decode as many whole RELP samples ('0' = 0, '10' = -2, '11' = +2) as fit
+** in a RELP_BITS-bit window. */
+static uint32_t make_relp_entry(unsigned window)
+{
+    uint32_t values = 0;
+    int used = 0;
+    int count = 0;
+
+    while (used < RELP_BITS) {
+        int code;
+
+        if (!((window >> used) & 1)) {
+            code = 0;
+            used += 1;
+        } else if (used + 2 <= RELP_BITS) {
+            code = ((window >> (used+1)) & 1) ? 2 : 1;
+            used += 2;
+        } else {
+            break;
+        }
+
+        values |= (uint32_t)code << (2*count);
+        count++;
+    }
+
+    return values | ((uint32_t)count << 16) | ((uint32_t)used << 20);
+}
+
+/* Check that every codebook entry depends only on the low code_size bits of
+** its index, which make_pulse_entry relies on. */
+static int check_codebooks(void)
+{
+    int model, i;
+
+    for (model = 0; model < 2; model++) {
+        for (i = 0; i < 256; i++) {
+            int cmd = utk_codebooks[model][i];
+            int mask = (1 << utk_commands[cmd].code_size) - 1;
+
+            if (utk_codebooks[model][i & mask] != cmd)
+                return 0;
+        }
+    }
+
+    return 1;
+}
+
+int main(void)
+{
+    int model;
+    unsigned i;
+
+    if (!check_codebooks()) {
+        fprintf(stderr, "error: codebooks are not prefix-free\n");
+        return EXIT_FAILURE;
+    }
+
+    printf("/* Generated by utkgentables. Do not edit. */\n");
+    printf("#ifndef UTKTABLES_H\n");
+    printf("#define UTKTABLES_H\n\n");
+    printf("#include <stdint.h>\n\n");
+
+    printf("/* Multi-pulse decoding table, indexed by model and the next %d bits.\n", PULSE_BITS);
+    printf("** bits 0-19: up to %d pulse values, 4 bits each, biased by +8\n", PULSE_MAX);
+    printf("** bits 20-22: number of pulses (0 if the first command is an escape)\n");
+    printf("** bits 23-26: number of bits consumed\n");
+    printf("** bit 27: model after the last pulse */\n");
+    printf("#define UTK_PULSE_BITS %d\n\n", PULSE_BITS);
+    printf("static const uint32_t utk_pulse_table[2][%d] = {\n", 1 << PULSE_BITS);
+    for (model = 0; model < 2; model++) {
+        printf("    { /* %s model */\n", model == MDL_NORMAL ? "normal" : "large-pulse");
+        for (i = 0; i < (1u << PULSE_BITS); i++) {
+            printf("%s0x%08lx%s", (i % 8) == 0 ? "        " : " ",
+                   (unsigned long)make_pulse_entry(model, i),
+                   i == (1u << PULSE_BITS) - 1 ? "\n" : (i % 8) == 7 ? ",\n" : ",");
+        }
+        printf("    }%s\n", model == 0 ? "," : "");
+    }
+    printf("};\n\n");
+
+    printf("/* RELP decoding table, indexed by the next %d bits.\n", RELP_BITS);
+    printf("** bits 0-15: up to 8 samples, 2 bits each (0 = 0, 1 = -2, 2 = +2)\n");
+    printf("** bits 16-19: number of samples\n");
+    printf("** bits 20-23: number of bits consumed */\n");
+    printf("static const uint32_t utk_relp_table[%d] = {\n", 1 << RELP_BITS);
+    for (i = 0; i < (1u << RELP_BITS); i++) {
+        printf("%s0x%08lx%s", (i % 8) == 0 ? "    " : " ",
+               (unsigned long)make_relp_entry(i),
+               i == (1u << RELP_BITS) - 1 ? "\n" : (i % 8) == 7 ? ",\n" : ",");
+    }
+    printf("};\n\n");
+
+    printf("/* utk_rc_table in Q%d fixed point, for utkfixed.h. */\n", RC_FRAC_BITS);
+    printf("#define UTK_RC_FRAC_BITS %d\n\n", RC_FRAC_BITS);
+    printf("static const int32_t utk_rc_table_fixed[64] = {\n");
+    for (i = 0; i < 64; i++) {
+        long x = (long)floor(utk_rc_table[i] * (double)(1L << RC_FRAC_BITS) + 0.5);
+        printf("%s%8ld%s", (i % 8) == 0 ? "    " : " ", x,
+               i == 63 ? "\n" : (i % 8) == 7 ? ",\n" : ",");
+    }
+    printf("};\n\n");
+
+    printf("#endif\n");
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,356 @@
+/*
+** utkindex
+** Build a seek index for Maxis UTK, or benchmark seeking in Maxis UTK and
+** SCxl files.
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
+**          -fwhole-program -g0 -s -o utkindex utkindex.c
+*/
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "utk.h"
+#include "utkseek.h"
+#include "eachunk.h"
+#include "io.h"
+
+#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((d)<<24))
+
+/* minimum time spent on each benchmark measurement */
+#define BENCH_SECONDS 0.2
+
+static const uint32_t bench_intervals[] = {4, 16, 64, 256};
+
+static void check(int ret)
+{
+    if (ret != UTK_OK) {
+        fprintf(stderr, "error: %s\n", utk_error_string(ret));
+        exit(EXIT_FAILURE);
+    }
+}
+
+/* Seek to the given sample by decoding from the start of the stream. */
+static void seek_linear(UTKContext *ctx, const uint8_t *ptr, const uint8_t *end,
+                        uint32_t sample)
+{
+    uint32_t i;
+
+    utk_init(ctx);
+    utk_set_ptr(ctx, ptr, end);
+
+    for (i = 0; i < sample / 432; i++)
+        utk_decode_frame(ctx);
+}
+
+/* Average time in microseconds to seek to sample and decode one frame, with
+** the given index, or from the start if index is NULL. Also check that the
+** frame is the same as ref. */
+static double time_seek(UTKContext *ctx, const UTKSeekIndex *index,
+                        const uint8_t *ptr, const uint8_t *end,
+                        uint32_t sample, const float *ref)
+{
+    clock_t start = clock(), elapsed;
+    long runs = 0;
+
+    do {
+        if (index)
+            check(utk_seek(ctx, index, ptr, end, sample, NULL));
+        else
+            seek_linear(ctx, ptr, end, sample);
+
+        utk_decode_frame(ctx);
+        runs++;
+        elapsed = clock() - start;
+    } while (elapsed < (clock_t)(BENCH_SECONDS * CLOCKS_PER_SEC));
+
+    if (memcmp(ctx->decompressed_frame, ref, 432*sizeof(float)) != 0) {
+        fprintf(stderr, "error: seek to sample %lu gave different output\n",
+                (unsigned long)sample);
+        exit(EXIT_FAILURE);
+    }
+
+    return (double)elapsed / CLOCKS_PER_SEC * 1e6 / runs;
+}
+
+/* Print the seek time against the position in the clip, decoding from the
+** start and with seek indexes of several intervals. */
+static void benchmark(const uint8_t *ptr, const uint8_t *end, uint32_t num_samples,
+                      uint32_t sample_rate)
+{
+    const int num_intervals = sizeof(bench_intervals)/sizeof(bench_intervals[0]);
+    UTKSeekIndex index[sizeof(bench_intervals)/sizeof(bench_intervals[0])];
+    UTKContext *ctx;
+    float ref[432];
+    uint32_t seconds;
+    int i;
+
+    ctx = malloc(sizeof(*ctx));
+    if (!ctx)
+        check(UTK_ERR_NOMEM);
+
+    printf("%lu samples (%.1f s)\n\n", (unsigned long)num_samples,
+           (double)num_samples / sample_rate);
+
+    printf("%-12s %12s", "interval", "from start");
+    for (i = 0; i < num_intervals; i++)
+        printf(" %11lu", (unsigned long)bench_intervals[i]);
+    printf("\n%-12s %12s", "index size", "0");
+    for (i = 0; i < num_intervals; i++) {
+        check(utk_seek_build(&index[i], ptr, end, num_samples, bench_intervals[i]));
+        printf(" %11lu", (unsigned long)utk_seek_saved_size(&index[i]));
+    }
+    printf("\n\nseek time (us) by position:\n");
+
+    /* seek to the last frame starting before 1, 2, 4, ... seconds */
+    for (seconds = 1; ; seconds *= 2) {
+        uint32_t sample = seconds * sample_rate;
+
+        if (sample >= num_samples)
+            sample = num_samples - 1;
+        sample -= sample % 432;
+
+        seek_linear(ctx, ptr, end, sample);
+        utk_decode_frame(ctx);
+        memcpy(ref, ctx->decompressed_frame, sizeof(ref));
+
+        printf("%10.1f s %12.1f", (double)sample / sample_rate,
+               time_seek(ctx, NULL, ptr, end, sample, ref));
+        for (i = 0; i < num_intervals; i++)
+            printf(" %11.1f", time_seek(ctx, &index[i], ptr, end, sample, ref));
+        printf("\n");
+
+        if (seconds * sample_rate >= num_samples)
+            break;
+    }
+
+    for (i = 0; i < num_intervals; i++)
+        utk_seek_free(&index[i]);
+    free(ctx);
+}
+
+/* An SCxl stream, with its SCDl chunks indexed and a checkpoint for each. */
+typedef struct SCxlStream {
+    EADataChunk *index;
+    EACheckpoint *checkpoints;
+    uint32_t num_chunks;
+    uint32_t num_samples;
+    int rev3;
+} SCxlStream;
+
+static void scxl_decode_frame(UTKContext *ctx, const SCxlStream *s)
+{
+    if (s->rev3)
+        check(utk_rev3_decode_frame(ctx));
+    else
+        utk_decode_frame(ctx);
+}
+
+/* Position ctx so that the next frame it decodes holds the given sample:
+** seek to the chunk of the sample with its checkpoint, or if use_checkpoint
+** is 0, decode all of the chunks before it. Then decode the frames of the
+** chunk up to the sample. */
+static void seek_scxl(UTKContext *ctx, const SCxlStream *s, int use_checkpoint,
+                      uint32_t sample)
+{
+    uint32_t c = ea_find_chunk(s->index, s->num_chunks, sample);
+    uint32_t i, j;
+
+    if (use_checkpoint) {
+        ea_seek_chunk(ctx, s->index, s->checkpoints, c, s->rev3);
+    } else {
+        utk_init(ctx);
+        for (i = 0; i < c; i++) {
+            utk_set_ptr(ctx, s->index[i].ptr, s->index[i].end);
+            for (j = 0; j < s->index[i].num_samples; j += 432)
+                scxl_decode_frame(ctx, s);
+        }
+        utk_set_ptr(ctx, s->index[c].ptr, s->index[c].end);
+    }
+
+    for (j = s->index[c].first_sample; sample - j >= 432; j += 432)
+        scxl_decode_frame(ctx, s);
+}
+
+/* Same as time_seek, for an SCxl stream. */
+static double time_seek_scxl(UTKContext *ctx, const SCxlStream *s, int use_checkpoint,
+                             uint32_t sample, const float *ref)
+{
+    clock_t start = clock(), elapsed;
+    long runs = 0;
+
+    do {
+        seek_scxl(ctx, s, use_checkpoint, sample);
+        scxl_decode_frame(ctx, s);
+        runs++;
+        elapsed = clock() - start;
+    } while (elapsed < (clock_t)(BENCH_SECONDS * CLOCKS_PER_SEC));
+
+    if (memcmp(ctx->decompressed_frame, ref, 432*sizeof(float)) != 0) {
+        fprintf(stderr, "error: seek to sample %lu gave different output\n",
+                (unsigned long)sample);
+        exit(EXIT_FAILURE);
+    }
+
+    return (double)elapsed / CLOCKS_PER_SEC * 1e6 / runs;
+}
+
+/* Print the seek time against the position in the first SCxl stream of
+** [data, data+size), decoding from the start and from the checkpoint of
+** the SCDl chunk that holds the sample. */
+static void benchmark_scxl(const uint8_t *data, size_t size)
+{
+    EAStream stream;
+    SCxlStream s;
+    UTKContext *ctx;
+    float ref[432];
+    uint32_t seconds;
+
+    check(ea_open_scxl(&stream, data, size));
+
+    /* an SCDl chunk takes at least 17 bytes, which bounds the index */
+    if (stream.num_chunks > (size_t)(stream.end - stream.next) / 17)
+        check(UTK_ERR_EOF);
+
+    s.num_chunks = stream.num_chunks;
+    s.num_samples = stream.hdr.num_samples;
+    s.rev3 = stream.hdr.codec_revision >= 3;
+    s.index = malloc(s.num_chunks * sizeof(*s.index) + 1);
+    s.checkpoints = malloc(s.num_chunks * sizeof(*s.checkpoints) + 1);
+    ctx = malloc(sizeof(*ctx));
+    if (!s.index || !s.checkpoints || !ctx)
+        check(UTK_ERR_NOMEM);
+
+    check(ea_index_scxl(&stream, s.index));
+    check(ea_build_checkpoints(s.checkpoints, s.index, s.num_chunks, s.rev3));
+
+    printf("%lu samples (%.1f s) in %lu chunks\n\n", (unsigned long)s.num_samples,
+           (double)s.num_samples / 22050, (unsigned long)s.num_chunks);
+    printf("seek time (us) by position:\n");
+    printf("%12s %12s %12s\n", "", "from start", "from chunk");
+
+    /* seek to the frame holding the sample at 1, 2, 4, ... seconds */
+    for (seconds = 1; s.num_samples > 0; seconds *= 2) {
+        uint32_t sample = seconds * 22050;
+
+        if (sample >= s.num_samples)
+            sample = s.num_samples - 1;
+
+        seek_scxl(ctx, &s, 0, sample);
+        scxl_decode_frame(ctx, &s);
+        memcpy(ref, ctx->decompressed_frame, sizeof(ref));
+
+        printf("%10.1f s %12.1f", (double)sample / 22050,
+               time_seek_scxl(ctx, &s, 0, sample, ref));
+        printf(" %12.1f\n", time_seek_scxl(ctx, &s, 1, sample, ref));
+
+        if (seconds * 22050 >= s.num_samples)
+            break;
+    }
+
+    free(s.index);
+    free(s.checkpoints);
+    free(ctx);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *infile, *outfile = NULL;
+    InputFile in;
+    OutputFile out;
+    UTKSeekIndex index;
+    uint32_t num_samples, sample_rate;
+    uint32_t interval = UTK_SEEK_DEFAULT_INTERVAL;
+    uint8_t *data;
+    size_t size;
+    int force = 0;
+    int bench = 0;
+
+    /* Parse arguments. */
+    while (argc > 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-f")) {
+            force = 1;
+        } else if (!strcmp(argv[1], "-b")) {
+            bench = 1;
+        } else if (!strcmp(argv[1], "-n") && argc > 3) {
+            interval = (uint32_t)strtoul(argv[2], NULL, 10);
+            argv++, argc--;
+        } else {
+            break;
+        }
+        argv++, argc--;
+    }
+
+    if (argc != (bench ? 2 : 3) || interval == 0) {
+        printf("Usage: utkindex [-f] [-n interval] infile.utk outfile.utx\n");
+        printf("       utkindex -b infile\n");
+        printf("Build a seek index for Maxis UTK, with a seek point every interval\n");
+        printf("frames (default %d), or benchmark seek time against clip length, in\n",
+               UTK_SEEK_DEFAULT_INTERVAL);
+        printf("a Maxis UTK file or in the first SCxl stream of a file, and check that\n");
+        printf("every seek gives the same output as decoding from the start.\n");
+        return EXIT_FAILURE;
+    }
+
+    infile = argv[1];
+    if (!bench)
+        outfile = argv[2];
+
+    open_input(&in, infile);
+    if (bench && in.size >= 4 && get_u32(in.data) == MAKE_U32('S','C','H','l')) {
+        benchmark_scxl(in.data, in.size);
+        close_input(&in);
+        return EXIT_SUCCESS;
+    }
+
+    if (in.size < 32) {
+        fprintf(stderr, "error: unexpected end of file\n");
+        return EXIT_FAILURE;
+    }
+
+    if (get_u32(in.data) != MAKE_U32('U','T','M','0')) {
+        fprintf(stderr, "error: not a valid UTK file (expected UTM0 signature)\n");
+        return EXIT_FAILURE;
+    }
+
+    num_samples = get_u32(in.data+4)/2;
+    sample_rate = get_u32(in.data+16);
+    if (sample_rate == 0) {
+        fprintf(stderr, "error: invalid UTK header\n");
+        return EXIT_FAILURE;
+    }
+    if (in.size - 32 > UTK_SEEK_MAX_STREAM_SIZE) {
+        fprintf(stderr, "error: stream too large for a seek index (over %lu bytes)\n",
+                (unsigned long)UTK_SEEK_MAX_STREAM_SIZE);
+        return EXIT_FAILURE;
+    }
+
+    if (bench) {
+        if (num_samples > 0)
+            benchmark(in.data + 32, in.data + in.size, num_samples, sample_rate);
+        close_input(&in);
+        return EXIT_SUCCESS;
+    }
+
+    check(utk_seek_build(&index, in.data + 32, in.data + in.size, num_samples, interval));
+
+    size = utk_seek_saved_size(&index);
+    data = malloc(size);
+    if (!data)
+        check(UTK_ERR_NOMEM);
+    utk_seek_save(&index, data);
+
+    open_output(&out, outfile, force);
+    output_bytes(&out, data, size);
+    close_output(&out);
+
+    free(data);
+    utk_seek_free(&index);
+    close_input(&in);
+
+    return EXIT_SUCCESS;
+}
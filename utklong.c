@@ -0,0 +1,298 @@
+/*
+** utklong
+** Write a long synthetic Maxis UTK stream, and check the WAV or RF64 file
+** decoded from it.
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2
+**          -fwhole-program -g0 -s -o utklong utklong.c
+*/
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include "io.h"
+
+/* the longest stream a UTM0 header can describe (dwOutSize is even) */
+#define MAX_SAMPLES 0x7fffffff
+
+/* frames written at a time */
+#define BATCH_FRAMES 1024
+
+/* a frame is 64 bits of reflection coefficients and four subframes of 18
+** bits of pitch and gain and 109 bits of RELP excitation, at most 72 bytes */
+#define MAX_FRAME_BYTES 72
+
+typedef struct BitWriter {
+    uint8_t *ptr;
+    uint32_t value;
+    int count;
+} BitWriter;
+
+/* Write count (at most 24) bits, LSB first. */
+static void write_bits(BitWriter *bw, uint32_t value, int count)
+{
+    bw->value |= value << bw->count;
+    bw->count += count;
+
+    while (bw->count >= 8) {
+        *bw->ptr++ = (uint8_t)bw->value;
+        bw->value >>= 8;
+        bw->count -= 8;
+    }
+}
+
+/* Write one frame of clicks: each subframe starts with an excitation pulse,
+** through a mild and stable filter. Every frame of the output has nonzero
+** samples, so a frame of zeros in the decoded file means that it was not
+** written. */
+static void write_frame(BitWriter *bw)
+{
+    int i, j;
+
+    /* reflection coefficients: rc[0] = 0.41 (index 40, at or above the
+    ** multi-pulse threshold, so the frame is RELP) and 0 for the rest */
+    write_bits(bw, 40, 6);
+    for (i = 1; i < 4; i++)
+        write_bits(bw, 32, 6);
+    for (i = 4; i < 12; i++)
+        write_bits(bw, 16, 5);
+
+    for (i = 0; i < 4; i++) {
+        write_bits(bw, 108, 8); /* pitch lag */
+        write_bits(bw, 8, 4);   /* pitch gain 8/15 */
+        write_bits(bw, 20, 6);  /* fixed gain index */
+
+        /* excitation: +2, then 107 zeros (a 1 bit and a sign of +, then a
+        ** 0 bit for each zero) */
+        write_bits(bw, 3, 2);
+        for (j = 0; j < 107; j += 20)
+            write_bits(bw, 0, j + 20 <= 107 ? 20 : 107 - j);
+    }
+}
+
+/* Write a UTM0 file of num_samples samples at 22050 Hz. */
+static void generate(const char *path, uint32_t num_samples, int force)
+{
+    static uint8_t buffer[BATCH_FRAMES*MAX_FRAME_BYTES + 8];
+    uint32_t num_frames = num_samples/432 + (num_samples % 432 != 0), i;
+    uint8_t hdr[32];
+    BitWriter bw;
+    OutputFile out;
+
+    memset(hdr, 0, sizeof(hdr));
+    memcpy(hdr, "UTM0", 4);
+    put_u32(hdr+4, 2*num_samples);  /* dwOutSize */
+    put_u32(hdr+8, 20);             /* dwWfxSize */
+    put_u16(hdr+12, 1);             /* wFormatTag */
+    put_u16(hdr+14, 1);             /* nChannels */
+    put_u32(hdr+16, 22050);         /* nSamplesPerSec */
+    put_u32(hdr+20, 44100);         /* nAvgBytesPerSec */
+    put_u16(hdr+24, 2);             /* nBlockAlign */
+    put_u16(hdr+26, 16);            /* wBitsPerSample */
+
+    open_output(&out, path, force);
+    output_bytes(&out, hdr, sizeof(hdr));
+
+    /* stream header: full bandwidth, multi-pulse threshold 32, the first
+    ** fixed gain 8.0 and a ratio of 1.04 between fixed gains */
+    bw.ptr = buffer;
+    bw.value = 0;
+    bw.count = 0;
+    write_bits(&bw, 0, 15);
+
+    for (i = 0; i < num_frames; i++) {
+        write_frame(&bw);
+
+        if ((i+1) % BATCH_FRAMES == 0 || i+1 == num_frames) {
+            if (i+1 == num_frames) {
+                /* the last partial byte, and some padding for the bit
+                ** reader */
+                write_bits(&bw, 0, 24);
+                write_bits(&bw, 0, 16);
+            }
+            output_bytes(&out, buffer, (size_t)(bw.ptr - buffer));
+            bw.ptr = buffer;
+        }
+    }
+
+    close_output(&out);
+}
+
+/*
+** Checking.
+*/
+
+typedef struct Reader {
+    FILE *fp;
+    const char *path;
+    uint64_t pos;
+} Reader;
+
+static void fail(const Reader *r, const char *what)
+{
+    fprintf(stderr, "%s: error at byte %lu: %s\n", r->path, (unsigned long)r->pos, what);
+    exit(EXIT_FAILURE);
+}
+
+static void read_exact(Reader *r, uint8_t *dest, size_t size)
+{
+    if (fread(dest, 1, size, r->fp) != size)
+        fail(r, ferror(r->fp) ? strerror(errno) : "unexpected end of file");
+    r->pos += size;
+}
+
+/* Check a WAV file (or an RF64 file, if it takes one) of num_samples
+** samples decoded from a generated stream: its header, its ds64 and fact
+** sizes, the size of its data, and that no frame of it is all zero. */
+static void check(const char *path, uint32_t num_samples, int use_float)
+{
+    static uint8_t buffer[1 << 16];
+    int bps = use_float ? 4 : 2;
+    uint64_t data_size = (uint64_t)num_samples * bps;
+    int rf64 = WAV_HEADER_SIZE(use_float) - 8 + data_size > 0xffffffff;
+    uint64_t riff_size, frame_bytes = 432*bps, frame_pos = 0, read = 0;
+    uint8_t hdr[48];
+    int nonzero = 0;
+    Reader r;
+
+    r.path = path;
+    r.pos = 0;
+    r.fp = strcmp(path, "-") ? fopen(path, "rb") : stdin;
+    if (!r.fp) {
+        fprintf(stderr, "error: failed to open '%s': %s\n", path, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    read_exact(&r, hdr, 12);
+    if (memcmp(hdr+8, "WAVE", 4) != 0)
+        fail(&r, "not a WAV file");
+
+    if (rf64) {
+        /* the 32-bit sizes are all 0xffffffff, and the real ones are in
+        ** ds64, which must come first */
+        if (memcmp(hdr, "RF64", 4) != 0 || get_u32(hdr+4) != 0xffffffff)
+            fail(&r, "expected an RF64 header with a RIFF size of 0xffffffff");
+        read_exact(&r, hdr, 36);
+        if (memcmp(hdr, "ds64", 4) != 0 || get_u32(hdr+4) != 28)
+            fail(&r, "expected a 28-byte ds64 chunk");
+        riff_size = get_u32(hdr+8) | (uint64_t)get_u32(hdr+12) << 32;
+        if (riff_size != WAV_HEADER_SIZE(use_float) + WAV_DS64_SIZE - 8 + data_size)
+            fail(&r, "wrong ds64 riffSize");
+        if ((get_u32(hdr+16) | (uint64_t)get_u32(hdr+20) << 32) != data_size)
+            fail(&r, "wrong ds64 dataSize");
+        if ((get_u32(hdr+24) | (uint64_t)get_u32(hdr+28) << 32) != num_samples)
+            fail(&r, "wrong ds64 sampleCount");
+        if (get_u32(hdr+32) != 0)
+            fail(&r, "unexpected ds64 table");
+    } else {
+        riff_size = WAV_HEADER_SIZE(use_float) - 8 + data_size;
+        if (memcmp(hdr, "RIFF", 4) != 0 || get_u32(hdr+4) != riff_size)
+            fail(&r, "expected a RIFF header with the RIFF size of the file");
+    }
+
+    read_exact(&r, hdr, use_float ? 26 : 24);
+    if (memcmp(hdr, "fmt ", 4) != 0 || get_u32(hdr+4) != (uint32_t)(use_float ? 18 : 16)
+        || get_u16(hdr+8) != (use_float ? 3 : 1) || get_u16(hdr+10) != 1
+        || get_u32(hdr+12) != 22050 || get_u32(hdr+16) != 22050*(uint32_t)bps
+        || get_u16(hdr+20) != bps || get_u16(hdr+22) != 8*bps)
+        fail(&r, "wrong fmt chunk");
+
+    if (use_float) {
+        read_exact(&r, hdr, 12);
+        if (memcmp(hdr, "fact", 4) != 0 || get_u32(hdr+4) != 4
+            || get_u32(hdr+8) != (rf64 ? 0xffffffff : num_samples))
+            fail(&r, rf64 ? "expected a fact sample count of 0xffffffff" : "wrong fact chunk");
+    }
+
+    read_exact(&r, hdr, 8);
+    if (memcmp(hdr, "data", 4) != 0
+        || get_u32(hdr+4) != (rf64 ? 0xffffffff : (uint32_t)data_size))
+        fail(&r, rf64 ? "expected a data size of 0xffffffff" : "wrong data size");
+
+    /* the data, up to the end of the file */
+    for (;;) {
+        size_t n = fread(buffer, 1, sizeof(buffer), r.fp), i;
+
+        if (n == 0)
+            break;
+
+        for (i = 0; i < n; i++) {
+            nonzero |= buffer[i];
+            if (++frame_pos == frame_bytes || read + i + 1 == data_size) {
+                if (!nonzero) {
+                    r.pos += i + 1 - frame_pos;
+                    fail(&r, "a frame of the data is all zero");
+                }
+                frame_pos = 0;
+                nonzero = 0;
+            }
+        }
+
+        read += n;
+        r.pos += n;
+    }
+
+    if (ferror(r.fp))
+        fail(&r, strerror(errno));
+    if (read != data_size)
+        fail(&r, read < data_size ? "the data is truncated" : "data past the end of the data chunk");
+    if (r.pos != riff_size + 8)
+        fail(&r, "the file size does not match the RIFF size");
+
+    if (r.fp != stdin)
+        fclose(r.fp);
+
+    printf("%s: %s, %lu samples, %lu bytes: OK\n", path, rf64 ? "RF64" : "WAV",
+           (unsigned long)num_samples, (unsigned long)r.pos);
+}
+
+int main(int argc, char *argv[])
+{
+    int check_mode = 0, use_float = 0, force = 0;
+    unsigned long num_samples;
+    char *end;
+
+    /* Parse arguments. */
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+        if (!strcmp(argv[1], "-c"))
+            check_mode = 1;
+        else if (!strcmp(argv[1], "--float"))
+            use_float = 1;
+        else if (!strcmp(argv[1], "-f"))
+            force = 1;
+        else
+            break;
+        argv++, argc--;
+    }
+
+    if (argc != 3 || argv[1][0] == '-') {
+        printf("Usage: utklong [-f] samples out.utk\n");
+        printf("       utklong -c [--float] samples in.wav\n");
+        printf("Write a Maxis UTK stream of up to %lu samples of a synthetic buzz, or\n",
+               (unsigned long)MAX_SAMPLES);
+        printf("check the WAV file decoded from it by utkdecode (with --float if it was\n");
+        printf("decoded with --float): its header, which must be RF64 past 4 GiB, the\n");
+        printf("sizes in its ds64 and fact chunks, the size of its data, and that no\n");
+        printf("frame of the data is all zero. Use - for stdout or stdin, e.g.:\n");
+        printf("  utklong %lu - | utkdecode - - | utklong -c %lu -\n",
+               (unsigned long)MAX_SAMPLES, (unsigned long)MAX_SAMPLES);
+        return EXIT_FAILURE;
+    }
+
+    errno = 0;
+    num_samples = strtoul(argv[1], &end, 10);
+    if (*end != '\0' || errno != 0 || num_samples == 0 || num_samples > MAX_SAMPLES) {
+        fprintf(stderr, "error: invalid number of samples '%s'\n", argv[1]);
+        return EXIT_FAILURE;
+    }
+
+    if (check_mode)
+        check(argv[2], (uint32_t)num_samples, use_float);
+    else
+        generate(argv[2], (uint32_t)num_samples, force);
+
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,229 @@
+#ifndef UTKMIX_H
+#define UTKMIX_H
+
+#include <stdlib.h>
+#include <math.h>
+#include "utk.h"
+
+/* Mixing many MicroTalk voices into one stereo bus.
+**
+**     UTKMixer mixer;
+**     float bus[2*256];
+**     utk_mixer_init(&mixer, 256);
+**     id = utk_mixer_play(&mixer, ptr, end, num_samples, 1.0f, 0.0f);
+**     ...
+**     utk_mixer_mix(&mixer, bus, 256);
+**     ...
+**     utk_mixer_free(&mixer);
+**
+** The mixer owns a pool of voices, allocated in one block by
+** utk_mixer_init, so starting a voice and recycling a finished one never
+** allocate. The playing voices are listed in a dense array, so a mix block
+** only visits those, however large the pool. Each voice decodes one Maxis
+** UTK or PT bitstream from memory, one frame at a time and only as far as
+** the current mix block needs, and is added to the bus with its own gain
+** and pan (utk_mix_stereo in utkdsp.h). A voice is recycled as soon as all
+** of its samples have been mixed.
+**
+** Voices play at the rate of their streams, which should all be that of the
+** bus (22050 Hz for PT; see the header of a Maxis UTK file). The bus is
+** interleaved stereo, with int16 full scale at +-1.0, like utk_decode_f32.
+** A mixer is not thread-safe: to mix on several cores, use one per thread
+** and add up their buses. */
+
+/* voice ids are the index of the voice in the pool, plus a count of how
+** often it has been reused, so that an id stops working once its voice is
+** recycled */
+#define UTK_MIXER_MAX_VOICES 65535
+
+typedef struct UTKVoice {
+    uint32_t samples_left; /* not yet mixed */
+    int pos;               /* of the next sample in utk.decompressed_frame */
+    float gain_l, gain_r;  /* including the scale to +-1.0 */
+    int id;                /* or -1 if the voice is free */
+    int next_free;
+    int active_pos;        /* in mixer->active, while playing */
+    UTKContext utk;
+} UTKVoice;
+
+typedef struct UTKMixer {
+    UTKVoice *voices;
+    int *active;           /* the playing voices, num_playing of them */
+    int max_voices;
+    int num_playing;
+    int first_free;        /* or -1 */
+    unsigned generation;
+} UTKMixer;
+
+/* Constant-power panning: pan is -1.0 (left) to 1.0 (right). */
+static void utk_mixer_pan(UTKVoice *v, float gain, float pan)
+{
+    double angle;
+
+    pan = pan < -1.0f ? -1.0f : pan > 1.0f ? 1.0f : pan;
+    angle = (pan + 1.0) * (3.14159265358979323846 / 4);
+
+    v->gain_l = (float)(gain * cos(angle) * 1.4142135623730951 / 32768.0);
+    v->gain_r = (float)(gain * sin(angle) * 1.4142135623730951 / 32768.0);
+}
+
+static UTKVoice *utk_mixer_voice(UTKMixer *mixer, int id)
+{
+    int i = id & 0xffff;
+
+    if (id < 0 || i >= mixer->max_voices || mixer->voices[i].id != id)
+        return NULL;
+
+    return &mixer->voices[i];
+}
+
+static void utk_mixer_release(UTKMixer *mixer, UTKVoice *v)
+{
+    int last = mixer->active[--mixer->num_playing];
+
+    /* move the last playing voice into its place */
+    mixer->active[v->active_pos] = last;
+    mixer->voices[last].active_pos = v->active_pos;
+
+    v->id = -1;
+    v->next_free = mixer->first_free;
+    mixer->first_free = (int)(v - mixer->voices);
+}
+
+/*
+** Public functions.
+*/
+
+static int utk_mixer_init(UTKMixer *mixer, int max_voices)
+{
+    int i;
+
+    memset(mixer, 0, sizeof(*mixer));
+
+    if (max_voices < 1 || max_voices > UTK_MIXER_MAX_VOICES)
+        return UTK_ERR_INVALID_ARG;
+
+    mixer->voices = malloc((size_t)max_voices * sizeof(*mixer->voices));
+    mixer->active = malloc((size_t)max_voices * sizeof(*mixer->active));
+    if (!mixer->voices || !mixer->active) {
+        free(mixer->voices);
+        free(mixer->active);
+        mixer->voices = NULL;
+        mixer->active = NULL;
+        return UTK_ERR_NOMEM;
+    }
+
+    mixer->max_voices = max_voices;
+    mixer->first_free = 0;
+
+    for (i = 0; i < max_voices; i++) {
+        mixer->voices[i].id = -1;
+        mixer->voices[i].next_free = i + 1 < max_voices ? i + 1 : -1;
+    }
+
+    return UTK_OK;
+}
+
+static void utk_mixer_free(UTKMixer *mixer)
+{
+    free(mixer->voices);
+    free(mixer->active);
+    memset(mixer, 0, sizeof(*mixer));
+}
+
+/* Start a voice playing the num_samples-sample bitstream in [ptr, end),
+** which must stay valid until the voice has finished. Returns the id of the
+** voice, or -1 if every voice is playing. */
+static int utk_mixer_play(UTKMixer *mixer, const uint8_t *ptr, const uint8_t *end,
+                          uint32_t num_samples, float gain, float pan)
+{
+    UTKVoice *v;
+    int i = mixer->first_free;
+
+    if (i < 0)
+        return -1;
+
+    v = &mixer->voices[i];
+    mixer->first_free = v->next_free;
+    v->active_pos = mixer->num_playing;
+    mixer->active[mixer->num_playing++] = i;
+
+    utk_init(&v->utk);
+    utk_set_ptr(&v->utk, ptr, end);
+    v->samples_left = num_samples;
+    v->pos = 432;
+    utk_mixer_pan(v, gain, pan);
+
+    mixer->generation = (mixer->generation + 1) & 0x7fff;
+    v->id = (int)(mixer->generation << 16) | i;
+
+    return v->id;
+}
+
+/* Whether a voice is still playing. */
+static int utk_mixer_playing(UTKMixer *mixer, int id)
+{
+    return utk_mixer_voice(mixer, id) != NULL;
+}
+
+/* Change the gain and pan of a voice, from the next mix block on. */
+static void utk_mixer_set(UTKMixer *mixer, int id, float gain, float pan)
+{
+    UTKVoice *v = utk_mixer_voice(mixer, id);
+
+    if (v)
+        utk_mixer_pan(v, gain, pan);
+}
+
+/* Stop a voice before it has finished. */
+static void utk_mixer_stop(UTKMixer *mixer, int id)
+{
+    UTKVoice *v = utk_mixer_voice(mixer, id);
+
+    if (v)
+        utk_mixer_release(mixer, v);
+}
+
+/* Mix the next n samples of every voice into bus[2*n], which is cleared
+** first. */
+static void utk_mixer_mix(UTKMixer *mixer, float *bus, int n)
+{
+    int i;
+
+    memset(bus, 0, 2 * (size_t)n * sizeof(float));
+
+    /* (a voice that finishes is replaced by the last one in the list, which
+    ** is mixed next) */
+    for (i = 0; i < mixer->num_playing; ) {
+        UTKVoice *v = &mixer->voices[mixer->active[i]];
+        int done = 0;
+
+        while (done < n && v->samples_left > 0) {
+            int count = n - done;
+
+            if (v->pos == 432) {
+                utk_decode_frame(&v->utk);
+                v->pos = 0;
+            }
+
+            if (count > 432 - v->pos)
+                count = 432 - v->pos;
+            if ((uint32_t)count > v->samples_left)
+                count = (int)v->samples_left;
+
+            utk_mix_stereo(&bus[2*done], &v->utk.decompressed_frame[v->pos], count,
+                           v->gain_l, v->gain_r);
+
+            v->pos += count;
+            v->samples_left -= count;
+            done += count;
+        }
+
+        if (v->samples_left == 0)
+            utk_mixer_release(mixer, v);
+        else
+            i++;
+    }
+}
+
+#endif
@@ -0,0 +1,235 @@
+#ifndef UTKMULTI_H
+#define UTKMULTI_H
+
+#include "utk.h"
+
+/* Lane-parallel decoding of several independent MicroTalk streams.
+**
+** Bitstream parsing and the adaptive codebook mix are done per stream, as
+** in utk_decode_frame. The rc interpolation, rc_to_lpc and the synthesis
+** filter (most of the decoding time, and strictly sequential within one
+** stream) are done on all streams at once, with the streams stored as
+** struct-of-arrays so that each SIMD lane runs one stream. Each lane
+** produces the same samples as utk_decode_frame with -DUTK_NO_SIMD. */
+
+#ifndef UTK_MULTI_LANES
+#define UTK_MULTI_LANES 8
+#endif
+
+#if UTK_MULTI_LANES != 4 && UTK_MULTI_LANES != 8 && UTK_MULTI_LANES != 16
+#error "UTK_MULTI_LANES must be 4, 8 or 16"
+#endif
+
+#define UTK_L UTK_MULTI_LANES
+
+typedef struct UTKMultiContext {
+    /* per-stream state; lane[i].decompressed_frame holds the output */
+    UTKContext lane[UTK_L];
+    int active[UTK_L];
+
+    /* struct-of-arrays scratch, indexed [sample or coefficient][lane] */
+    float rc[12][UTK_L];
+    float rc_delta[12][UTK_L];
+    float samples[12+432][UTK_L]; /* 12 samples of history, then the frame */
+} UTKMultiContext;
+
+static void utk_multi_rc_to_lpc(const float (*rc)[UTK_L], float (*lpc)[UTK_L])
+{
+    int i, j, l;
+    float tmp1[12][UTK_L];
+    float tmp2[12][UTK_L];
+    float x[UTK_L];
+
+    for (i = 10; i >= 0; i--)
+        for (l = 0; l < UTK_L; l++)
+            tmp2[1+i][l] = rc[i][l];
+
+    for (l = 0; l < UTK_L; l++)
+        tmp2[0][l] = 1.0f;
+
+    for (i = 0; i < 12; i++) {
+        for (l = 0; l < UTK_L; l++)
+            x[l] = -tmp2[11][l] * rc[11][l];
+
+        for (j = 10; j >= 0; j--) {
+            for (l = 0; l < UTK_L; l++) {
+                x[l] -= tmp2[j][l] * rc[j][l];
+                tmp2[j+1][l] = x[l] * rc[j][l] + tmp2[j][l];
+            }
+        }
+
+        for (l = 0; l < UTK_L; l++)
+            tmp1[i][l] = tmp2[0][l] = x[l];
+
+        for (j = 0; j < i; j++)
+            for (l = 0; l < UTK_L; l++)
+                x[l] -= tmp1[i-1-j][l] * lpc[j][l];
+
+        for (l = 0; l < UTK_L; l++)
+            lpc[i][l] = x[l];
+    }
+}
+
+/* The recursive form of utk_synthesize_c, one stream per lane, on
+** y[0..num_samples-1]. The 12 previous outputs are read from y[-12..-1]
+** rather than from a separate history, so every sample is computed the same
+** way. The terms are summed in the same order as in utk_synthesize_c. */
+#if defined(UTK_SIMD_AVX) && UTK_L >= 8
+static void utk_multi_synthesize(float (*y)[UTK_L], int num_samples,
+                                 const float (*a)[UTK_L])
+{
+    int i, k, l;
+
+    for (i = 0; i < num_samples; i++) {
+        for (l = 0; l < UTK_L; l += 8) {
+            __m256 x = _mm256_loadu_ps(&y[i][l]);
+
+            for (k = 0; k < 12; k++)
+                x = _mm256_add_ps(x, _mm256_mul_ps(_mm256_loadu_ps(&a[k][l]),
+                                                   _mm256_loadu_ps(&y[i-1-k][l])));
+
+            _mm256_storeu_ps(&y[i][l], x);
+        }
+    }
+}
+#elif defined(UTK_SIMD_AVX) || defined(UTK_SIMD_SSE2)
+static void utk_multi_synthesize(float (*y)[UTK_L], int num_samples,
+                                 const float (*a)[UTK_L])
+{
+    int i, k, l;
+
+    for (i = 0; i < num_samples; i++) {
+        for (l = 0; l < UTK_L; l += 4) {
+            __m128 x = _mm_loadu_ps(&y[i][l]);
+
+            for (k = 0; k < 12; k++)
+                x = _mm_add_ps(x, _mm_mul_ps(_mm_loadu_ps(&a[k][l]),
+                                             _mm_loadu_ps(&y[i-1-k][l])));
+
+            _mm_storeu_ps(&y[i][l], x);
+        }
+    }
+}
+#else
+static void utk_multi_synthesize(float (*y)[UTK_L], int num_samples,
+                                 const float (*a)[UTK_L])
+{
+    int i, k, l;
+
+    for (i = 0; i < num_samples; i++) {
+        float x[UTK_L];
+
+        for (l = 0; l < UTK_L; l++)
+            x[l] = y[i][l];
+
+        for (k = 0; k < 12; k++)
+            for (l = 0; l < UTK_L; l++)
+                x[l] += a[k][l] * y[i-1-k][l];
+
+        for (l = 0; l < UTK_L; l++)
+            y[i][l] = x[l];
+    }
+}
+#endif
+
+/*
+** Public functions.
+*/
+
+static void utk_multi_init(UTKMultiContext *m)
+{
+    memset(m, 0, sizeof(*m));
+}
+
+/* Start decoding a new stream from memory in the given lane. */
+static void utk_multi_set_ptr(UTKMultiContext *m, int lane,
+                              const uint8_t *ptr, const uint8_t *end)
+{
+    utk_init(&m->lane[lane]);
+    utk_set_ptr(&m->lane[lane], ptr, end);
+    m->active[lane] = 1;
+}
+
+/* Start decoding a new stream from a file in the given lane. */
+static void utk_multi_set_fp(UTKMultiContext *m, int lane, FILE *fp, UTKFileBuffer *file)
+{
+    utk_init(&m->lane[lane]);
+    utk_set_fp(&m->lane[lane], fp, file);
+    m->active[lane] = 1;
+}
+
+/* Stop decoding in the given lane. Its output becomes silence. */
+static void utk_multi_clear(UTKMultiContext *m, int lane)
+{
+    utk_init(&m->lane[lane]);
+    m->active[lane] = 0;
+}
+
+/* Decode one frame in every active lane. */
+static void utk_multi_decode_frame(UTKMultiContext *m)
+{
+    UTKFrame frame;
+    float lpc[12][UTK_L];
+    int i, j, l;
+
+    for (l = 0; l < UTK_L; l++) {
+        UTKContext *ctx = &m->lane[l];
+        const float *excitation;
+
+        if (!m->active[l]) {
+            /* keep idle lanes at zero */
+            for (j = 0; j < 12; j++)
+                m->rc[j][l] = m->rc_delta[j][l] = 0.0f;
+            for (i = 0; i < 12+432; i++)
+                m->samples[i][l] = 0.0f;
+            continue;
+        }
+
+        utk_parse_frame(ctx, &frame);
+
+        for (j = 0; j < 12; j++) {
+            m->rc[j][l] = ctx->rc[j];
+            m->rc_delta[j][l] = (frame.rc[j] - ctx->rc[j])*0.25f;
+            m->samples[11-j][l] = ctx->synth_history[j];
+        }
+
+        /* The pitch lag differs between streams, so a lane-parallel mix
+        ** would need a gather for every sample. Mixing along time is already
+        ** vectorized, and the codebook must stay in the per-stream ring
+        ** anyway: lags above 216 read the (old) rc and synth_history, which
+        ** is why they are left in ctx until the mix is done. */
+        excitation = utk_mix_frame(ctx, &frame);
+
+        for (i = 0; i < 432; i++)
+            m->samples[12+i][l] = excitation[i];
+    }
+
+    for (i = 0; i < 4; i++) {
+        for (j = 0; j < 12; j++)
+            for (l = 0; l < UTK_L; l++)
+                m->rc[j][l] += m->rc_delta[j][l];
+
+        utk_multi_rc_to_lpc((const float (*)[UTK_L])m->rc, lpc);
+        utk_multi_synthesize(&m->samples[12+12*i], i < 3 ? 12 : 396,
+                             (const float (*)[UTK_L])lpc);
+    }
+
+    for (l = 0; l < UTK_L; l++) {
+        UTKContext *ctx = &m->lane[l];
+
+        if (!m->active[l])
+            continue;
+
+        for (j = 0; j < 12; j++) {
+            ctx->rc[j] = m->rc[j][l];
+            ctx->synth_history[j] = m->samples[12+431-j][l];
+        }
+
+        for (i = 0; i < 432; i++)
+            ctx->decompressed_frame[i] = m->samples[12+i][l];
+    }
+}
+
+#undef UTK_L
+
+#endif
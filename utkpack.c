@@ -0,0 +1,505 @@
+/*
+** utkpack
+** Pack many Maxis UTK clips into one indexed file (utkpack.h), list or
+** extract them, or benchmark lookups against opening each file.
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
+**          -fwhole-program -g0 -s -o utkpack utkpack.c
+*/
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include "utk.h"
+#include "utkpack.h"
+#include "io.h"
+
+#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((d)<<24))
+
+/* minimum time spent on each benchmark measurement */
+#define BENCH_SECONDS 0.5
+
+typedef struct Clip {
+    const char *name;
+    uint64_t hash;
+    uint64_t offset;
+    uint32_t data_size;
+    uint32_t num_samples;
+    uint32_t sample_rate;
+    uint32_t name_offset;
+    int header;
+} Clip;
+
+static Clip *clips;
+static size_t num_clips;
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "error: %s\n", what);
+    exit(EXIT_FAILURE);
+}
+
+static void check(int ret)
+{
+    if (ret != UTK_OK)
+        fail(utk_error_string(ret));
+}
+
+/*
+** Creating a pack.
+*/
+
+static void add_path(const char *path)
+{
+    static size_t capacity;
+    char *copy;
+
+    if (num_clips == capacity) {
+        Clip *p;
+
+        capacity = capacity ? 2*capacity : 256;
+        p = realloc(clips, capacity * sizeof(*clips));
+        if (!p)
+            fail("out of memory");
+        clips = p;
+    }
+
+    copy = malloc(strlen(path) + 1);
+    if (!copy)
+        fail("out of memory");
+    strcpy(copy, path);
+
+    memset(&clips[num_clips], 0, sizeof(*clips));
+    clips[num_clips].name = copy;
+    clips[num_clips].hash = utk_pack_hash(copy);
+    num_clips++;
+}
+
+/* Add every line of a manifest file ("-" for stdin) as an input path. */
+static void add_manifest(const char *path)
+{
+    InputFile in;
+    char *text, *line, *end;
+
+    open_input(&in, path);
+
+    text = malloc(in.size + 1);
+    if (!text)
+        fail("out of memory");
+    memcpy(text, in.data, in.size);
+    text[in.size] = '\0';
+    close_input(&in);
+
+    for (line = text; *line; line = end) {
+        size_t len;
+
+        end = line + strcspn(line, "\n");
+        len = end - line;
+        if (*end)
+            *end++ = '\0';
+
+        if (len > 0 && line[len-1] == '\r')
+            line[--len] = '\0';
+        if (len > 0)
+            add_path(line);
+    }
+
+    free(text);
+}
+
+/* Check the UTM0 header of a clip, like utkdecode, and read its stream
+** header. */
+static void read_clip(Clip *clip, const InputFile *in)
+{
+    const uint8_t *p = in->data;
+    uint32_t sample_rate;
+
+    if (in->size < 32 || get_u32(p) != MAKE_U32('U','T','M','0')) {
+        fprintf(stderr, "error: '%s' is not a valid UTK file (expected UTM0 signature)\n",
+                clip->name);
+        exit(EXIT_FAILURE);
+    }
+
+    sample_rate = get_u32(p+16);
+    if ((get_u32(p+4) & 0x01) != 0
+        || get_u32(p+8) != 20 || get_u16(p+12) != 1 || get_u16(p+14) != 1
+        || sample_rate < 8000 || sample_rate > 192000
+        || get_u32(p+20) != sample_rate * 2 || get_u16(p+24) != 2
+        || get_u16(p+26) != 16 || get_u16(p+28) != 0) {
+        fprintf(stderr, "error: '%s' has an invalid or unsupported UTK header\n", clip->name);
+        exit(EXIT_FAILURE);
+    }
+    if (in->size - 32 > 0xffffffff) {
+        fprintf(stderr, "error: '%s' is too large for a pack\n", clip->name);
+        exit(EXIT_FAILURE);
+    }
+
+    clip->num_samples = get_u32(p+4)/2;
+    clip->sample_rate = sample_rate;
+
+    /* the first 15 bits of the bitstream (bytes past the end read as 0) */
+    clip->header = (in->size > 32 ? p[32] : 0) | (in->size > 33 ? (p[33] & 0x7f) << 8 : 0);
+
+    /* the rest, shifted to start at a byte */
+    clip->data_size = in->size > 33 ? (uint32_t)(in->size - 33) : 0;
+}
+
+/* Write the bitstream of a clip after its stream header, shifted 15 bits
+** down. */
+static void output_clip_data(OutputFile *out, const Clip *clip, const InputFile *in)
+{
+    const uint8_t *p = in->data + 32;
+    const uint8_t *end = in->data + in->size;
+    uint8_t buf[4096];
+    uint32_t i = 0;
+
+    while (i < clip->data_size) {
+        size_t n = 0;
+
+        for (; n < sizeof(buf) && i < clip->data_size; n++, i++)
+            buf[n] = (uint8_t)((p[i+1] >> 7) | ((p + i + 2 < end ? p[i+2] : 0) << 1));
+
+        output_bytes(out, buf, n);
+    }
+}
+
+static int compare_clips(const void *a, const void *b)
+{
+    const Clip *x = *(const Clip *const *)a, *y = *(const Clip *const *)b;
+
+    if (x->hash != y->hash)
+        return x->hash < y->hash ? -1 : 1;
+    return strcmp(x->name, y->name);
+}
+
+static void create_pack(const char *outfile, int force)
+{
+    Clip **sorted;
+    uint8_t *index;
+    uint64_t offset, names_size = 0;
+    OutputFile out;
+    InputFile in;
+    size_t i;
+
+    /* read the headers */
+    for (i = 0; i < num_clips; i++) {
+        open_input(&in, clips[i].name);
+        read_clip(&clips[i], &in);
+        close_input(&in);
+    }
+
+    /* sort the index, and lay out the name table in its order */
+    sorted = malloc(num_clips * sizeof(*sorted));
+    if (!sorted)
+        fail("out of memory");
+    for (i = 0; i < num_clips; i++)
+        sorted[i] = &clips[i];
+    qsort(sorted, num_clips, sizeof(*sorted), compare_clips);
+
+    for (i = 0; i < num_clips; i++) {
+        if (i > 0 && !compare_clips(&sorted[i-1], &sorted[i])) {
+            fprintf(stderr, "error: '%s' is listed twice\n", sorted[i]->name);
+            exit(EXIT_FAILURE);
+        }
+        sorted[i]->name_offset = (uint32_t)names_size;
+        names_size += strlen(sorted[i]->name) + 1;
+    }
+    if (num_clips > 0x7fffffff || names_size > 0xffffffff)
+        fail("too many clips");
+
+    /* the clip data follows in input order */
+    offset = UTK_PACK_HEADER_SIZE + (uint64_t)num_clips*UTK_PACK_ENTRY_SIZE + names_size;
+    for (i = 0; i < num_clips; i++) {
+        clips[i].offset = offset;
+        offset += clips[i].data_size;
+    }
+
+    index = calloc(UTK_PACK_HEADER_SIZE + num_clips*UTK_PACK_ENTRY_SIZE, 1);
+    if (!index)
+        fail("out of memory");
+
+    memcpy(index, "UTKP", 4);
+    utk_pack_put_u32(index + 4, 1);
+    utk_pack_put_u32(index + 8, (uint32_t)num_clips);
+    utk_pack_put_u32(index + 12, (uint32_t)names_size);
+
+    for (i = 0; i < num_clips; i++) {
+        uint8_t *entry = index + UTK_PACK_HEADER_SIZE + i*UTK_PACK_ENTRY_SIZE;
+
+        utk_pack_put_u64(entry, sorted[i]->hash);
+        utk_pack_put_u64(entry + 8, sorted[i]->offset);
+        utk_pack_put_u32(entry + 16, sorted[i]->data_size);
+        utk_pack_put_u32(entry + 20, sorted[i]->num_samples);
+        utk_pack_put_u32(entry + 24, sorted[i]->sample_rate);
+        utk_pack_put_u32(entry + 28, sorted[i]->name_offset);
+        entry[32] = (uint8_t)sorted[i]->header;
+        entry[33] = (uint8_t)(sorted[i]->header >> 8);
+    }
+
+    open_output(&out, outfile, force);
+    output_bytes(&out, index, UTK_PACK_HEADER_SIZE + num_clips*UTK_PACK_ENTRY_SIZE);
+    for (i = 0; i < num_clips; i++)
+        output_bytes(&out, (const uint8_t *)sorted[i]->name, strlen(sorted[i]->name) + 1);
+
+    for (i = 0; i < num_clips; i++) {
+        open_input(&in, clips[i].name);
+        if ((in.size > 33 ? in.size - 33 : 0) != clips[i].data_size) {
+            fprintf(stderr, "error: '%s' changed while packing\n", clips[i].name);
+            exit(EXIT_FAILURE);
+        }
+        output_clip_data(&out, &clips[i], &in);
+        close_input(&in);
+    }
+
+    close_output(&out);
+
+    free(index);
+    free(sorted);
+}
+
+/*
+** Reading a pack.
+*/
+
+static void list_pack(const UTKPack *pack)
+{
+    UTKPackClip clip;
+    uint32_t i;
+
+    for (i = 0; i < pack->num_clips; i++) {
+        check(utk_pack_get(pack, i, &clip));
+        printf("%10lu samples %6lu Hz %10lu bytes  %s\n", (unsigned long)clip.num_samples,
+               (unsigned long)clip.sample_rate, (unsigned long)(clip.end - clip.ptr), clip.name);
+    }
+}
+
+static void extract_clip(const UTKPack *pack, const char *name, const char *outfile, int force)
+{
+    uint8_t header[WAV_MAX_HEADER_SIZE];
+    int16_t pcm[16*432];
+    UTKContext *ctx;
+    UTKPackClip clip;
+    OutputFile out;
+    uint32_t left;
+    int i = utk_pack_find(pack, name);
+
+    if (i < 0) {
+        fprintf(stderr, "error: no clip named '%s'\n", name);
+        exit(EXIT_FAILURE);
+    }
+    check(utk_pack_get(pack, (uint32_t)i, &clip));
+
+    ctx = malloc(sizeof(*ctx));
+    if (!ctx)
+        fail("out of memory");
+    utk_pack_start(ctx, &clip);
+
+    open_output(&out, outfile, force);
+    make_wav_header(header, clip.sample_rate, clip.num_samples, 0);
+    output_bytes(&out, header, wav_header_size(clip.num_samples, 0));
+
+    for (left = clip.num_samples; left > 0; ) {
+        uint32_t count = left < 16*432 ? left : 16*432;
+
+        utk_decode_s16(ctx, pcm, count);
+        output_s16(&out, pcm, count);
+        left -= count;
+    }
+
+    close_output(&out);
+    free(ctx);
+}
+
+/*
+** Benchmark.
+*/
+
+static double now(void)
+{
+    return (double)clock() / CLOCKS_PER_SEC;
+}
+
+/* A sum of the samples of a clip, to compare the two ways of decoding it. */
+static uint32_t decode_clip(UTKContext *ctx, uint32_t num_samples)
+{
+    int16_t pcm[432];
+    uint32_t sum = 0;
+
+    while (num_samples > 0) {
+        uint32_t count = num_samples < 432 ? num_samples : 432, i;
+
+        utk_decode_s16(ctx, pcm, count);
+        for (i = 0; i < count; i++)
+            sum = sum*31 + (uint16_t)pcm[i];
+        num_samples -= count;
+    }
+
+    return sum;
+}
+
+/* Look up (and decode, if decode is set) each clip in names, from the pack
+** or by opening its file. Returns the time per clip in microseconds. */
+static double time_lookups(const UTKPack *pack, UTKContext *ctx, const char **names,
+                           uint32_t n, int use_pack, int decode, uint32_t *sums)
+{
+    double start = now(), elapsed;
+    long runs = 0;
+    uint32_t i;
+
+    do {
+        for (i = 0; i < n; i++) {
+            if (use_pack) {
+                UTKPackClip clip;
+                int j = utk_pack_find(pack, names[i]);
+
+                check(j < 0 ? UTK_ERR_INVALID_ARG : utk_pack_get(pack, (uint32_t)j, &clip));
+                if (decode) {
+                    utk_pack_start(ctx, &clip);
+                    sums[i] = decode_clip(ctx, clip.num_samples);
+                }
+            } else {
+                InputFile in;
+                FILE *fp = fopen(names[i], "rb");
+                int ret;
+
+                if (!fp) {
+                    fprintf(stderr, "error: failed to open '%s': %s\n", names[i], strerror(errno));
+                    exit(EXIT_FAILURE);
+                }
+                ret = read_all(&in, fp);
+                fclose(fp);
+                if (ret != 0 || in.size < 32)
+                    fail("failed to read a clip");
+
+                if (decode) {
+                    utk_init(ctx);
+                    utk_set_ptr(ctx, in.data + 32, in.data + in.size);
+                    if (sums[i] != decode_clip(ctx, get_u32(in.data+4)/2)) {
+                        fprintf(stderr, "error: '%s' decodes differently from the pack\n",
+                                names[i]);
+                        exit(EXIT_FAILURE);
+                    }
+                }
+                free((void *)in.data);
+            }
+        }
+        runs++;
+        elapsed = now() - start;
+    } while (elapsed < BENCH_SECONDS);
+
+    return elapsed * 1e6 / ((double)runs * n);
+}
+
+/* Compare finding (and decoding) every clip of the pack, in random order,
+** with opening and reading each one's original file. */
+static void benchmark(const UTKPack *pack)
+{
+    const char **names;
+    uint32_t *sums;
+    UTKContext *ctx;
+    UTKPackClip clip;
+    uint32_t i, n = pack->num_clips, seed = 1;
+    double t[4];
+
+    names = malloc(n * sizeof(*names));
+    sums = malloc(n * sizeof(*sums));
+    ctx = malloc(sizeof(*ctx));
+    if (!names || !sums || !ctx)
+        fail("out of memory");
+
+    for (i = 0; i < n; i++) {
+        check(utk_pack_get(pack, i, &clip));
+        names[i] = clip.name;
+    }
+    for (i = n; i > 1; i--) {
+        const char *tmp;
+        uint32_t j;
+
+        seed = seed*1103515245 + 12345;
+        j = (seed >> 8) % i;
+        tmp = names[i-1], names[i-1] = names[j], names[j] = tmp;
+    }
+
+    /* an untimed run first, to warm up the caches and to fill in the sums
+    ** that the file runs check against */
+    time_lookups(pack, ctx, names, n, 1, 1, sums);
+    t[0] = time_lookups(pack, ctx, names, n, 1, 0, sums);
+    t[1] = time_lookups(pack, ctx, names, n, 1, 1, sums);
+    t[2] = time_lookups(pack, ctx, names, n, 0, 0, sums);
+    t[3] = time_lookups(pack, ctx, names, n, 0, 1, sums);
+
+    printf("%lu clips, time per clip (us):\n\n", (unsigned long)n);
+    printf("%-8s %12s %12s\n", "", "lookup", "+ decode");
+    printf("%-8s %12.2f %12.2f\n", "pack", t[0], t[1]);
+    printf("%-8s %12.2f %12.2f\n", "files", t[2], t[3]);
+
+    free(ctx);
+    free(sums);
+    free(names);
+}
+
+int main(int argc, char *argv[])
+{
+    const char *outfile = NULL;
+    InputFile in;
+    UTKPack pack;
+    int force = 0;
+    int i;
+
+    if (argc >= 3 && (!strcmp(argv[1], "-t") || !strcmp(argv[1], "-b")
+                      || (!strcmp(argv[1], "-x") && argc >= 5))) {
+        open_input(&in, argv[2]);
+        check(utk_pack_open(&pack, in.data, in.size));
+
+        if (argv[1][1] == 't')
+            list_pack(&pack);
+        else if (argv[1][1] == 'b')
+            benchmark(&pack);
+        else
+            extract_clip(&pack, argv[3], argv[4], argc > 5 && !strcmp(argv[5], "-f"));
+
+        close_input(&in);
+        return EXIT_SUCCESS;
+    }
+
+    /* Parse arguments. */
+    while (argc > 1 && argv[1][0] == '-' && argv[1][1] != '\0') {
+        if (!strcmp(argv[1], "-f")) {
+            force = 1;
+        } else if (!strcmp(argv[1], "-o") && argc > 2) {
+            outfile = argv[2];
+            argv++, argc--;
+        } else if (!strcmp(argv[1], "-l") && argc > 2) {
+            add_manifest(argv[2]);
+            argv++, argc--;
+        } else {
+            break;
+        }
+        argv++, argc--;
+    }
+
+    for (i = 1; i < argc; i++)
+        add_path(argv[i]);
+
+    if (!outfile || num_clips == 0 || (argc > 1 && argv[1][0] == '-')) {
+        printf("Usage: utkpack [-f] [-l list] -o outfile.utkp [file.utk...]\n");
+        printf("       utkpack -t pack.utkp\n");
+        printf("       utkpack -x pack.utkp name outfile.wav [-f]\n");
+        printf("       utkpack -b pack.utkp\n");
+        printf("Pack Maxis UTK files into one indexed file, where each clip is named by\n");
+        printf("its path as given; list the clips of a pack; extract one to a wav file;\n");
+        printf("or compare looking up and decoding every clip of a pack with opening its\n");
+        printf("original file.\n");
+        printf("  -f  overwrite existing files\n");
+        printf("  -l  also pack the files listed in list, one per line (- for stdin)\n");
+        return EXIT_FAILURE;
+    }
+
+    create_pack(outfile, force);
+
+    return EXIT_SUCCESS;
+}
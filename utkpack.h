@@ -0,0 +1,231 @@
+#ifndef UTKPACK_H
+#define UTKPACK_H
+
+#include <string.h>
+#include "utk.h"
+
+/* Many Maxis UTK clips in one file, looked up by name.
+**
+**     UTKPack pack;
+**     UTKPackClip clip;
+**     load_input(&in, "voices.utkp");  (io.h; maps the file)
+**     utk_pack_open(&pack, in.data, in.size);
+**     i = utk_pack_find(&pack, "vox/hello.utk");
+**     utk_pack_get(&pack, i, &clip);
+**     utk_pack_start(&utk, &clip);
+**     utk_decode_s16(&utk, out, clip.num_samples);
+**
+** The index is sorted by a 64-bit hash of the name (utk_pack_hash), so a
+** lookup is a binary search over the mapped file: it opens no file and
+** allocates nothing, and utk_pack_open only checks the header. Each clip is
+** decoded straight from the pack with utk_set_ptr.
+**
+** The 32-byte UTM0 header of each clip is reduced to its sample rate and
+** length. The 15-bit stream header at the start of its bitstream (the
+** bandwidth, the multi-pulse threshold and the fixed gain parameters) is
+** moved into its index entry too, and the rest of the bitstream is shifted
+** to start at a byte, so a clip's data starts with its first frame.
+**
+** Layout (all fields little-endian):
+**   0  'UTKP'
+**   4  u32 version (1)
+**   8  u32 number of clips
+**  12  u32 size of the name table
+**  16  index: an entry per clip, sorted by hash, then name:
+**        0  u64 hash of the name
+**        8  u64 offset of the clip's data, from the start of the file
+**       16  u32 size of the clip's data
+**       20  u32 number of samples
+**       24  u32 sample rate
+**       28  u32 offset of the name in the name table
+**       32  u16 stream header
+**       34  u16 reserved (0)
+**      then the name table (NUL-terminated names), then the clip data */
+
+#define UTK_PACK_HEADER_SIZE 16
+#define UTK_PACK_ENTRY_SIZE 36
+
+typedef struct UTKPack {
+    const uint8_t *data;
+    size_t size;
+    uint32_t num_clips;
+    const uint8_t *index;
+    const char *names;
+    uint32_t names_size;
+} UTKPack;
+
+typedef struct UTKPackClip {
+    const char *name;
+    const uint8_t *ptr, *end; /* the bitstream, after the stream header */
+    uint32_t num_samples;
+    uint32_t sample_rate;
+    int header;               /* for utk_set_header */
+} UTKPackClip;
+
+static uint32_t utk_pack_get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static uint64_t utk_pack_get_u64(const uint8_t *p)
+{
+    return utk_pack_get_u32(p) | (uint64_t)utk_pack_get_u32(p + 4) << 32;
+}
+
+static void utk_pack_put_u32(uint8_t *p, uint32_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x>>8);
+    p[2] = (uint8_t)(x>>16);
+    p[3] = (uint8_t)(x>>24);
+}
+
+static void utk_pack_put_u64(uint8_t *p, uint64_t x)
+{
+    utk_pack_put_u32(p, (uint32_t)x);
+    utk_pack_put_u32(p + 4, (uint32_t)(x>>32));
+}
+
+/* The name of entry i, or NULL if it is not in the name table. */
+static const char *utk_pack_name(const UTKPack *pack, uint32_t i)
+{
+    uint32_t offset = utk_pack_get_u32(pack->index + (size_t)i*UTK_PACK_ENTRY_SIZE + 28);
+
+    if (offset >= pack->names_size)
+        return NULL;
+
+    return pack->names + offset;
+}
+
+/*
+** Public functions.
+*/
+
+/* The 64-bit FNV-1a hash of a name. */
+static uint64_t utk_pack_hash(const char *name)
+{
+    uint64_t hash = (uint64_t)0xcbf29ce4 << 32 | 0x84222325;
+
+    while (*name) {
+        hash ^= (uint8_t)*name++;
+        hash *= (uint64_t)0x100 << 32 | 0x1b3;
+    }
+
+    return hash;
+}
+
+/* Open the pack in [data, data+size), which must stay valid while it is
+** used. Only the header is checked here; each clip is checked by
+** utk_pack_get. */
+static int utk_pack_open(UTKPack *pack, const void *data, size_t size)
+{
+    const uint8_t *p = data;
+    uint64_t index_end;
+
+    memset(pack, 0, sizeof(*pack));
+
+    if (size < UTK_PACK_HEADER_SIZE || memcmp(p, "UTKP", 4) != 0)
+        return UTK_ERR_BAD_SIGNATURE;
+    if (utk_pack_get_u32(p + 4) != 1)
+        return UTK_ERR_UNSUPPORTED;
+
+    pack->num_clips = utk_pack_get_u32(p + 8);
+    pack->names_size = utk_pack_get_u32(p + 12);
+
+    index_end = UTK_PACK_HEADER_SIZE + (uint64_t)pack->num_clips*UTK_PACK_ENTRY_SIZE;
+    if (pack->num_clips > 0x7fffffff || index_end + pack->names_size > size
+        || (pack->names_size > 0 && p[index_end + pack->names_size - 1] != '\0')) {
+        memset(pack, 0, sizeof(*pack));
+        return UTK_ERR_BAD_HEADER;
+    }
+
+    pack->data = p;
+    pack->size = size;
+    pack->index = p + UTK_PACK_HEADER_SIZE;
+    pack->names = (const char *)p + index_end;
+
+    return UTK_OK;
+}
+
+/* The index of the first clip with the given hash, or -1. */
+static int utk_pack_find_hash(const UTKPack *pack, uint64_t hash)
+{
+    uint32_t lo = 0, hi = pack->num_clips;
+
+    /* the first entry with a hash >= hash */
+    while (lo < hi) {
+        uint32_t mid = lo + (hi - lo)/2;
+
+        if (utk_pack_get_u64(pack->index + (size_t)mid*UTK_PACK_ENTRY_SIZE) < hash)
+            lo = mid + 1;
+        else
+            hi = mid;
+    }
+
+    if (lo == pack->num_clips || utk_pack_get_u64(pack->index + (size_t)lo*UTK_PACK_ENTRY_SIZE) != hash)
+        return -1;
+
+    return (int)lo;
+}
+
+/* The index of the clip with the given name, or -1. */
+static int utk_pack_find(const UTKPack *pack, const char *name)
+{
+    uint64_t hash = utk_pack_hash(name);
+    int i = utk_pack_find_hash(pack, hash);
+
+    if (i < 0)
+        return -1;
+
+    /* names that share a hash are next to each other */
+    for (; (uint32_t)i < pack->num_clips
+           && utk_pack_get_u64(pack->index + (size_t)i*UTK_PACK_ENTRY_SIZE) == hash; i++) {
+        const char *s = utk_pack_name(pack, (uint32_t)i);
+
+        if (s && !strcmp(s, name))
+            return i;
+    }
+
+    return -1;
+}
+
+/* Get clip i. Returns UTK_OK, UTK_ERR_INVALID_ARG if there is no clip i, or
+** UTK_ERR_BAD_HEADER if its entry points outside the pack. */
+static int utk_pack_get(const UTKPack *pack, uint32_t i, UTKPackClip *clip)
+{
+    const uint8_t *entry;
+    uint64_t offset;
+    uint32_t size;
+
+    memset(clip, 0, sizeof(*clip));
+
+    if (i >= pack->num_clips)
+        return UTK_ERR_INVALID_ARG;
+
+    entry = pack->index + (size_t)i*UTK_PACK_ENTRY_SIZE;
+    offset = utk_pack_get_u64(entry + 8);
+    size = utk_pack_get_u32(entry + 16);
+    clip->name = utk_pack_name(pack, i);
+
+    if (!clip->name || offset > pack->size || size > pack->size - offset)
+        return UTK_ERR_BAD_HEADER;
+
+    clip->ptr = pack->data + (size_t)offset;
+    clip->end = clip->ptr + size;
+    clip->num_samples = utk_pack_get_u32(entry + 20);
+    clip->sample_rate = utk_pack_get_u32(entry + 24);
+    clip->header = entry[32] | (entry[33] << 8);
+
+    return UTK_OK;
+}
+
+/* Set up ctx to decode a clip from its first sample. */
+static void utk_pack_start(UTKContext *ctx, const UTKPackClip *clip)
+{
+    utk_init(ctx);
+    utk_set_ptr(ctx, clip->ptr, clip->end);
+    utk_set_header(ctx, clip->header);
+    ctx->parsed_header = 1;
+}
+
+#endif
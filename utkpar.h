@@ -0,0 +1,173 @@
+#ifndef UTKPAR_H
+#define UTKPAR_H
+
+#include <stdlib.h>
+#include "utk.h"
+#include "utkscan.h"
+
+/* Approximate parallel decoding of one long MicroTalk bitstream.
+**
+** Every frame depends on the decoder state left by the previous one (rc,
+** synth_history and the adaptive codebook), so a stream normally decodes on
+** one thread. But that state is short: the adaptive codebook holds the last
+** 324 samples of excitation and the synthesis filter is stable, so a decoder
+** started from a cleared state part way into a stream soon produces (almost)
+** the same samples as one that decoded everything before.
+**
+** utk_par_plan splits a stream into segments at frame boundaries, which it
+** finds with a parse-only scan (utkscan.h). Each segment can then be decoded
+** on its own thread: utk_par_start starts `warmup` frames before the segment
+** and drops their output. The first segment is exact; the others are not.
+** On the sample files, the samples differ by at most 2 or 3 LSB after
+** UTK_PAR_DEFAULT_WARMUP frames, but they need not converge exactly, since
+** tiny differences can keep circulating through the adaptive codebook.
+** `utkbench -w` measures the difference for several numbers of warm-up
+** frames. (For exact random access, see utkseek.h.)
+**
+** Like utkseek.h, this covers one contiguous bitstream decoded with
+** utk_set_ptr (Maxis UTK after the 32-byte header, or PT after the PT
+** header). */
+
+#define UTK_PAR_DEFAULT_WARMUP 12
+
+typedef struct UTKParSegment {
+    uint32_t first_frame; /* the first frame of output */
+    uint32_t num_frames;
+    uint32_t start_frame; /* the first frame decoded, including the warm-up */
+    uint64_t bit_offset;  /* of start_frame, from the start of the bitstream */
+} UTKParSegment;
+
+typedef struct UTKParPlan {
+    uint32_t num_samples;
+    uint32_t num_frames;
+    uint32_t num_segments;
+    UTKParSegment *segments;
+} UTKParPlan;
+
+/*
+** Public functions.
+*/
+
+static void utk_par_free(UTKParPlan *plan)
+{
+    free(plan->segments);
+    memset(plan, 0, sizeof(*plan));
+}
+
+/* Split the num_samples-sample bitstream in [ptr, end) into num_segments
+** segments of (about) the same number of frames, or one per frame if there
+** are fewer frames, each to be decoded from warmup frames before it. */
+static int utk_par_plan(UTKParPlan *plan, const uint8_t *ptr, const uint8_t *end,
+                        uint32_t num_samples, uint32_t num_segments, uint32_t warmup)
+{
+    UTKContext *ctx;
+    UTKFrameInfo info;
+    uint32_t i, frame;
+
+    memset(plan, 0, sizeof(*plan));
+
+    if (num_segments == 0 || ptr > end)
+        return UTK_ERR_INVALID_ARG;
+
+    plan->num_samples = num_samples;
+    plan->num_frames = (num_samples + 431) / 432;
+    if (num_segments > plan->num_frames)
+        num_segments = plan->num_frames ? plan->num_frames : 1;
+    plan->num_segments = num_segments;
+
+    /* (too big for the stack on some platforms) */
+    ctx = malloc(sizeof(*ctx));
+    plan->segments = malloc(num_segments * sizeof(*plan->segments));
+    if (!ctx || !plan->segments) {
+        free(ctx);
+        utk_par_free(plan);
+        return UTK_ERR_NOMEM;
+    }
+
+    for (i = 0; i < num_segments; i++) {
+        UTKParSegment *seg = &plan->segments[i];
+        uint32_t size = plan->num_frames / num_segments;
+        uint32_t extra = plan->num_frames % num_segments;
+
+        /* the first num_frames % num_segments segments get a frame more */
+        seg->first_frame = i*size + (i < extra ? i : extra);
+        seg->num_frames = size + (i < extra);
+        seg->start_frame = seg->first_frame > warmup ? seg->first_frame - warmup : 0;
+    }
+
+    /* parse the header up front, so that every offset is at a frame */
+    utk_init(ctx);
+    utk_set_ptr(ctx, ptr, end);
+    utk_refill_bits(ctx);
+    utk_parse_header(ctx);
+    ctx->parsed_header = 1;
+
+    /* Scan up to the start of the last segment. A truncated frame reads as
+    ** zeros, here as in the decoder, so the offsets after it still match. */
+    for (i = 0, frame = 0; i < num_segments; frame++) {
+        while (i < num_segments && plan->segments[i].start_frame == frame)
+            plan->segments[i++].bit_offset = utk_tell(ctx, ptr);
+
+        if (i < num_segments)
+            utk_scan_frame(ctx, ptr, &info);
+    }
+
+    free(ctx);
+
+    return UTK_OK;
+}
+
+/* Set up ctx to decode segment i of the bitstream in [ptr, end): decode
+** its warm-up frames, so that the next call to utk_decode_frame decodes
+** frame segments[i].first_frame. */
+static void utk_par_start(UTKContext *ctx, const UTKParPlan *plan, uint32_t i,
+                          const uint8_t *ptr, const uint8_t *end)
+{
+    const UTKParSegment *seg = &plan->segments[i];
+    uint32_t frame;
+
+    utk_init(ctx);
+    utk_set_ptr(ctx, ptr, end);
+
+    if (plan->num_frames == 0)
+        return;
+
+    /* the header is needed by every frame */
+    utk_refill_bits(ctx);
+    utk_parse_header(ctx);
+    ctx->parsed_header = 1;
+
+    utk_set_bit_ptr(ctx, ptr, end, seg->bit_offset);
+
+    for (frame = seg->start_frame; frame < seg->first_frame; frame++)
+        utk_decode_frame(ctx);
+}
+
+/* The number of samples of segment i (the last frame may be partial). */
+static uint32_t utk_par_length(const UTKParPlan *plan, uint32_t i)
+{
+    uint32_t first = plan->segments[i].first_frame * 432;
+    uint32_t count = plan->segments[i].num_frames * 432;
+
+    return count < plan->num_samples - first ? count : plan->num_samples - first;
+}
+
+/* Decode segment i into its place in out, which holds all num_samples
+** samples of the stream, as int16 samples like utk_decode_s16. */
+static void utk_par_decode_s16(UTKContext *ctx, const UTKParPlan *plan, uint32_t i,
+                               const uint8_t *ptr, const uint8_t *end, int16_t *out)
+{
+    utk_par_start(ctx, plan, i, ptr, end);
+    utk_decode_s16(ctx, &out[plan->segments[i].first_frame * 432], utk_par_length(plan, i));
+}
+
+/* Same as utk_par_decode_s16, but output float samples like
+** utk_decode_f32. */
+static void utk_par_decode_f32(UTKContext *ctx, const UTKParPlan *plan, uint32_t i,
+                               const uint8_t *ptr, const uint8_t *end, float *out)
+{
+    utk_par_start(ctx, plan, i, ptr, end);
+    utk_decode_f32(ctx, &out[plan->segments[i].first_frame * 432], utk_par_length(plan, i));
+}
+
+#endif
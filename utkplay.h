@@ -0,0 +1,273 @@
+#ifndef UTKPLAY_H
+#define UTKPLAY_H
+
+#include <stdlib.h>
+#include "utk.h"
+
+#ifndef UTK_NO_THREADS
+#include <pthread.h>
+#include <time.h>
+#endif
+
+/* Playback: pull any number of samples from an audio callback.
+**
+**     UTKContext utk;
+**     UTKPlayer player;
+**     utk_init(&utk);
+**     utk_set_fp(&utk, fp, &file);  (after the file header; or utk_set_ptr)
+**     utk_player_init(&player, &utk, num_samples, sample_rate, 4096);
+**     ...
+**     callback: utk_player_read_f32(&player, out, n);
+**     ...
+**     utk_player_free(&player);
+**
+** A background thread decodes ahead, frame by frame, into a ring of samples
+** and keeps it `prefetch` samples full. The callback thread only copies out
+** of the ring: utk_player_read_s16/f32 never decode, read the file, lock or
+** wait, so they are safe to call from a real-time audio thread. If the ring
+** runs dry before the end of the stream, the missing samples are output as
+** silence and counted as an underrun (utk_player_underruns); a larger
+** prefetch trades latency for fewer underruns.
+**
+** The ring has one writer (the decode thread) and one reader (the callback
+** thread), so it needs no lock: each side owns one of the two positions and
+** publishes it with a release store, which the other side reads with an
+** acquire load.
+**
+** The stream is whatever the UTKContext has been set up to decode, e.g. a
+** Maxis UTK or PT file through utk_set_fp (in which case only the decode
+** thread ever calls fread) or a bitstream in memory through utk_set_ptr.
+** While the player runs, the context belongs to the decode thread.
+**
+** The decode thread needs pthreads; the including file should define
+** _POSIX_C_SOURCE 200112L first. With -DUTK_NO_THREADS, there is no thread:
+** call utk_player_fill regularly from any thread but the callback thread
+** (e.g. the main loop) instead. */
+
+#if defined(__GNUC__)
+#define UTK_LOAD_ACQUIRE(p) __atomic_load_n((p), __ATOMIC_ACQUIRE)
+#define UTK_STORE_RELEASE(p, v) __atomic_store_n((p), (v), __ATOMIC_RELEASE)
+#else
+/* MSVC gives volatile accesses acquire and release semantics (/volatile:ms,
+** the default on x86 and x64) */
+#define UTK_LOAD_ACQUIRE(p) (*(volatile uint32_t *)(p))
+#define UTK_STORE_RELEASE(p, v) (*(volatile uint32_t *)(p) = (v))
+#endif
+
+typedef struct UTKPlayer {
+    /* written by the decode thread */
+    uint32_t write_pos;     /* samples written to the ring, ever */
+    uint32_t finished;      /* all num_samples samples have been written */
+    uint32_t pad0[14];      /* (keep the two sides on separate cache lines) */
+    /* written by the callback thread */
+    uint32_t read_pos;      /* samples read from the ring, ever */
+    uint32_t underruns;     /* reads that came up short */
+    uint32_t underrun_samples;
+    uint32_t pad1[13];
+    uint32_t stop;          /* set by utk_player_free */
+    /* constant while the player runs */
+    UTKContext *utk;
+    uint32_t samples_left;  /* not yet decoded (decode thread) */
+    uint32_t prefetch;
+    uint32_t mask;          /* ring size - 1 */
+    uint32_t poll_ns;       /* how long the decode thread sleeps when full */
+    float *ring;            /* in the units of utk->decompressed_frame */
+#ifndef UTK_NO_THREADS
+    pthread_t thread;
+    int thread_started;
+#endif
+} UTKPlayer;
+
+/* Decode frames while the ring holds less than prefetch samples, or until
+** the end of the stream. Returns the number of frames decoded. */
+static int utk_player_fill(UTKPlayer *p)
+{
+    uint32_t write_pos = p->write_pos;
+    int frames = 0;
+
+    while (p->samples_left > 0
+           && write_pos - UTK_LOAD_ACQUIRE(&p->read_pos) < p->prefetch
+           && !UTK_LOAD_ACQUIRE(&p->stop)) {
+        uint32_t n = p->samples_left < 432 ? p->samples_left : 432;
+        uint32_t offset = write_pos & p->mask;
+        uint32_t first = n < p->mask + 1 - offset ? n : p->mask + 1 - offset;
+
+        utk_decode_frame(p->utk);
+
+        /* the ring holds prefetch + 432 samples, so there is room */
+        memcpy(&p->ring[offset], p->utk->decompressed_frame, first * sizeof(float));
+        memcpy(p->ring, &p->utk->decompressed_frame[first], (n - first) * sizeof(float));
+
+        write_pos += n;
+        p->samples_left -= n;
+        UTK_STORE_RELEASE(&p->write_pos, write_pos);
+        frames++;
+    }
+
+    if (p->samples_left == 0)
+        UTK_STORE_RELEASE(&p->finished, 1);
+
+    return frames;
+}
+
+#ifndef UTK_NO_THREADS
+static void *utk_player_thread(void *arg)
+{
+    UTKPlayer *p = arg;
+    struct timespec poll;
+
+    poll.tv_sec = 0;
+    poll.tv_nsec = p->poll_ns;
+
+    while (!UTK_LOAD_ACQUIRE(&p->finished) && !UTK_LOAD_ACQUIRE(&p->stop)) {
+        if (utk_player_fill(p) == 0)
+            nanosleep(&poll, NULL);
+    }
+
+    return NULL;
+}
+#endif
+
+/* Take up to n samples out of the ring into dst (through convert), and pad
+** the rest with silence. Returns the number of samples of the stream. */
+static uint32_t utk_player_take(UTKPlayer *p, void *dst, size_t size, uint32_t n,
+                                void (*convert)(void *out, const float *in, int n))
+{
+    uint32_t read_pos = p->read_pos;
+    uint32_t finished = UTK_LOAD_ACQUIRE(&p->finished);
+    uint32_t avail = UTK_LOAD_ACQUIRE(&p->write_pos) - read_pos;
+    uint32_t count = n < avail ? n : avail;
+    uint32_t offset = read_pos & p->mask;
+    uint32_t first = count < p->mask + 1 - offset ? count : p->mask + 1 - offset;
+    char *out = dst;
+
+    convert(out, &p->ring[offset], (int)first);
+    convert(out + first*size, p->ring, (int)(count - first));
+    memset(out + count*size, 0, (n - count) * size);
+
+    UTK_STORE_RELEASE(&p->read_pos, read_pos + count);
+
+    /* the end of the stream is not an underrun */
+    if (count < n && !finished) {
+        UTK_STORE_RELEASE(&p->underruns, p->underruns + 1);
+        UTK_STORE_RELEASE(&p->underrun_samples, p->underrun_samples + (n - count));
+    }
+
+    return count;
+}
+
+static void utk_player_convert_s16(void *out, const float *in, int n)
+{
+    utk_convert_s16(out, in, n);
+}
+
+static void utk_player_convert_f32(void *out, const float *in, int n)
+{
+    utk_convert_f32(out, in, n);
+}
+
+/*
+** Public functions.
+*/
+
+/* Start playing num_samples samples of the stream set up in utk, at
+** sample_rate, with prefetch samples decoded ahead. Returns UTK_OK,
+** UTK_ERR_INVALID_ARG, or UTK_ERR_NOMEM (also if the thread cannot be
+** created). */
+static int utk_player_init(UTKPlayer *p, UTKContext *utk, uint32_t num_samples,
+                           uint32_t sample_rate, uint32_t prefetch)
+{
+    uint32_t size = 1024;
+    double poll;
+
+    memset(p, 0, sizeof(*p));
+
+    if (sample_rate == 0 || prefetch == 0 || prefetch > 0x1000000)
+        return UTK_ERR_INVALID_ARG;
+
+    while (size < prefetch + 432)
+        size *= 2;
+
+    p->ring = malloc(size * sizeof(float));
+    if (!p->ring)
+        return UTK_ERR_NOMEM;
+
+    p->utk = utk;
+    p->samples_left = num_samples;
+    p->prefetch = prefetch;
+    p->mask = size - 1;
+
+    /* wake up about 4 times per prefetch */
+    poll = 1e9 * prefetch / 4 / sample_rate;
+    p->poll_ns = poll < 100000 ? 100000 : poll < 999999999 ? (uint32_t)poll : 999999999;
+
+    /* fill the ring before the first read */
+    utk_player_fill(p);
+
+#ifndef UTK_NO_THREADS
+    if (pthread_create(&p->thread, NULL, utk_player_thread, p) != 0) {
+        free(p->ring);
+        p->ring = NULL;
+        return UTK_ERR_NOMEM;
+    }
+    p->thread_started = 1;
+#endif
+
+    return UTK_OK;
+}
+
+/* Stop the decode thread and free the ring. */
+static void utk_player_free(UTKPlayer *p)
+{
+    UTK_STORE_RELEASE(&p->stop, 1);
+#ifndef UTK_NO_THREADS
+    if (p->thread_started)
+        pthread_join(p->thread, NULL);
+    p->thread_started = 0;
+#endif
+    free(p->ring);
+    p->ring = NULL;
+}
+
+/* Output the next n samples as int16 samples, like utk_decode_s16. Never
+** blocks. Returns the number of samples of the stream output, which is less
+** than n only after an underrun or at the end of the stream; the rest of out
+** is filled with silence. */
+static uint32_t utk_player_read_s16(UTKPlayer *p, int16_t *out, uint32_t n)
+{
+    return utk_player_take(p, out, sizeof(*out), n, utk_player_convert_s16);
+}
+
+/* Same as utk_player_read_s16, but output float samples like
+** utk_decode_f32. */
+static uint32_t utk_player_read_f32(UTKPlayer *p, float *out, uint32_t n)
+{
+    return utk_player_take(p, out, sizeof(*out), n, utk_player_convert_f32);
+}
+
+/* Whether every sample of the stream has been read. */
+static int utk_player_done(UTKPlayer *p)
+{
+    return UTK_LOAD_ACQUIRE(&p->finished)
+        && UTK_LOAD_ACQUIRE(&p->write_pos) == UTK_LOAD_ACQUIRE(&p->read_pos);
+}
+
+/* The samples decoded ahead, ready to be read. */
+static uint32_t utk_player_buffered(UTKPlayer *p)
+{
+    return UTK_LOAD_ACQUIRE(&p->write_pos) - UTK_LOAD_ACQUIRE(&p->read_pos);
+}
+
+/* The number of reads that came up short, and the samples they were short
+** of. Any thread may call these. */
+static uint32_t utk_player_underruns(UTKPlayer *p)
+{
+    return UTK_LOAD_ACQUIRE(&p->underruns);
+}
+
+static uint32_t utk_player_underrun_samples(UTKPlayer *p)
+{
+    return UTK_LOAD_ACQUIRE(&p->underrun_samples);
+}
+
+#endif
@@ -0,0 +1,499 @@
+/*
+** utkprobe
+** Check and catalogue MicroTalk files (Maxis UTK, PT/M10 and SCxl) without
+** decoding them.
+** Authors: Andrew D'Addesio
+** License: Public domain
+** Compile: gcc -Wall -Wextra -Wno-unused-function -ansi -pedantic -O2 -ffast-math
+**          -fwhole-program -g0 -s -pthread -o utkprobe utkprobe.c
+**          (POSIX only: uses pthreads and dirent.h)
+*/
+#define _POSIX_C_SOURCE 200112L /* for mmap in io.h, pthreads and dirent.h */
+#include <stdint.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <time.h>
+#include <pthread.h>
+#include <dirent.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include "utk.h"
+#include "utkscan.h"
+#include "io.h"
+#include "eachunk.h"
+
+#define MAKE_U32(a,b,c,d) ((a)|((b)<<8)|((c)<<16)|((uint32_t)(d)<<24))
+#define MIN(x,y) ((x)<(y)?(x):(y))
+
+#define MAX_JOBS 64
+
+typedef struct ProbeResult {
+    const char *path;
+    int from_dir;      /* found by walking a directory */
+    int done;
+    int skipped;       /* from_dir and not a MicroTalk file */
+    int io_error;      /* errno value */
+    int error;         /* UTK_* error code */
+    uint32_t error_frame;
+    uint64_t error_bit;
+
+    size_t file_size;
+    char container[16];
+    uint32_t sample_rate;
+    uint32_t num_samples;
+    int reduced_bw;
+    int multipulse_thresh;
+
+    uint32_t num_frames;
+    uint32_t multipulse_frames;
+    uint32_t min_bits, max_bits;
+    uint64_t total_bits;
+
+    /* every frame, with -v */
+    UTKFrameInfo *frames;
+} ProbeResult;
+
+typedef struct Probe {
+    const uint8_t *start, *ptr, *end;
+    UTKContext utk;
+    ProbeResult *r;
+    int verbose;
+} Probe;
+
+static ProbeResult *results;
+static size_t num_results;
+static size_t next_result;
+static int verbose;
+static pthread_mutex_t lock = PTHREAD_MUTEX_INITIALIZER;
+static pthread_cond_t result_done = PTHREAD_COND_INITIALIZER;
+
+static void fail(const char *what)
+{
+    fprintf(stderr, "error: %s\n", what);
+    exit(EXIT_FAILURE);
+}
+
+/*
+** Scanning.
+*/
+
+/* Scan count frames of the current bitstream. */
+static int scan_frames(Probe *p, uint32_t count, int rev3)
+{
+    ProbeResult *r = p->r;
+    uint32_t i;
+
+    if (p->verbose && count > 0) {
+        UTKFrameInfo *frames = realloc(r->frames, (r->num_frames + count) * sizeof(*frames));
+        if (!frames)
+            return UTK_ERR_NOMEM;
+        r->frames = frames;
+    }
+
+    for (i = 0; i < count; i++) {
+        UTKFrameInfo info;
+        int ret;
+
+        if (rev3)
+            ret = utk_rev3_scan_frame(&p->utk, p->start, &info);
+        else
+            ret = utk_scan_frame(&p->utk, p->start, &info);
+
+        if (p->verbose)
+            r->frames[r->num_frames] = info;
+
+        if (ret != UTK_OK) {
+            r->error_frame = r->num_frames;
+            r->error_bit = info.bit_offset;
+            r->num_frames++;
+            return ret;
+        }
+
+        r->num_frames++;
+        r->multipulse_frames += info.use_multipulse;
+        r->total_bits += info.num_bits;
+        if (r->num_frames == 1 || info.num_bits < r->min_bits)
+            r->min_bits = info.num_bits;
+        if (info.num_bits > r->max_bits)
+            r->max_bits = info.num_bits;
+    }
+
+    r->reduced_bw = p->utk.reduced_bw;
+    r->multipulse_thresh = p->utk.multipulse_thresh;
+
+    return UTK_OK;
+}
+
+static int scan_utm0(Probe *p)
+{
+    ProbeResult *r = p->r;
+    uint32_t dwOutSize;
+
+    if (p->end - p->start < 32)
+        return UTK_ERR_EOF;
+
+    dwOutSize = get_u32(p->start+4);
+    if ((dwOutSize & 0x01) != 0
+        || get_u32(p->start+8) != 20 || get_u16(p->start+12) != 1)
+        return UTK_ERR_BAD_HEADER;
+
+    strcpy(r->container, "UTM0");
+    r->sample_rate = get_u32(p->start+16);
+    r->num_samples = dwOutSize/2;
+
+    if (get_u16(p->start+14) != 1 || r->sample_rate < 8000 || r->sample_rate > 192000)
+        return UTK_ERR_UNSUPPORTED;
+
+    utk_set_ptr(&p->utk, p->start + 32, p->end);
+
+    return scan_frames(p, (r->num_samples + 431) / 432, 0);
+}
+
+static int scan_pt(Probe *p)
+{
+    ProbeResult *r = p->r;
+    EAStream s;
+    int ret;
+
+    ret = ea_open_pt(&s, p->ptr, (size_t)(p->end - p->ptr));
+
+    if (s.parsed_header) {
+        strcpy(r->container, "PT");
+        r->sample_rate = 22050;
+        r->num_samples = s.hdr.num_samples;
+    }
+
+    if (ret != UTK_OK)
+        return ret;
+
+    utk_set_ptr(&p->utk, s.next, s.end);
+
+    return scan_frames(p, (r->num_samples + 431) / 432, 0);
+}
+
+static int scan_scxl(Probe *p)
+{
+    ProbeResult *r = p->r;
+    EAStream s;
+    EADataChunk chunk;
+    int ret;
+
+    ret = ea_open_scxl(&s, p->ptr, (size_t)(p->end - p->ptr));
+
+    if (s.parsed_header) {
+        sprintf(r->container, "SCxl rev %u", (unsigned)MIN(s.hdr.codec_revision, 99));
+        r->sample_rate = 22050;
+        r->num_samples = s.hdr.num_samples;
+    }
+
+    if (ret != UTK_OK)
+        return ret;
+
+    while ((ret = ea_next_data_chunk(&s, &chunk)) == UTK_OK) {
+        utk_set_ptr(&p->utk, chunk.ptr, chunk.end);
+        ret = scan_frames(p, (chunk.num_samples + 431) / 432, s.hdr.codec_revision >= 3);
+        if (ret != UTK_OK)
+            return ret;
+    }
+
+    if (ret != UTK_ERR_EOF || s.chunks_left != 0)
+        return ret;
+
+    return ea_read_scel(&s);
+}
+
+static void probe_file(Probe *p, ProbeResult *r)
+{
+    InputFile in;
+    uint32_t sig;
+    int ret;
+
+    r->io_error = load_input(&in, r->path);
+    if (r->io_error)
+        return;
+
+    r->file_size = in.size;
+    p->start = p->ptr = in.data;
+    p->end = in.data + in.size;
+    p->r = r;
+    p->verbose = verbose;
+    utk_init(&p->utk);
+
+    sig = in.size >= 4 ? get_u32(in.data) : 0;
+    if (sig == MAKE_U32('U','T','M','0'))
+        ret = scan_utm0(p);
+    else if (sig == MAKE_U32('S','C','H','l'))
+        ret = scan_scxl(p);
+    else if ((sig & 0xffff) == MAKE_U32('P','T','\x00','\x00'))
+        ret = scan_pt(p);
+    else
+        ret = UTK_ERR_BAD_SIGNATURE;
+
+    /* quietly skip other files found in directories */
+    if (ret == UTK_ERR_BAD_SIGNATURE && r->from_dir) {
+        r->skipped = 1;
+        ret = UTK_OK;
+    }
+
+    r->error = ret;
+
+    close_input(&in);
+}
+
+static void *worker(void *arg)
+{
+    Probe *p = malloc(sizeof(*p));
+
+    (void)arg;
+    if (!p)
+        fail("out of memory");
+
+    for (;;) {
+        ProbeResult *r;
+
+        pthread_mutex_lock(&lock);
+        if (next_result == num_results) {
+            pthread_mutex_unlock(&lock);
+            break;
+        }
+        r = &results[next_result++];
+        pthread_mutex_unlock(&lock);
+
+        probe_file(p, r);
+
+        pthread_mutex_lock(&lock);
+        r->done = 1;
+        pthread_cond_broadcast(&result_done);
+        pthread_mutex_unlock(&lock);
+    }
+
+    free(p);
+
+    return NULL;
+}
+
+/*
+** Reporting.
+*/
+
+/* Print a result. Returns 1 if the file has an error. */
+static int print_result(const ProbeResult *r)
+{
+    uint32_t i;
+
+    if (r->skipped)
+        return 0;
+
+    printf("%s: ", r->path);
+
+    if (r->io_error) {
+        printf("error: %s\n", strerror(r->io_error));
+        return 1;
+    }
+
+    if (r->container[0]) {
+        printf("%s, %lu Hz, %lu samples, %lu frames (%lu multipulse)",
+               r->container, (unsigned long)r->sample_rate, (unsigned long)r->num_samples,
+               (unsigned long)r->num_frames, (unsigned long)r->multipulse_frames);
+
+        if (r->num_frames > 0 && r->error == UTK_OK)
+            printf(", %.1f kbit/s, %lu-%lu bits/frame%s",
+                   (double)r->total_bits * r->sample_rate / ((double)r->num_frames*432) / 1000,
+                   (unsigned long)r->min_bits, (unsigned long)r->max_bits,
+                   r->reduced_bw ? ", reduced bandwidth" : "");
+        printf(", ");
+    }
+
+    if (r->error == UTK_OK)
+        printf("ok\n");
+    else if (r->num_frames > 0)
+        printf("error: %s at frame %lu (bit %lu)\n", utk_error_string(r->error),
+               (unsigned long)r->error_frame, (unsigned long)r->error_bit);
+    else
+        printf("error: %s\n", utk_error_string(r->error));
+
+    for (i = 0; r->frames && i < r->num_frames; i++) {
+        const UTKFrameInfo *f = &r->frames[i];
+
+        printf("  frame %lu: bit %lu, %lu bits, %s, subframes %d %d %d %d",
+               (unsigned long)i, (unsigned long)f->bit_offset, (unsigned long)f->num_bits,
+               f->use_multipulse ? "multipulse" : "RELP",
+               f->subframe_bits[0], f->subframe_bits[1],
+               f->subframe_bits[2], f->subframe_bits[3]);
+        if (f->pcm_samples)
+            printf(", %d PCM samples", f->pcm_samples);
+        printf("%s\n", f->truncated ? ", truncated" : "");
+    }
+
+    return r->error != UTK_OK;
+}
+
+/*
+** File list.
+*/
+
+static void add_path(const char *path, int from_dir)
+{
+    static size_t capacity;
+    char *copy;
+
+    if (num_results == capacity) {
+        ProbeResult *p;
+
+        capacity = capacity ? 2*capacity : 256;
+        p = realloc(results, capacity * sizeof(*results));
+        if (!p)
+            fail("out of memory");
+        results = p;
+    }
+
+    copy = malloc(strlen(path) + 1);
+    if (!copy)
+        fail("out of memory");
+    strcpy(copy, path);
+
+    memset(&results[num_results], 0, sizeof(*results));
+    results[num_results].path = copy;
+    results[num_results].from_dir = from_dir;
+    num_results++;
+}
+
+static int compare_results(const void *a, const void *b)
+{
+    return strcmp(((const ProbeResult *)a)->path, ((const ProbeResult *)b)->path);
+}
+
+/* Add every regular file under dir. Symlinks to directories are not
+** followed. */
+static void add_dir(const char *dir)
+{
+    DIR *d = opendir(dir);
+    struct dirent *e;
+
+    if (!d) {
+        fprintf(stderr, "error: failed to open directory '%s': %s\n", dir, strerror(errno));
+        exit(EXIT_FAILURE);
+    }
+
+    while ((e = readdir(d)) != NULL) {
+        struct stat st;
+        char *path;
+
+        if (!strcmp(e->d_name, ".") || !strcmp(e->d_name, ".."))
+            continue;
+
+        path = malloc(strlen(dir) + strlen(e->d_name) + 2);
+        if (!path)
+            fail("out of memory");
+        sprintf(path, "%s/%s", dir, e->d_name);
+
+        if (lstat(path, &st) == 0) {
+            if (S_ISDIR(st.st_mode))
+                add_dir(path);
+            else if (S_ISREG(st.st_mode) || (S_ISLNK(st.st_mode)
+                     && stat(path, &st) == 0 && S_ISREG(st.st_mode)))
+                add_path(path, 1);
+        }
+
+        free(path);
+    }
+
+    closedir(d);
+}
+
+int main(int argc, char *argv[])
+{
+    pthread_t threads[MAX_JOBS];
+    struct timespec t0, t1;
+    long num_jobs = sysconf(_SC_NPROCESSORS_ONLN);
+    size_t i, num_errors = 0, num_files = 0;
+    double bytes = 0, seconds;
+    int quiet = 0;
+
+    /* Parse arguments. */
+    while (argc > 2 && argv[1][0] == '-') {
+        if (!strcmp(argv[1], "-v")) {
+            verbose = 1;
+        } else if (!strcmp(argv[1], "-q")) {
+            quiet = 1;
+        } else if (!strcmp(argv[1], "-j") && argc > 3) {
+            num_jobs = atol(argv[2]);
+            argv++, argc--;
+        } else {
+            break;
+        }
+        argv++, argc--;
+    }
+
+    if (argc < 2 || argv[1][0] == '-') {
+        printf("Usage: utkprobe [-v] [-q] [-j jobs] file-or-directory...\n");
+        printf("Check Maxis UTK, PT/M10 and SCxl files without decoding them.\n");
+        printf("Directories are scanned recursively for MicroTalk files.\n");
+        printf("  -v  list every frame\n");
+        printf("  -q  only list files with errors\n");
+        printf("  -j  number of files to scan at once (default: number of CPUs)\n");
+        return EXIT_FAILURE;
+    }
+
+    for (i = 1; i < (size_t)argc; i++) {
+        struct stat st;
+        size_t first = num_results;
+
+        if (stat(argv[i], &st) == 0 && S_ISDIR(st.st_mode)) {
+            add_dir(argv[i]);
+            qsort(&results[first], num_results - first, sizeof(*results), compare_results);
+        } else {
+            add_path(argv[i], 0);
+        }
+    }
+
+    if (num_jobs < 1)
+        num_jobs = 1;
+    if (num_jobs > MAX_JOBS)
+        num_jobs = MAX_JOBS;
+    if ((size_t)num_jobs > num_results)
+        num_jobs = num_results ? (long)num_results : 1;
+
+    clock_gettime(CLOCK_MONOTONIC, &t0);
+
+    for (i = 0; i < (size_t)num_jobs; i++) {
+        if (pthread_create(&threads[i], NULL, worker, NULL) != 0)
+            fail("failed to create thread");
+    }
+
+    /* Print the results in order as they come in. */
+    for (i = 0; i < num_results; i++) {
+        ProbeResult *r = &results[i];
+        int has_error;
+
+        pthread_mutex_lock(&lock);
+        while (!r->done)
+            pthread_cond_wait(&result_done, &lock);
+        pthread_mutex_unlock(&lock);
+
+        has_error = r->io_error || r->error != UTK_OK;
+        if (!quiet || has_error)
+            print_result(r);
+
+        num_files += !r->skipped;
+        num_errors += has_error;
+        bytes += r->skipped ? 0 : r->file_size;
+
+        free(r->frames);
+        r->frames = NULL;
+    }
+
+    for (i = 0; i < (size_t)num_jobs; i++)
+        pthread_join(threads[i], NULL);
+
+    clock_gettime(CLOCK_MONOTONIC, &t1);
+    seconds = (t1.tv_sec - t0.tv_sec) + (t1.tv_nsec - t0.tv_nsec)*1e-9;
+
+    fprintf(stderr, "%lu files, %lu with errors, %.1f MB in %.2f s (%.0f MB/s)\n",
+            (unsigned long)num_files, (unsigned long)num_errors, bytes/1e6, seconds,
+            seconds > 0 ? bytes/1e6/seconds : 0.0);
+
+    return num_errors ? EXIT_FAILURE : EXIT_SUCCESS;
+}
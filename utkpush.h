@@ -0,0 +1,190 @@
+#ifndef UTKPUSH_H
+#define UTKPUSH_H
+
+#include <stdlib.h>
+#include "utk.h"
+#include "utkscan.h"
+#include "utkseek.h"
+
+/* Push-style decoding, for input that arrives in pieces (e.g. from a
+** socket).
+**
+** Feed the bitstream in chunks of any size with utk_push_feed, then call
+** utk_push_decode_frame until it returns 0. A frame is only decoded once all
+** of its bits have arrived, so running out of input in the middle of a frame
+** never decodes garbage: the frame is retried from its first bit on the next
+** call. Frames need not be byte-aligned, and Rev. 3 frames (with or without
+** a PCM patch) may be split anywhere.
+**
+** Call utk_push_finish at the end of the input. After that, a final partial
+** frame is decoded as if padded with zero bits, like utk_set_ptr does. As
+** with the other decoding functions, the caller should stop after the number
+** of samples given by the container: the padding at the end of a stream can
+** look like one more frame.
+**
+** The input is the bare bitstream: Maxis UTK after the 32-byte header, PT
+** after the PT header, or the payload of each SCDl chunk in SCxl, with
+** utk_push_new_chunk between chunks. */
+
+/* With less than this much input buffered, check that the next frame is
+** complete with the (cheap) scanner before decoding it. With more, decode
+** straight away and roll back in the rare case the frame was longer. */
+#define UTK_PUSH_SCAN_BYTES 2048
+
+/* Where a Rev. 3 frame ends depends on how far the bit reader looked ahead
+** (see utk_unread_bits), so it is only decoded once this many bytes past its
+** end have arrived too, or the input has ended, as it would be from a file. */
+#define UTK_PUSH_REV3_LOOKAHEAD 16
+
+typedef struct UTKPushContext {
+    UTKContext utk; /* utk.decompressed_frame holds the output */
+    int rev3;
+    int finished;
+    uint8_t *buffer;
+    size_t size, capacity;
+    size_t byte_pos; /* the next frame starts at this byte and bit */
+    int bit_pos;
+} UTKPushContext;
+
+/* Point the bit reader at the start of the next frame. */
+static void utk_push_rewind(UTKPushContext *p)
+{
+    UTKContext *ctx = &p->utk;
+
+    utk_set_ptr(ctx, p->buffer + p->byte_pos, p->buffer + p->size);
+
+    if (p->bit_pos) {
+        utk_refill_bits(ctx);
+        utk_read_bits(ctx, p->bit_pos);
+    }
+}
+
+/*
+** Public functions.
+*/
+
+/* Set up a push decoder for a MicroTalk (rev3 = 0) or MicroTalk Rev. 3
+** (rev3 = 1) bitstream. */
+static void utk_push_init(UTKPushContext *p, int rev3)
+{
+    memset(p, 0, sizeof(*p));
+    utk_init(&p->utk);
+    p->rev3 = rev3;
+}
+
+static void utk_push_free(UTKPushContext *p)
+{
+    free(p->buffer);
+    p->buffer = NULL;
+    p->size = p->capacity = p->byte_pos = 0;
+}
+
+/* Append size bytes of input. Returns UTK_OK or UTK_ERR_NOMEM. */
+static int utk_push_feed(UTKPushContext *p, const void *data, size_t size)
+{
+    if (p->finished)
+        return UTK_ERR_INVALID_ARG;
+
+    if (size > p->capacity - p->size) {
+        /* drop the input that has been decoded */
+        memmove(p->buffer, p->buffer + p->byte_pos, p->size - p->byte_pos);
+        p->size -= p->byte_pos;
+        p->byte_pos = 0;
+
+        if (size > p->capacity - p->size) {
+            size_t capacity = p->capacity ? p->capacity : 4096;
+            uint8_t *buffer;
+
+            while (capacity - p->size < size)
+                capacity *= 2;
+
+            buffer = realloc(p->buffer, capacity);
+            if (!buffer)
+                return UTK_ERR_NOMEM;
+
+            p->buffer = buffer;
+            p->capacity = capacity;
+        }
+    }
+
+    memcpy(p->buffer + p->size, data, size);
+    p->size += size;
+
+    return UTK_OK;
+}
+
+/* Mark the end of the input. */
+static void utk_push_finish(UTKPushContext *p)
+{
+    p->finished = 1;
+}
+
+/* Start a new bitstream that continues the decoder state, like utk_set_ptr
+** does between SCDl chunks. Any input that has not been decoded is
+** dropped. */
+static void utk_push_new_chunk(UTKPushContext *p)
+{
+    p->size = p->byte_pos = 0;
+    p->bit_pos = 0;
+    p->finished = 0;
+}
+
+/* Decode the next frame into p->utk.decompressed_frame if all of it has been
+** fed. Returns 1 if a frame was decoded, 0 if more input is needed (or, after
+** utk_push_finish, if the input is used up), or UTK_ERR_BAD_PCM. */
+static int utk_push_decode_frame(UTKPushContext *p)
+{
+    UTKContext *ctx = &p->utk;
+    UTKSeekPoint saved;
+    int parsed_header = ctx->parsed_header;
+    int checked = 0;
+    uint32_t pos; /* bits read, from the start of the frame's first byte */
+    uint32_t avail = (uint32_t)(p->size - p->byte_pos)*8;
+    uint32_t margin = p->rev3 ? 8*UTK_PUSH_REV3_LOOKAHEAD : 0;
+    int ret = UTK_OK;
+
+    if (p->byte_pos >= p->size && (p->finished || p->size == 0))
+        return 0;
+
+    if (!p->finished && p->size - p->byte_pos < UTK_PUSH_SCAN_BYTES) {
+        UTKFrameInfo info;
+
+        utk_push_rewind(p);
+        if (p->rev3)
+            utk_rev3_scan_frame(ctx, p->buffer + p->byte_pos, &info);
+        else
+            utk_scan_frame(ctx, p->buffer + p->byte_pos, &info);
+
+        ctx->parsed_header = parsed_header;
+        if (info.truncated || utk_tell(ctx, p->buffer + p->byte_pos) + margin > avail)
+            return 0;
+        checked = 1;
+    } else if (!p->finished) {
+        memcpy(saved.rc, ctx->rc, sizeof(saved.rc));
+        memcpy(saved.synth_history, ctx->synth_history, sizeof(saved.synth_history));
+        memcpy(saved.adapt_cb, utk_adapt_cb(ctx), sizeof(saved.adapt_cb));
+    }
+
+    utk_push_rewind(p);
+    if (p->rev3)
+        ret = utk_rev3_decode_frame(ctx);
+    else
+        utk_decode_frame(ctx);
+
+    pos = (uint32_t)utk_tell(ctx, p->buffer + p->byte_pos);
+
+    if (!p->finished && !checked && pos + margin > avail) {
+        memcpy(ctx->rc, saved.rc, sizeof(saved.rc));
+        memcpy(ctx->synth_history, saved.synth_history, sizeof(saved.synth_history));
+        memcpy(utk_adapt_cb(ctx), saved.adapt_cb, sizeof(saved.adapt_cb));
+        ctx->parsed_header = parsed_header;
+        return 0;
+    }
+
+    p->byte_pos += pos >> 3;
+    p->bit_pos = pos & 7;
+
+    return ret != UTK_OK ? ret : 1;
+}
+
+#endif
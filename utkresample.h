@@ -0,0 +1,337 @@
+#ifndef UTKRESAMPLE_H
+#define UTKRESAMPLE_H
+
+#include <stdlib.h>
+#include <math.h>
+#include "utk.h"
+
+/* Polyphase resampling of the decoder output, e.g. from 22050 Hz to a
+** mixer's 44100 or 48000 Hz.
+**
+** The ratio out_rate/in_rate is reduced to up/down, and each output sample
+** is a dot product of `taps` input samples with one of `up` windowed-sinc
+** filter phases (see utk_dot in utkdsp.h). Output sample n is taken at input
+** time n*in_rate/out_rate, so the output is not delayed. The state carries
+** across calls, so a stream can be resampled a frame at a time.
+**
+** utk_decode_resampled_s16 and utk_decode_resampled_f32 fuse this with
+** utk_decode_frame: each frame is resampled as it is decoded and converted
+** straight into the caller's buffer. */
+
+enum {
+    UTK_RESAMPLE_FAST = 0,   /* 8 taps */
+    UTK_RESAMPLE_MEDIUM = 1, /* 16 taps */
+    UTK_RESAMPLE_BEST = 2    /* 32 taps */
+};
+
+#define UTK_RESAMPLE_MAX_TAPS 32
+#define UTK_RESAMPLE_MAX_PHASES 4096
+#define UTK_RESAMPLE_MAX_RATIO 16
+
+/* input samples buffered per call to utk_resample_run */
+#define UTK_RESAMPLE_BLOCK 432
+
+typedef struct UTKResampler {
+    uint32_t up, down;   /* out_rate/in_rate in lowest terms */
+    int taps;
+    float *coefs;        /* [up][taps] */
+
+    /* Input samples still needed. The next output is at input time
+    ** pos + phase/up, and its taps start at x[pos - taps/2 + 1]. */
+    float x[UTK_RESAMPLE_MAX_TAPS + UTK_RESAMPLE_BLOCK];
+    int len;
+    int pos;
+    uint32_t phase;
+    uint64_t total_in, total_out;
+
+    /* resampled output not yet returned by utk_decode_resampled_* */
+    float *pending;
+    int pending_pos, pending_len;
+} UTKResampler;
+
+static uint32_t utk_gcd(uint32_t a, uint32_t b)
+{
+    while (b) {
+        uint32_t t = a % b;
+        a = b;
+        b = t;
+    }
+
+    return a;
+}
+
+/* The zeroth-order modified Bessel function of the first kind, for the
+** Kaiser window. */
+static double utk_bessel_i0(double x)
+{
+    double sum = 1.0, term = 1.0;
+    int k;
+
+    for (k = 1; k < 50; k++) {
+        term *= (x / (2*k)) * (x / (2*k));
+        sum += term;
+        if (term < sum * 1e-12)
+            break;
+    }
+
+    return sum;
+}
+
+/* Fill in the filter phases: a Kaiser-windowed sinc with its cutoff just
+** below the lower of the two Nyquist frequencies, normalized to unit gain at
+** DC in every phase. */
+static void utk_resample_make_filter(UTKResampler *r, double rolloff, double beta)
+{
+    const double pi = 3.14159265358979323846;
+    double cutoff = rolloff * (r->up < r->down ? (double)r->up / r->down : 1.0);
+    int half = r->taps / 2;
+    uint32_t p;
+    int k;
+
+    for (p = 0; p < r->up; p++) {
+        float *c = &r->coefs[p * r->taps];
+        double sum = 0.0;
+
+        for (k = 0; k < r->taps; k++) {
+            double d = k - half + 1 - (double)p / r->up;
+            double w = 1.0 - (d / half) * (d / half);
+            double x = pi * cutoff * d;
+            double h = (x == 0.0) ? 1.0 : sin(x) / x;
+
+            c[k] = (float)(h * (w > 0.0 ? utk_bessel_i0(beta * sqrt(w)) / utk_bessel_i0(beta) : 0.0));
+            sum += c[k];
+        }
+
+        for (k = 0; k < r->taps; k++)
+            c[k] = (float)(c[k] / sum);
+    }
+}
+
+/* Compute output samples while their taps are all available, up to
+** max_out. Then drop the input samples that are no longer needed. */
+static int utk_resample_run(UTKResampler *r, float *out, int max_out)
+{
+    int half = r->taps / 2;
+    int n = 0;
+
+    while (n < max_out && r->pos + half < r->len) {
+        out[n++] = utk_dot(&r->coefs[r->phase * r->taps], &r->x[r->pos - half + 1], r->taps);
+
+        r->phase += r->down;
+        r->pos += r->phase / r->up;
+        r->phase %= r->up;
+    }
+
+    if (r->pos - half + 1 > 0) {
+        int drop = r->pos - half + 1;
+
+        if (drop > r->len)
+            drop = r->len;
+        memmove(r->x, &r->x[drop], (r->len - drop) * sizeof(float));
+        r->len -= drop;
+        r->pos -= drop;
+    }
+
+    r->total_out += n;
+
+    return n;
+}
+
+/*
+** Public functions.
+*/
+
+/* The number of output samples for num_samples input samples. */
+static uint64_t utk_resample_length(const UTKResampler *r, uint64_t num_samples)
+{
+    return (num_samples * r->up + r->down - 1) / r->down;
+}
+
+/* An upper bound on the output of one call to utk_resample with n input
+** samples. */
+static int utk_resample_max_output(const UTKResampler *r, int n)
+{
+    return (int)((uint64_t)n * r->up / r->down) + 2;
+}
+
+static void utk_resample_free(UTKResampler *r)
+{
+    free(r->coefs);
+    free(r->pending);
+    r->coefs = r->pending = NULL;
+}
+
+/* Clear the history, to start resampling a new stream. */
+static void utk_resample_reset(UTKResampler *r)
+{
+    int half = r->taps / 2;
+
+    /* the first output is centered on the first input sample */
+    memset(r->x, 0, sizeof(r->x));
+    r->len = half - 1;
+    r->pos = half - 1;
+    r->phase = 0;
+    r->total_in = r->total_out = 0;
+    r->pending_pos = r->pending_len = 0;
+}
+
+/* Set up a resampler from in_rate to out_rate (in Hz) at the given quality
+** (UTK_RESAMPLE_*). Returns UTK_OK, UTK_ERR_INVALID_ARG, UTK_ERR_UNSUPPORTED
+** if the reduced ratio needs more than UTK_RESAMPLE_MAX_PHASES phases or is
+** above UTK_RESAMPLE_MAX_RATIO, or UTK_ERR_NOMEM. */
+static int utk_resample_init(UTKResampler *r, uint32_t in_rate, uint32_t out_rate,
+                             int quality)
+{
+    static const int taps[3] = {8, 16, 32};
+    static const double rolloff[3] = {0.85, 0.9, 0.95};
+    static const double beta[3] = {5.0, 7.0, 9.0};
+    uint32_t g;
+
+    memset(r, 0, sizeof(*r));
+
+    if (in_rate == 0 || out_rate == 0 || quality < 0 || quality > 2)
+        return UTK_ERR_INVALID_ARG;
+
+    g = utk_gcd(in_rate, out_rate);
+    r->up = out_rate / g;
+    r->down = in_rate / g;
+    r->taps = taps[quality];
+
+    if (r->up > UTK_RESAMPLE_MAX_PHASES || r->up > UTK_RESAMPLE_MAX_RATIO * r->down)
+        return UTK_ERR_UNSUPPORTED;
+
+    r->coefs = malloc(r->up * r->taps * sizeof(float));
+    r->pending = malloc(utk_resample_max_output(r, 432) * sizeof(float));
+    if (!r->coefs || !r->pending) {
+        utk_resample_free(r);
+        return UTK_ERR_NOMEM;
+    }
+
+    utk_resample_make_filter(r, rolloff[quality], beta[quality]);
+    utk_resample_reset(r);
+
+    return UTK_OK;
+}
+
+/* Resample n input samples into out, which must have room for
+** utk_resample_max_output(r, n) samples. Returns the number of samples
+** written. */
+static int utk_resample(UTKResampler *r, const float *in, int n, float *out)
+{
+    int total = 0;
+
+    while (n > 0) {
+        int count = n < UTK_RESAMPLE_BLOCK ? n : UTK_RESAMPLE_BLOCK;
+
+        memcpy(&r->x[r->len], in, count * sizeof(float));
+        r->len += count;
+        r->total_in += count;
+        in += count;
+        n -= count;
+
+        total += utk_resample_run(r, &out[total], 0x7fffffff);
+    }
+
+    return total;
+}
+
+/* At the end of the stream, write the remaining output samples (those
+** whose taps reach past the last input sample, which are taken as zero)
+** into out, which must have room for utk_resample_max_output(r, taps/2)
+** samples. Returns the number of samples written. */
+static int utk_resample_flush(UTKResampler *r, float *out)
+{
+    uint64_t length = utk_resample_length(r, r->total_in);
+    int half = r->taps / 2;
+
+    memset(&r->x[r->len], 0, half * sizeof(float));
+    r->len += half;
+
+    return utk_resample_run(r, out, (int)(length - r->total_out));
+}
+
+/* Refill the pending output of a stream of num_samples input samples:
+** decode and resample the next frame, feeding only the samples of the last
+** frame that are part of the stream, or once they have all been fed, flush
+** the resampler. Returns 0 when there is no output left. */
+static int utk_resample_refill(UTKContext *ctx, UTKResampler *r, uint64_t num_samples)
+{
+    uint64_t left = num_samples - r->total_in;
+
+    r->pending_pos = 0;
+
+    if (left > 0) {
+        utk_decode_frame(ctx);
+        r->pending_len = utk_resample(r, ctx->decompressed_frame,
+                                      left < 432 ? (int)left : 432, r->pending);
+    } else if (r->total_out < utk_resample_length(r, num_samples)) {
+        r->pending_len = utk_resample_flush(r, r->pending);
+    } else {
+        r->pending_len = 0;
+        return 0;
+    }
+
+    return 1;
+}
+
+/* Decode frames of a stream of num_samples samples and resample them until
+** count samples have been written to out, as rounded and saturated int16
+** samples. Resampled samples beyond count are kept for the next call.
+** Returns the number of samples written, which is less than count only at
+** the end of the stream, after utk_resample_length(r, num_samples) samples
+** in all. */
+static size_t utk_decode_resampled_s16(UTKContext *ctx, UTKResampler *r,
+                                       uint64_t num_samples, int16_t *out, size_t count)
+{
+    size_t total = 0;
+
+    while (total < count) {
+        int n;
+
+        if (r->pending_pos == r->pending_len) {
+            if (!utk_resample_refill(ctx, r, num_samples))
+                break;
+            continue;
+        }
+
+        n = r->pending_len - r->pending_pos;
+        if ((size_t)n > count - total)
+            n = (int)(count - total);
+
+        utk_convert_s16(&out[total], &r->pending[r->pending_pos], n);
+        r->pending_pos += n;
+        total += n;
+    }
+
+    return total;
+}
+
+/* Same as utk_decode_resampled_s16, but output float samples with int16
+** full scale at +-1.0. These are not clipped. */
+static size_t utk_decode_resampled_f32(UTKContext *ctx, UTKResampler *r,
+                                       uint64_t num_samples, float *out, size_t count)
+{
+    size_t total = 0;
+
+    while (total < count) {
+        int n;
+
+        if (r->pending_pos == r->pending_len) {
+            if (!utk_resample_refill(ctx, r, num_samples))
+                break;
+            continue;
+        }
+
+        n = r->pending_len - r->pending_pos;
+        if ((size_t)n > count - total)
+            n = (int)(count - total);
+
+        utk_convert_f32(&out[total], &r->pending[r->pending_pos], n);
+        r->pending_pos += n;
+        total += n;
+    }
+
+    return total;
+}
+
+#endif
@@ -0,0 +1,181 @@
+#ifndef UTKSCAN_H
+#define UTKSCAN_H
+
+#include "utk.h"
+
+/* Parse-only scanning of a MicroTalk bitstream.
+**
+** utk_scan_frame reads a frame exactly as utk_parse_frame does, but only
+** walks the excitation codes instead of decoding them, and leaves out
+** everything after parsing (rc_to_lpc, the pitch mix and the synthesis
+** filter). It is meant for validating and cataloguing files without
+** decoding them. The decoder state other than the bit reader and the header
+** fields is not touched, so a context that has been scanned must be
+** reinitialized before decoding. */
+
+/* What utk_scan_frame found out about one frame. */
+typedef struct UTKFrameInfo {
+    uint64_t bit_offset;  /* start of the frame, from the start passed in */
+    uint32_t num_bits;    /* including the stream header on the first frame */
+    int use_multipulse;   /* otherwise RELP */
+    int subframe_bits[4]; /* including the pitch and gain fields */
+    int pcm_samples;      /* Rev. 3 only: number of raw PCM samples */
+    int truncated;        /* the frame runs past the end of the input */
+} UTKFrameInfo;
+
+/* Walk the excitation codes of one subframe, which fill num_samples
+** positions (108, or 54 at reduced bandwidth), without decoding them. */
+static void utk_skip_excitation(UTKContext *ctx, int use_multipulse, int num_samples)
+{
+    int i = 0;
+
+    if (use_multipulse) {
+        int model = 0;
+
+        while (i < num_samples) {
+            uint32_t entry;
+            int n, cmd;
+
+            if (ctx->bits_count < UTK_PULSE_BITS)
+                utk_refill_bits(ctx);
+
+            entry = utk_pulse_table[model][ctx->bits_value & ((1 << UTK_PULSE_BITS) - 1)];
+            n = (entry >> 20) & 7;
+
+            if (n > 0 && i + n <= num_samples) {
+                utk_read_bits(ctx, (entry >> 23) & 15);
+                model = entry >> 27;
+                i += n;
+                continue;
+            }
+
+            cmd = utk_codebooks[model][ctx->bits_value & 0xff];
+            model = utk_commands[cmd].next_model;
+            utk_read_bits(ctx, utk_commands[cmd].code_size);
+
+            if (cmd > 3) {
+                i++;
+            } else if (cmd > 1) {
+                int count = 7 + utk_read_bits(ctx, 6);
+                i += count < num_samples - i ? count : num_samples - i;
+            } else {
+                while (utk_read_bits(ctx, 1))
+                    ;
+                utk_read_bits(ctx, 1);
+                i++;
+            }
+        }
+    } else {
+        while (i < num_samples) {
+            uint32_t entry = utk_relp_table[ctx->bits_value & 0xff];
+            int n = (entry >> 16) & 15;
+
+            if (i + n <= num_samples) {
+                utk_read_bits(ctx, (entry >> 20) & 15);
+                i += n;
+                continue;
+            }
+
+            if (utk_read_bits(ctx, 1))
+                utk_read_bits(ctx, 1);
+            i++;
+        }
+    }
+}
+
+/*
+** Public functions.
+*/
+
+/* Scan one frame of a stream read from memory, whose bit offsets are
+** counted from start. Returns UTK_OK, or UTK_ERR_EOF if the frame is
+** truncated. */
+static int utk_scan_frame(UTKContext *ctx, const uint8_t *start, UTKFrameInfo *info)
+{
+    uint64_t pos;
+    int i;
+
+    if (!ctx->bits_count)
+        utk_refill_bits(ctx);
+
+    memset(info, 0, sizeof(*info));
+    info->bit_offset = utk_tell(ctx, start);
+
+    if (!ctx->parsed_header) {
+        utk_parse_header(ctx);
+        ctx->parsed_header = 1;
+    }
+
+    /* the reflection coefficients */
+    if (utk_read_bits(ctx, 6) < ctx->multipulse_thresh)
+        info->use_multipulse = 1;
+    utk_read_bits(ctx, 6);
+    utk_read_bits(ctx, 6);
+    utk_read_bits(ctx, 6);
+    for (i = 4; i < 12; i++)
+        utk_read_bits(ctx, 5);
+
+    pos = utk_tell(ctx, start);
+
+    for (i = 0; i < 4; i++) {
+        uint64_t next;
+
+        /* pitch lag, pitch gain and fixed gain */
+        utk_read_bits(ctx, 8);
+        utk_read_bits(ctx, 4);
+        utk_read_bits(ctx, 6);
+
+        if (!ctx->reduced_bw) {
+            utk_skip_excitation(ctx, info->use_multipulse, 108);
+        } else {
+            /* align and zero flags */
+            utk_read_bits(ctx, 2);
+            utk_skip_excitation(ctx, info->use_multipulse, 54);
+        }
+
+        next = utk_tell(ctx, start);
+        info->subframe_bits[i] = (int)(next - pos);
+        pos = next;
+    }
+
+    info->num_bits = (uint32_t)(pos - info->bit_offset);
+    info->truncated = pos > (uint64_t)(ctx->end - start)*8;
+
+    return info->truncated ? UTK_ERR_EOF : UTK_OK;
+}
+
+/* Scan one MicroTalk Rev. 3 frame, including its PCM patch, like
+** utk_rev3_decode_frame. Returns UTK_OK, UTK_ERR_EOF if the frame is
+** truncated, or UTK_ERR_BAD_PCM. */
+static int utk_rev3_scan_frame(UTKContext *ctx, const uint8_t *start, UTKFrameInfo *info)
+{
+    uint64_t bit_offset = utk_tell(ctx, start);
+    int pcm_data_present = (utk_read_byte(ctx) == 0xee);
+    int ret = utk_scan_frame(ctx, start, info);
+    uint64_t end;
+
+    utk_unread_bits(ctx);
+
+    if (pcm_data_present) {
+        int offset = utk_read_i16(ctx);
+        int count = utk_read_i16(ctx);
+        int i;
+
+        if (offset < 0 || offset > 432 || count < 0 || count > 432 - offset)
+            return UTK_ERR_BAD_PCM;
+
+        for (i = 0; i < count; i++)
+            utk_read_i16(ctx);
+
+        info->pcm_samples = count;
+    }
+
+    end = utk_tell(ctx, start);
+    info->bit_offset = bit_offset;
+    info->num_bits = (uint32_t)(end - bit_offset);
+    info->truncated |= end > (uint64_t)(ctx->end - start)*8;
+
+    return info->truncated ? UTK_ERR_EOF : ret;
+}
+
+#endif
@@ -0,0 +1,279 @@
+#ifndef UTKSEEK_H
+#define UTKSEEK_H
+
+#include <stdlib.h>
+#include "utk.h"
+
+/* Random access into a MicroTalk bitstream.
+**
+** Frames are not byte-aligned, and every frame depends on the decoder state
+** left by the previous one (rc, synth_history and adapt_cb), so a stream can
+** normally only be decoded from the start. A seek index stores, every
+** `interval` frames, the bit offset of the frame and a copy of that state.
+** utk_seek restores the nearest seek point at or before the target and
+** decodes forward from there, which gives the same samples as decoding from
+** the start.
+**
+** The index covers one contiguous bitstream decoded with utk_set_ptr
+** (Maxis UTK after the 32-byte header, or PT after the PT header). It is
+** built by decoding the whole stream once, and can be saved to a sidecar file
+** with utk_seek_save and loaded again with utk_seek_load.
+**
+** Each seek point takes UTK_SEEK_POINT_SIZE bytes (about 1.4 KiB). The
+** interval trades index size against seek time: utk_seek decodes up to
+** interval-1 frames before it returns, and a frame is 432 samples.
+**
+** Bit offsets are saved as 32 bits, so an index covers bitstreams of up to
+** UTK_SEEK_MAX_STREAM_SIZE bytes (about 37 hours at 32 kbit/s). */
+
+#define UTK_SEEK_DEFAULT_INTERVAL 64
+
+/* Saved index layout (all fields little-endian):
+**   0  'UTKI'
+**   4  u32 interval (frames between seek points)
+**   8  u32 number of frames in the stream
+**  12  u32 number of seek points
+**  16  u32 size of the bitstream in bytes
+**  20  seek points: u32 bit offset, then rc[12], synth_history[12] and
+**      adapt_cb[324] as IEEE float bit patterns */
+#define UTK_SEEK_HEADER_SIZE 20
+#define UTK_SEEK_POINT_SIZE (4 + 4*(12+12+324))
+#define UTK_SEEK_MAX_STREAM_SIZE 0x1fffffff
+
+/* The decoder state at the start of a frame. */
+typedef struct UTKSeekPoint {
+    uint32_t bit_offset; /* from the start of the bitstream */
+    float rc[12];
+    float synth_history[12];
+    float adapt_cb[324];
+} UTKSeekPoint;
+
+typedef struct UTKSeekIndex {
+    uint32_t interval;
+    uint32_t num_frames;
+    uint32_t num_points; /* points[i] is the state before frame i*interval */
+    uint32_t stream_size;
+    UTKSeekPoint *points;
+} UTKSeekIndex;
+
+static void utk_seek_put_u32(uint8_t *p, uint32_t x)
+{
+    p[0] = (uint8_t)x;
+    p[1] = (uint8_t)(x>>8);
+    p[2] = (uint8_t)(x>>16);
+    p[3] = (uint8_t)(x>>24);
+}
+
+static uint32_t utk_seek_get_u32(const uint8_t *p)
+{
+    return p[0] | (p[1] << 8) | (p[2] << 16) | ((uint32_t)p[3] << 24);
+}
+
+static void utk_seek_put_floats(uint8_t *p, const float *x, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        uint32_t u;
+        memcpy(&u, &x[i], 4);
+        utk_seek_put_u32(p + 4*i, u);
+    }
+}
+
+static void utk_seek_get_floats(float *x, const uint8_t *p, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++) {
+        uint32_t u = utk_seek_get_u32(p + 4*i);
+        memcpy(&x[i], &u, 4);
+    }
+}
+
+/*
+** Public functions.
+*/
+
+static void utk_seek_free(UTKSeekIndex *index)
+{
+    free(index->points);
+    memset(index, 0, sizeof(*index));
+}
+
+/* Build a seek index for the num_samples-sample bitstream in [ptr, end),
+** with a seek point every interval frames. Returns UTK_ERR_UNSUPPORTED if
+** the bitstream is larger than UTK_SEEK_MAX_STREAM_SIZE. */
+static int utk_seek_build(UTKSeekIndex *index, const uint8_t *ptr,
+                          const uint8_t *end, uint32_t num_samples,
+                          uint32_t interval)
+{
+    UTKContext *ctx;
+    uint32_t i;
+
+    memset(index, 0, sizeof(*index));
+
+    if (interval == 0 || ptr > end)
+        return UTK_ERR_INVALID_ARG;
+    if ((size_t)(end - ptr) > UTK_SEEK_MAX_STREAM_SIZE)
+        return UTK_ERR_UNSUPPORTED;
+
+    index->interval = interval;
+    index->num_frames = (num_samples + 431) / 432;
+    index->num_points = index->num_frames ? (index->num_frames - 1) / interval + 1 : 0;
+    index->stream_size = (uint32_t)(end - ptr);
+
+    /* (too big for the stack on some platforms) */
+    ctx = malloc(sizeof(*ctx));
+    index->points = malloc(index->num_points * sizeof(*index->points) + 1);
+    if (!ctx || !index->points) {
+        free(ctx);
+        utk_seek_free(index);
+        return UTK_ERR_NOMEM;
+    }
+
+    /* parse the header up front, so that every seek point is at a frame */
+    utk_init(ctx);
+    utk_set_ptr(ctx, ptr, end);
+    utk_refill_bits(ctx);
+    utk_parse_header(ctx);
+    ctx->parsed_header = 1;
+
+    for (i = 0; i < index->num_frames; i++) {
+        if (i % interval == 0) {
+            UTKSeekPoint *point = &index->points[i / interval];
+
+            point->bit_offset = (uint32_t)utk_tell(ctx, ptr);
+
+            memcpy(point->rc, ctx->rc, sizeof(point->rc));
+            memcpy(point->synth_history, ctx->synth_history, sizeof(point->synth_history));
+            memcpy(point->adapt_cb, utk_adapt_cb(ctx), sizeof(point->adapt_cb));
+        }
+
+        utk_decode_frame(ctx);
+    }
+
+    free(ctx);
+
+    return UTK_OK;
+}
+
+/* Position ctx, which must not be reading from a FILE, so that the next
+** call to utk_decode_frame decodes the frame containing the given sample of
+** the bitstream in [ptr, end). On success, *skip receives the position of
+** that sample within the frame. Seeking to the end of the stream is
+** allowed. */
+static int utk_seek(UTKContext *ctx, const UTKSeekIndex *index,
+                    const uint8_t *ptr, const uint8_t *end,
+                    uint32_t sample, int *skip)
+{
+    const UTKSeekPoint *point;
+    uint32_t frame = sample / 432;
+    uint32_t i;
+
+    if (ctx->file || frame > index->num_frames || (size_t)(end - ptr) != index->stream_size)
+        return UTK_ERR_INVALID_ARG;
+
+    if (skip)
+        *skip = (int)(sample % 432);
+
+    utk_init(ctx);
+    utk_set_ptr(ctx, ptr, end);
+
+    if (index->num_points == 0)
+        return UTK_OK;
+
+    /* the header is needed by every frame */
+    utk_refill_bits(ctx);
+    utk_parse_header(ctx);
+    ctx->parsed_header = 1;
+
+    i = frame / index->interval;
+    if (i >= index->num_points)
+        i = index->num_points - 1;
+    point = &index->points[i];
+
+    memcpy(ctx->rc, point->rc, sizeof(point->rc));
+    memcpy(ctx->synth_history, point->synth_history, sizeof(point->synth_history));
+    memcpy(utk_adapt_cb(ctx), point->adapt_cb, sizeof(point->adapt_cb));
+
+    utk_set_bit_ptr(ctx, ptr, end, point->bit_offset);
+
+    for (i *= index->interval; i < frame; i++)
+        utk_decode_frame(ctx);
+
+    return UTK_OK;
+}
+
+/* Size in bytes of the saved form of an index. */
+static size_t utk_seek_saved_size(const UTKSeekIndex *index)
+{
+    return UTK_SEEK_HEADER_SIZE + (size_t)index->num_points * UTK_SEEK_POINT_SIZE;
+}
+
+/* Write an index to dest, which must hold utk_seek_saved_size bytes. */
+static void utk_seek_save(const UTKSeekIndex *index, uint8_t *dest)
+{
+    uint32_t i;
+
+    memcpy(dest, "UTKI", 4);
+    utk_seek_put_u32(dest + 4, index->interval);
+    utk_seek_put_u32(dest + 8, index->num_frames);
+    utk_seek_put_u32(dest + 12, index->num_points);
+    utk_seek_put_u32(dest + 16, index->stream_size);
+    dest += UTK_SEEK_HEADER_SIZE;
+
+    for (i = 0; i < index->num_points; i++) {
+        const UTKSeekPoint *point = &index->points[i];
+
+        utk_seek_put_u32(dest, point->bit_offset);
+        utk_seek_put_floats(dest + 4, point->rc, 12);
+        utk_seek_put_floats(dest + 4 + 4*12, point->synth_history, 12);
+        utk_seek_put_floats(dest + 4 + 4*24, point->adapt_cb, 324);
+        dest += UTK_SEEK_POINT_SIZE;
+    }
+}
+
+/* Load an index saved by utk_seek_save. */
+static int utk_seek_load(UTKSeekIndex *index, const uint8_t *data, size_t size)
+{
+    uint32_t i;
+
+    memset(index, 0, sizeof(*index));
+
+    if (size < UTK_SEEK_HEADER_SIZE || memcmp(data, "UTKI", 4) != 0)
+        return UTK_ERR_BAD_SIGNATURE;
+
+    index->interval = utk_seek_get_u32(data + 4);
+    index->num_frames = utk_seek_get_u32(data + 8);
+    index->num_points = utk_seek_get_u32(data + 12);
+    index->stream_size = utk_seek_get_u32(data + 16);
+
+    if (index->interval == 0 || index->num_frames >= 0x01000000
+        || index->num_points != (index->num_frames ? (index->num_frames - 1) / index->interval + 1 : 0)
+        || (size - UTK_SEEK_HEADER_SIZE) / UTK_SEEK_POINT_SIZE < index->num_points) {
+        memset(index, 0, sizeof(*index));
+        return UTK_ERR_BAD_HEADER;
+    }
+
+    index->points = malloc(index->num_points * sizeof(*index->points) + 1);
+    if (!index->points) {
+        memset(index, 0, sizeof(*index));
+        return UTK_ERR_NOMEM;
+    }
+
+    data += UTK_SEEK_HEADER_SIZE;
+
+    for (i = 0; i < index->num_points; i++) {
+        UTKSeekPoint *point = &index->points[i];
+
+        point->bit_offset = utk_seek_get_u32(data);
+        utk_seek_get_floats(point->rc, data + 4, 12);
+        utk_seek_get_floats(point->synth_history, data + 4 + 4*12, 12);
+        utk_seek_get_floats(point->adapt_cb, data + 4 + 4*24, 324);
+        data += UTK_SEEK_POINT_SIZE;
+    }
+
+    return UTK_OK;
+}
+
+#endif
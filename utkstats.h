@@ -0,0 +1,139 @@
+#ifndef UTKSTATS_H
+#define UTKSTATS_H
+
+#include <stdio.h>
+#include <string.h>
+#include "utk.h"
+
+/* Aggregate the per-frame statistics of the decoder (UTKFrameStats in
+** utk.h) over a stream, and write them out as JSON or CSV.
+**
+**     UTKStats stats;
+**     utk_init(&ctx);
+**     utk_stats_init(&stats);
+**     utk_stats_attach(&ctx, &stats);
+**     ... decode ...
+**     utk_stats_write_json(stdout, &stats);
+**
+** The statistics are only gathered with -DUTK_STATS. */
+
+#ifndef UTK_STATS
+#error "utkstats.h needs the decoder statistics: compile with -DUTK_STATS"
+#endif
+
+typedef struct UTKStats {
+    uint32_t frames;
+    uint32_t multipulse_frames;
+    uint64_t bits;
+    int min_subframe_bits, max_subframe_bits;
+    uint32_t pitch_lag[256];  /* subframes with each value */
+    uint32_t pitch_gain[16];
+    uint32_t fixed_gain[64];
+    uint64_t zero_runs;
+    uint64_t large_pulses;
+    uint64_t clipped;         /* samples */
+    uint32_t clipped_frames;
+} UTKStats;
+
+static void utk_stats_init(UTKStats *s)
+{
+    memset(s, 0, sizeof(*s));
+}
+
+static void utk_stats_add(UTKStats *s, const UTKFrameStats *f)
+{
+    int i;
+
+    for (i = 0; i < 4; i++) {
+        if ((s->frames == 0 && i == 0) || f->subframe_bits[i] < s->min_subframe_bits)
+            s->min_subframe_bits = f->subframe_bits[i];
+        if (f->subframe_bits[i] > s->max_subframe_bits)
+            s->max_subframe_bits = f->subframe_bits[i];
+
+        s->bits += f->subframe_bits[i];
+        s->pitch_lag[f->pitch_lag[i] & 255]++;
+        s->pitch_gain[f->pitch_gain[i] & 15]++;
+        s->fixed_gain[f->fixed_gain[i] & 63]++;
+    }
+
+    s->frames++;
+    s->multipulse_frames += f->use_multipulse;
+    s->zero_runs += f->zero_runs;
+    s->large_pulses += f->large_pulses;
+    s->clipped += f->clipped;
+    s->clipped_frames += f->clipped > 0;
+}
+
+/* A stats_hook that adds each frame to the UTKStats in opaque. */
+static void utk_stats_hook(void *opaque, const UTKFrameStats *f)
+{
+    utk_stats_add((UTKStats *)opaque, f);
+}
+
+/* Aggregate every frame that ctx decodes into s. Call this after
+** utk_init. */
+static void utk_stats_attach(UTKContext *ctx, UTKStats *s)
+{
+    ctx->stats_hook = utk_stats_hook;
+    ctx->stats_opaque = s;
+}
+
+static void utk_stats_write_histogram(FILE *fp, const uint32_t *counts, int n)
+{
+    int i;
+
+    for (i = 0; i < n; i++)
+        fprintf(fp, "%s%lu", i ? ", " : "", (unsigned long)counts[i]);
+}
+
+static void utk_stats_write_json(FILE *fp, const UTKStats *s)
+{
+    double subframes = s->frames ? 4.0*s->frames : 1.0;
+
+    fprintf(fp, "{\n");
+    fprintf(fp, "  \"frames\": %lu,\n", (unsigned long)s->frames);
+    fprintf(fp, "  \"multipulse_frames\": %lu,\n", (unsigned long)s->multipulse_frames);
+    fprintf(fp, "  \"relp_frames\": %lu,\n", (unsigned long)(s->frames - s->multipulse_frames));
+    fprintf(fp, "  \"bits\": %.0f,\n", (double)s->bits);
+    fprintf(fp, "  \"subframe_bits\": {\"min\": %d, \"max\": %d, \"mean\": %.1f},\n",
+            s->min_subframe_bits, s->max_subframe_bits, s->bits / subframes);
+    fprintf(fp, "  \"zero_runs\": %.0f,\n", (double)s->zero_runs);
+    fprintf(fp, "  \"large_pulses\": %.0f,\n", (double)s->large_pulses);
+    fprintf(fp, "  \"clipped_samples\": %.0f,\n", (double)s->clipped);
+    fprintf(fp, "  \"clipped_frames\": %lu,\n", (unsigned long)s->clipped_frames);
+    fprintf(fp, "  \"pitch_lag\": [");
+    utk_stats_write_histogram(fp, s->pitch_lag, 256);
+    fprintf(fp, "],\n  \"pitch_gain\": [");
+    utk_stats_write_histogram(fp, s->pitch_gain, 16);
+    fprintf(fp, "],\n  \"fixed_gain\": [");
+    utk_stats_write_histogram(fp, s->fixed_gain, 64);
+    fprintf(fp, "]\n}\n");
+}
+
+/* One row per value: name,index,value, where index is only given for the
+** histograms (pitch_lag, pitch_gain and fixed_gain, in subframes). */
+static void utk_stats_write_csv(FILE *fp, const UTKStats *s)
+{
+    int i;
+
+    fprintf(fp, "stat,index,value\n");
+    fprintf(fp, "frames,,%lu\n", (unsigned long)s->frames);
+    fprintf(fp, "multipulse_frames,,%lu\n", (unsigned long)s->multipulse_frames);
+    fprintf(fp, "relp_frames,,%lu\n", (unsigned long)(s->frames - s->multipulse_frames));
+    fprintf(fp, "bits,,%.0f\n", (double)s->bits);
+    fprintf(fp, "min_subframe_bits,,%d\n", s->min_subframe_bits);
+    fprintf(fp, "max_subframe_bits,,%d\n", s->max_subframe_bits);
+    fprintf(fp, "zero_runs,,%.0f\n", (double)s->zero_runs);
+    fprintf(fp, "large_pulses,,%.0f\n", (double)s->large_pulses);
+    fprintf(fp, "clipped_samples,,%.0f\n", (double)s->clipped);
+    fprintf(fp, "clipped_frames,,%lu\n", (unsigned long)s->clipped_frames);
+
+    for (i = 0; i < 256; i++)
+        fprintf(fp, "pitch_lag,%d,%lu\n", i, (unsigned long)s->pitch_lag[i]);
+    for (i = 0; i < 16; i++)
+        fprintf(fp, "pitch_gain,%d,%lu\n", i, (unsigned long)s->pitch_gain[i]);
+    for (i = 0; i < 64; i++)
+        fprintf(fp, "fixed_gain,%d,%lu\n", i, (unsigned long)s->fixed_gain[i]);
+}
+
+#endif
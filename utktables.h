@@ -0,0 +1,330 @@
+/* Generated by utkgentables. Do not edit. */
+#ifndef UTKTABLES_H
+#define UTKTABLES_H
+
+#include <stdint.h>
+
+/* Multi-pulse decoding table, indexed by model and the next 10 bits.
+** bits 0-19: up to 5 pulse values, 4 bits each, biased by +8
+** bits 20-22: number of pulses (0 if the first command is an escape)
+** bits 23-26: number of bits consumed
+** bit 27: model after the last pulse */
+#define UTK_PULSE_BITS 10
+
+static const uint32_t utk_pulse_table[2][1024] = {
+    { /* normal model */
+        0x05588888, 0x05588889, 0x05588887, 0x05408886, 0x05588898, 0x05588899, 0x05588897, 0x04b00885,
+        0x05588878, 0x05588879, 0x05588877, 0x0540888a, 0x05408868, 0x05408869, 0x05408867, 0x05300884,
+        0x05588988, 0x05588989, 0x05588987, 0x04b00866, 0x05588998, 0x05588999, 0x05588997, 0x04b0088b,
+        0x05588978, 0x05588979, 0x05588977, 0x04b0086a, 0x04b00858, 0x04b00859, 0x04b00857, 0x04a00083,
+        0x05588788, 0x05588789, 0x05588787, 0x04b00876, 0x05588798, 0x05588799, 0x05588797, 0x05300865,
+        0x05588778, 0x05588779, 0x05588777, 0x04b0087a, 0x054088a8, 0x054088a9, 0x054088a7, 0x0530088c,
+        0x05408688, 0x05408689, 0x05408687, 0x05300856, 0x05408698, 0x05408699, 0x05408697, 0x0530086b,
+        0x05408678, 0x05408679, 0x05408677, 0x0530085a, 0x05300848, 0x05300849, 0x05300847, 0x05200082,
+        0x05589888, 0x05589889, 0x05589887, 0x05408986, 0x05589898, 0x05589899, 0x05589897, 0x05300875,
+        0x05589878, 0x05589879, 0x05589877, 0x0540898a, 0x0cb00668, 0x0cb00669, 0x0cb00667, 0x0ca00064,
+        0x05589988, 0x05589989, 0x05589987, 0x04b008a6, 0x05589998, 0x05589999, 0x05589997, 0x0530087b,
+        0x05589978, 0x05589979, 0x05589977, 0x04b008aa, 0x04b008b8, 0x04b008b9, 0x04b008b7, 0x04a0008d,
+        0x05589788, 0x05589789, 0x05589787, 0x04b00896, 0x05589798, 0x05589799, 0x05589797, 0x0ca00055,
+        0x05589778, 0x05589779, 0x05589777, 0x04b0089a, 0x0cb006a8, 0x0cb006a9, 0x0cb006a7, 0x0ca0006c,
+        0x0cb00588, 0x0cb00589, 0x0cb00587, 0x0ca00046, 0x0cb00598, 0x0cb00599, 0x0cb00597, 0x0ca0005b,
+        0x0cb00578, 0x0cb00579, 0x0cb00577, 0x0ca0004a, 0x0ca00038, 0x0ca00039, 0x0ca00037, 0x00000000,
+        0x05587888, 0x05587889, 0x05587887, 0x05408786, 0x05587898, 0x05587899, 0x05587897, 0x04b00985,
+        0x05587878, 0x05587879, 0x05587877, 0x0540878a, 0x04b00768, 0x04b00769, 0x04b00767, 0x04a00074,
+        0x05587988, 0x05587989, 0x05587987, 0x0d300666, 0x05587998, 0x05587999, 0x05587997, 0x04b0098b,
+        0x05587978, 0x05587979, 0x05587977, 0x0d30066a, 0x0d300658, 0x0d300659, 0x0d300657, 0x0d200063,
+        0x05587788, 0x05587789, 0x05587787, 0x04b00976, 0x05587798, 0x05587799, 0x05587797, 0x053008a5,
+        0x05587778, 0x05587779, 0x05587777, 0x04b0097a, 0x04b007a8, 0x04b007a9, 0x04b007a7, 0x04a0007c,
+        0x05408a88, 0x05408a89, 0x05408a87, 0x053008b6, 0x05408a98, 0x05408a99, 0x05408a97, 0x053008ab,
+        0x05408a78, 0x05408a79, 0x05408a77, 0x053008ba, 0x053008c8, 0x053008c9, 0x053008c7, 0x0520008e,
+        0x0d406888, 0x0d406889, 0x0d406887, 0x0d300686, 0x0d406898, 0x0d406899, 0x0d406897, 0x05300895,
+        0x0d406878, 0x0d406879, 0x0d406877, 0x0d30068a, 0x0d300568, 0x0d300569, 0x0d300567, 0x0d200054,
+        0x0d406988, 0x0d406989, 0x0d406987, 0x0d3006a6, 0x0d406998, 0x0d406999, 0x0d406997, 0x0530089b,
+        0x0d406978, 0x0d406979, 0x0d406977, 0x0d3006aa, 0x0d3006b8, 0x0d3006b9, 0x0d3006b7, 0x0d20006d,
+        0x0d406788, 0x0d406789, 0x0d406787, 0x04b00996, 0x0d406798, 0x0d406799, 0x0d406797, 0x0d200045,
+        0x0d406778, 0x0d406779, 0x0d406777, 0x04b0099a, 0x0d3005a8, 0x0d3005a9, 0x0d3005a7, 0x0d20005c,
+        0x0d300488, 0x0d300489, 0x0d300487, 0x0d200036, 0x0d300498, 0x0d300499, 0x0d300497, 0x0d20004b,
+        0x0d300478, 0x0d300479, 0x0d300477, 0x0d20003a, 0x0d200028, 0x0d200029, 0x0d200027, 0x00000000,
+        0x05598888, 0x05598889, 0x05598887, 0x05409886, 0x05598898, 0x05598899, 0x05598897, 0x04b00785,
+        0x05598878, 0x05598879, 0x05598877, 0x0540988a, 0x05409868, 0x05409869, 0x05409867, 0x05300984,
+        0x05598988, 0x05598989, 0x05598987, 0x05300766, 0x05598998, 0x05598999, 0x05598997, 0x04b0078b,
+        0x05598978, 0x05598979, 0x05598977, 0x0530076a, 0x05300758, 0x05300759, 0x05300757, 0x05200073,
+        0x05598788, 0x05598789, 0x05598787, 0x04b00776, 0x05598798, 0x05598799, 0x05598797, 0x0c200065,
+        0x05598778, 0x05598779, 0x05598777, 0x04b0077a, 0x054098a8, 0x054098a9, 0x054098a7, 0x0530098c,
+        0x0c300688, 0x0c300689, 0x0c300687, 0x0c200056, 0x0c300698, 0x0c300699, 0x0c300697, 0x0c20006b,
+        0x0c300678, 0x0c300679, 0x0c300677, 0x0c20005a, 0x0c200048, 0x0c200049, 0x0c200047, 0x0c100002,
+        0x05599888, 0x05599889, 0x05599887, 0x05409986, 0x05599898, 0x05599899, 0x05599897, 0x05300975,
+        0x05599878, 0x05599879, 0x05599877, 0x0540998a, 0x0cb00a68, 0x0cb00a69, 0x0cb00a67, 0x0ca000a4,
+        0x05599988, 0x05599989, 0x05599987, 0x053007a6, 0x05599998, 0x05599999, 0x05599997, 0x0530097b,
+        0x05599978, 0x05599979, 0x05599977, 0x053007aa, 0x053007b8, 0x053007b9, 0x053007b7, 0x0520007d,
+        0x05599788, 0x05599789, 0x05599787, 0x04b00796, 0x05599798, 0x05599799, 0x05599797, 0x0ca000b5,
+        0x05599778, 0x05599779, 0x05599777, 0x04b0079a, 0x0cb00aa8, 0x0cb00aa9, 0x0cb00aa7, 0x0ca000ac,
+        0x0cb00b88, 0x0cb00b89, 0x0cb00b87, 0x0ca000c6, 0x0cb00b98, 0x0cb00b99, 0x0cb00b97, 0x0ca000bb,
+        0x0cb00b78, 0x0cb00b79, 0x0cb00b77, 0x0ca000ca, 0x0ca000d8, 0x0ca000d9, 0x0ca000d7, 0x00000000,
+        0x05597888, 0x05597889, 0x05597887, 0x05409786, 0x05597898, 0x05597899, 0x05597897, 0x03a00085,
+        0x05597878, 0x05597879, 0x05597877, 0x0540978a, 0x04b00968, 0x04b00969, 0x04b00967, 0x04a00094,
+        0x05597988, 0x05597989, 0x05597987, 0x0ba00066, 0x05597998, 0x05597999, 0x05597997, 0x03a0008b,
+        0x05597978, 0x05597979, 0x05597977, 0x0ba0006a, 0x0ba00058, 0x0ba00059, 0x0ba00057, 0x0b900003,
+        0x05597788, 0x05597789, 0x05597787, 0x03a00076, 0x05597798, 0x05597799, 0x05597797, 0x0c2000a5,
+        0x05597778, 0x05597779, 0x05597777, 0x03a0007a, 0x04b009a8, 0x04b009a9, 0x04b009a7, 0x04a0009c,
+        0x0c300a88, 0x0c300a89, 0x0c300a87, 0x0c2000b6, 0x0c300a98, 0x0c300a99, 0x0c300a97, 0x0c2000ab,
+        0x0c300a78, 0x0c300a79, 0x0c300a77, 0x0c2000ba, 0x0c2000c8, 0x0c2000c9, 0x0c2000c7, 0x0c10000e,
+        0x03300888, 0x03300889, 0x03300887, 0x03200086, 0x03300898, 0x03300899, 0x03300897, 0x05300995,
+        0x03300878, 0x03300879, 0x03300877, 0x0320008a, 0x0b200068, 0x0b200069, 0x0b200067, 0x0b100004,
+        0x03300988, 0x03300989, 0x03300987, 0x0ba000a6, 0x03300998, 0x03300999, 0x03300997, 0x0530099b,
+        0x03300978, 0x03300979, 0x03300977, 0x0ba000aa, 0x0ba000b8, 0x0ba000b9, 0x0ba000b7, 0x0b90000d,
+        0x03300788, 0x03300789, 0x03300787, 0x03a00096, 0x03300798, 0x03300799, 0x03300797, 0x0a900005,
+        0x03300778, 0x03300779, 0x03300777, 0x03a0009a, 0x0b2000a8, 0x0b2000a9, 0x0b2000a7, 0x0b10000c,
+        0x02200088, 0x02200089, 0x02200087, 0x0a100006, 0x02200098, 0x02200099, 0x02200097, 0x0a90000b,
+        0x02200078, 0x02200079, 0x02200077, 0x0a10000a, 0x01100008, 0x01100009, 0x01100007, 0x00000000,
+        0x05578888, 0x05578889, 0x05578887, 0x05407886, 0x05578898, 0x05578899, 0x05578897, 0x04b00885,
+        0x05578878, 0x05578879, 0x05578877, 0x0540788a, 0x05407868, 0x05407869, 0x05407867, 0x05300784,
+        0x05578988, 0x05578989, 0x05578987, 0x04b00866, 0x05578998, 0x05578999, 0x05578997, 0x04b0088b,
+        0x05578978, 0x05578979, 0x05578977, 0x04b0086a, 0x04b00858, 0x04b00859, 0x04b00857, 0x04a00083,
+        0x05578788, 0x05578789, 0x05578787, 0x04b00876, 0x05578798, 0x05578799, 0x05578797, 0x0c200065,
+        0x05578778, 0x05578779, 0x05578777, 0x04b0087a, 0x054078a8, 0x054078a9, 0x054078a7, 0x0530078c,
+        0x0c300688, 0x0c300689, 0x0c300687, 0x0c200056, 0x0c300698, 0x0c300699, 0x0c300697, 0x0c20006b,
+        0x0c300678, 0x0c300679, 0x0c300677, 0x0c20005a, 0x0c200048, 0x0c200049, 0x0c200047, 0x0c100002,
+        0x05579888, 0x05579889, 0x05579887, 0x05407986, 0x05579898, 0x05579899, 0x05579897, 0x05300775,
+        0x05579878, 0x05579879, 0x05579877, 0x0540798a, 0x0cb00668, 0x0cb00669, 0x0cb00667, 0x0ca00064,
+        0x05579988, 0x05579989, 0x05579987, 0x04b008a6, 0x05579998, 0x05579999, 0x05579997, 0x0530077b,
+        0x05579978, 0x05579979, 0x05579977, 0x04b008aa, 0x04b008b8, 0x04b008b9, 0x04b008b7, 0x04a0008d,
+        0x05579788, 0x05579789, 0x05579787, 0x04b00896, 0x05579798, 0x05579799, 0x05579797, 0x0ca00055,
+        0x05579778, 0x05579779, 0x05579777, 0x04b0089a, 0x0cb006a8, 0x0cb006a9, 0x0cb006a7, 0x0ca0006c,
+        0x0cb00588, 0x0cb00589, 0x0cb00587, 0x0ca00046, 0x0cb00598, 0x0cb00599, 0x0cb00597, 0x0ca0005b,
+        0x0cb00578, 0x0cb00579, 0x0cb00577, 0x0ca0004a, 0x0ca00038, 0x0ca00039, 0x0ca00037, 0x00000000,
+        0x05577888, 0x05577889, 0x05577887, 0x05407786, 0x05577898, 0x05577899, 0x05577897, 0x04b00985,
+        0x05577878, 0x05577879, 0x05577877, 0x0540778a, 0x04b00768, 0x04b00769, 0x04b00767, 0x04a00074,
+        0x05577988, 0x05577989, 0x05577987, 0x0d300a66, 0x05577998, 0x05577999, 0x05577997, 0x04b0098b,
+        0x05577978, 0x05577979, 0x05577977, 0x0d300a6a, 0x0d300a58, 0x0d300a59, 0x0d300a57, 0x0d2000a3,
+        0x05577788, 0x05577789, 0x05577787, 0x04b00976, 0x05577798, 0x05577799, 0x05577797, 0x0c2000a5,
+        0x05577778, 0x05577779, 0x05577777, 0x04b0097a, 0x04b007a8, 0x04b007a9, 0x04b007a7, 0x04a0007c,
+        0x0c300a88, 0x0c300a89, 0x0c300a87, 0x0c2000b6, 0x0c300a98, 0x0c300a99, 0x0c300a97, 0x0c2000ab,
+        0x0c300a78, 0x0c300a79, 0x0c300a77, 0x0c2000ba, 0x0c2000c8, 0x0c2000c9, 0x0c2000c7, 0x0c10000e,
+        0x0d40a888, 0x0d40a889, 0x0d40a887, 0x0d300a86, 0x0d40a898, 0x0d40a899, 0x0d40a897, 0x05300795,
+        0x0d40a878, 0x0d40a879, 0x0d40a877, 0x0d300a8a, 0x0d300b68, 0x0d300b69, 0x0d300b67, 0x0d2000b4,
+        0x0d40a988, 0x0d40a989, 0x0d40a987, 0x0d300aa6, 0x0d40a998, 0x0d40a999, 0x0d40a997, 0x0530079b,
+        0x0d40a978, 0x0d40a979, 0x0d40a977, 0x0d300aaa, 0x0d300ab8, 0x0d300ab9, 0x0d300ab7, 0x0d2000ad,
+        0x0d40a788, 0x0d40a789, 0x0d40a787, 0x04b00996, 0x0d40a798, 0x0d40a799, 0x0d40a797, 0x0d2000c5,
+        0x0d40a778, 0x0d40a779, 0x0d40a777, 0x04b0099a, 0x0d300ba8, 0x0d300ba9, 0x0d300ba7, 0x0d2000bc,
+        0x0d300c88, 0x0d300c89, 0x0d300c87, 0x0d2000d6, 0x0d300c98, 0x0d300c99, 0x0d300c97, 0x0d2000cb,
+        0x0d300c78, 0x0d300c79, 0x0d300c77, 0x0d2000da, 0x0d2000e8, 0x0d2000e9, 0x0d2000e7, 0x00000000,
+        0x04408888, 0x04408889, 0x04408887, 0x04300886, 0x04408898, 0x04408899, 0x04408897, 0x04b00785,
+        0x04408878, 0x04408879, 0x04408877, 0x0430088a, 0x04300868, 0x04300869, 0x04300867, 0x04200084,
+        0x04408988, 0x04408989, 0x04408987, 0x05300966, 0x04408998, 0x04408999, 0x04408997, 0x04b0078b,
+        0x04408978, 0x04408979, 0x04408977, 0x0530096a, 0x05300958, 0x05300959, 0x05300957, 0x05200093,
+        0x04408788, 0x04408789, 0x04408787, 0x04b00776, 0x04408798, 0x04408799, 0x04408797, 0x0c200065,
+        0x04408778, 0x04408779, 0x04408777, 0x04b0077a, 0x043008a8, 0x043008a9, 0x043008a7, 0x0420008c,
+        0x0c300688, 0x0c300689, 0x0c300687, 0x0c200056, 0x0c300698, 0x0c300699, 0x0c300697, 0x0c20006b,
+        0x0c300678, 0x0c300679, 0x0c300677, 0x0c20005a, 0x0c200048, 0x0c200049, 0x0c200047, 0x0c100002,
+        0x04409888, 0x04409889, 0x04409887, 0x04300986, 0x04409898, 0x04409899, 0x04409897, 0x04200075,
+        0x04409878, 0x04409879, 0x04409877, 0x0430098a, 0x0cb00a68, 0x0cb00a69, 0x0cb00a67, 0x0ca000a4,
+        0x04409988, 0x04409989, 0x04409987, 0x053009a6, 0x04409998, 0x04409999, 0x04409997, 0x0420007b,
+        0x04409978, 0x04409979, 0x04409977, 0x053009aa, 0x053009b8, 0x053009b9, 0x053009b7, 0x0520009d,
+        0x04409788, 0x04409789, 0x04409787, 0x04b00796, 0x04409798, 0x04409799, 0x04409797, 0x0ca000b5,
+        0x04409778, 0x04409779, 0x04409777, 0x04b0079a, 0x0cb00aa8, 0x0cb00aa9, 0x0cb00aa7, 0x0ca000ac,
+        0x0cb00b88, 0x0cb00b89, 0x0cb00b87, 0x0ca000c6, 0x0cb00b98, 0x0cb00b99, 0x0cb00b97, 0x0ca000bb,
+        0x0cb00b78, 0x0cb00b79, 0x0cb00b77, 0x0ca000ca, 0x0ca000d8, 0x0ca000d9, 0x0ca000d7, 0x00000000,
+        0x04407888, 0x04407889, 0x04407887, 0x04300786, 0x04407898, 0x04407899, 0x04407897, 0x03a00085,
+        0x04407878, 0x04407879, 0x04407877, 0x0430078a, 0x04b00968, 0x04b00969, 0x04b00967, 0x04a00094,
+        0x04407988, 0x04407989, 0x04407987, 0x0ba00066, 0x04407998, 0x04407999, 0x04407997, 0x03a0008b,
+        0x04407978, 0x04407979, 0x04407977, 0x0ba0006a, 0x0ba00058, 0x0ba00059, 0x0ba00057, 0x0b900003,
+        0x04407788, 0x04407789, 0x04407787, 0x03a00076, 0x04407798, 0x04407799, 0x04407797, 0x0c2000a5,
+        0x04407778, 0x04407779, 0x04407777, 0x03a0007a, 0x04b009a8, 0x04b009a9, 0x04b009a7, 0x04a0009c,
+        0x0c300a88, 0x0c300a89, 0x0c300a87, 0x0c2000b6, 0x0c300a98, 0x0c300a99, 0x0c300a97, 0x0c2000ab,
+        0x0c300a78, 0x0c300a79, 0x0c300a77, 0x0c2000ba, 0x0c2000c8, 0x0c2000c9, 0x0c2000c7, 0x0c10000e,
+        0x03300888, 0x03300889, 0x03300887, 0x03200086, 0x03300898, 0x03300899, 0x03300897, 0x04200095,
+        0x03300878, 0x03300879, 0x03300877, 0x0320008a, 0x0b200068, 0x0b200069, 0x0b200067, 0x0b100004,
+        0x03300988, 0x03300989, 0x03300987, 0x0ba000a6, 0x03300998, 0x03300999, 0x03300997, 0x0420009b,
+        0x03300978, 0x03300979, 0x03300977, 0x0ba000aa, 0x0ba000b8, 0x0ba000b9, 0x0ba000b7, 0x0b90000d,
+        0x03300788, 0x03300789, 0x03300787, 0x03a00096, 0x03300798, 0x03300799, 0x03300797, 0x0a900005,
+        0x03300778, 0x03300779, 0x03300777, 0x03a0009a, 0x0b2000a8, 0x0b2000a9, 0x0b2000a7, 0x0b10000c,
+        0x02200088, 0x02200089, 0x02200087, 0x0a100006, 0x02200098, 0x02200099, 0x02200097, 0x0a90000b,
+        0x02200078, 0x02200079, 0x02200077, 0x0a10000a, 0x01100008, 0x01100009, 0x01100007, 0x00000000
+    },
+    { /* large-pulse model */
+        0x05588888, 0x04c08886, 0x04c08887, 0x05408885, 0x05588898, 0x04c0888a, 0x04c08889, 0x04b00884,
+        0x05588878, 0x05408866, 0x04c08897, 0x0540888b, 0x05408868, 0x0540886a, 0x04c08899, 0x05300883,
+        0x05588988, 0x05408876, 0x04c08877, 0x04b00865, 0x05588998, 0x0540887a, 0x04c08879, 0x04b0088c,
+        0x05588978, 0x04b00856, 0x04b00867, 0x04b0086b, 0x04b00858, 0x04b0085a, 0x04b00869, 0x04a00082,
+        0x05588788, 0x04c08986, 0x04c08987, 0x04b00875, 0x05588798, 0x04c0898a, 0x04c08989, 0x05300864,
+        0x05588778, 0x054088a6, 0x04c08997, 0x04b0087b, 0x054088a8, 0x054088aa, 0x04c08999, 0x0530088d,
+        0x05408688, 0x05408896, 0x04c08977, 0x05300855, 0x05408698, 0x0540889a, 0x04c08979, 0x0530086c,
+        0x05408678, 0x05300846, 0x05300857, 0x0530085b, 0x05300848, 0x0530084a, 0x05300859, 0x08000000,
+        0x05589888, 0x04c08786, 0x04c08787, 0x05408985, 0x05589898, 0x04c0878a, 0x04c08789, 0x05300874,
+        0x05589878, 0x0cb00666, 0x04c08797, 0x0540898b, 0x0cb00668, 0x0cb0066a, 0x04c08799, 0x0ca00063,
+        0x05589988, 0x05408976, 0x04c08777, 0x04b008a5, 0x05589998, 0x0540897a, 0x04c08779, 0x0530087c,
+        0x05589978, 0x04b008b6, 0x04b008a7, 0x04b008ab, 0x04b008b8, 0x04b008ba, 0x04b008a9, 0x04a0008e,
+        0x05589788, 0x0cb00686, 0x0cb00687, 0x04b00895, 0x05589798, 0x0cb0068a, 0x0cb00689, 0x0ca00054,
+        0x05589778, 0x0cb006a6, 0x0cb00697, 0x04b0089b, 0x0cb006a8, 0x0cb006aa, 0x0cb00699, 0x0ca0006d,
+        0x0cb00588, 0x05408996, 0x0cb00677, 0x0ca00045, 0x0cb00598, 0x0540899a, 0x0cb00679, 0x0ca0005c,
+        0x0cb00578, 0x0ca00036, 0x0ca00047, 0x0ca0004b, 0x0ca00038, 0x0ca0003a, 0x0ca00049, 0x08000000,
+        0x05587888, 0x04c09886, 0x04c09887, 0x05408785, 0x05587898, 0x04c0988a, 0x04c09889, 0x04b00984,
+        0x05587878, 0x04b00766, 0x04c09897, 0x0540878b, 0x04b00768, 0x04b0076a, 0x04c09899, 0x04a00073,
+        0x05587988, 0x05408776, 0x04c09877, 0x0d300665, 0x05587998, 0x0540877a, 0x04c09879, 0x04b0098c,
+        0x05587978, 0x0d300656, 0x0d300667, 0x0d30066b, 0x0d300658, 0x0d30065a, 0x0d300669, 0x0d200062,
+        0x05587788, 0x04c09986, 0x04c09987, 0x04b00975, 0x05587798, 0x04c0998a, 0x04c09989, 0x053008a4,
+        0x05587778, 0x04b007a6, 0x04c09997, 0x04b0097b, 0x04b007a8, 0x04b007aa, 0x04c09999, 0x04a0007d,
+        0x05408a88, 0x05408796, 0x04c09977, 0x053008b5, 0x05408a98, 0x0540879a, 0x04c09979, 0x053008ac,
+        0x05408a78, 0x053008c6, 0x053008b7, 0x053008bb, 0x053008c8, 0x053008ca, 0x053008b9, 0x08000000,
+        0x0d406888, 0x04c09786, 0x04c09787, 0x0d300685, 0x0d406898, 0x04c0978a, 0x04c09789, 0x05300894,
+        0x0d406878, 0x0d300566, 0x04c09797, 0x0d30068b, 0x0d300568, 0x0d30056a, 0x04c09799, 0x0d200053,
+        0x0d406988, 0x0d300676, 0x04c09777, 0x0d3006a5, 0x0d406998, 0x0d30067a, 0x04c09779, 0x0530089c,
+        0x0d406978, 0x0d3006b6, 0x0d3006a7, 0x0d3006ab, 0x0d3006b8, 0x0d3006ba, 0x0d3006a9, 0x0d20006e,
+        0x0d406788, 0x0d300586, 0x0d300587, 0x04b00995, 0x0d406798, 0x0d30058a, 0x0d300589, 0x0d200044,
+        0x0d406778, 0x0d3005a6, 0x0d300597, 0x04b0099b, 0x0d3005a8, 0x0d3005aa, 0x0d300599, 0x0d20005d,
+        0x0d300488, 0x0d300696, 0x0d300577, 0x0d200035, 0x0d300498, 0x0d30069a, 0x0d300579, 0x0d20004c,
+        0x0d300478, 0x0d200026, 0x0d200037, 0x0d20003b, 0x0d200028, 0x0d20002a, 0x0d200039, 0x08000000,
+        0x05598888, 0x04c07886, 0x04c07887, 0x05409885, 0x05598898, 0x04c0788a, 0x04c07889, 0x04b00784,
+        0x05598878, 0x05409866, 0x04c07897, 0x0540988b, 0x05409868, 0x0540986a, 0x04c07899, 0x05300983,
+        0x05598988, 0x05409876, 0x04c07877, 0x05300765, 0x05598998, 0x0540987a, 0x04c07879, 0x04b0078c,
+        0x05598978, 0x05300756, 0x05300767, 0x0530076b, 0x05300758, 0x0530075a, 0x05300769, 0x05200072,
+        0x05598788, 0x04c07986, 0x04c07987, 0x04b00775, 0x05598798, 0x04c0798a, 0x04c07989, 0x0c200064,
+        0x05598778, 0x054098a6, 0x04c07997, 0x04b0077b, 0x054098a8, 0x054098aa, 0x04c07999, 0x0530098d,
+        0x0c300688, 0x05409896, 0x04c07977, 0x0c200055, 0x0c300698, 0x0540989a, 0x04c07979, 0x0c20006c,
+        0x0c300678, 0x0c200046, 0x0c200057, 0x0c20005b, 0x0c200048, 0x0c20004a, 0x0c200059, 0x08000000,
+        0x05599888, 0x04c07786, 0x04c07787, 0x05409985, 0x05599898, 0x04c0778a, 0x04c07789, 0x05300974,
+        0x05599878, 0x0cb00a66, 0x04c07797, 0x0540998b, 0x0cb00a68, 0x0cb00a6a, 0x04c07799, 0x0ca000a3,
+        0x05599988, 0x05409976, 0x04c07777, 0x053007a5, 0x05599998, 0x0540997a, 0x04c07779, 0x0530097c,
+        0x05599978, 0x053007b6, 0x053007a7, 0x053007ab, 0x053007b8, 0x053007ba, 0x053007a9, 0x0520007e,
+        0x05599788, 0x0cb00a86, 0x0cb00a87, 0x04b00795, 0x05599798, 0x0cb00a8a, 0x0cb00a89, 0x0ca000b4,
+        0x05599778, 0x0cb00aa6, 0x0cb00a97, 0x04b0079b, 0x0cb00aa8, 0x0cb00aaa, 0x0cb00a99, 0x0ca000ad,
+        0x0cb00b88, 0x05409996, 0x0cb00a77, 0x0ca000c5, 0x0cb00b98, 0x0540999a, 0x0cb00a79, 0x0ca000bc,
+        0x0cb00b78, 0x0ca000d6, 0x0ca000c7, 0x0ca000cb, 0x0ca000d8, 0x0ca000da, 0x0ca000c9, 0x08000000,
+        0x05597888, 0x03b00886, 0x03b00887, 0x05409785, 0x05597898, 0x03b0088a, 0x03b00889, 0x03a00084,
+        0x05597878, 0x04b00966, 0x03b00897, 0x0540978b, 0x04b00968, 0x04b0096a, 0x03b00899, 0x04a00093,
+        0x05597988, 0x05409776, 0x03b00877, 0x0ba00065, 0x05597998, 0x0540977a, 0x03b00879, 0x03a0008c,
+        0x05597978, 0x0ba00056, 0x0ba00067, 0x0ba0006b, 0x0ba00058, 0x0ba0005a, 0x0ba00069, 0x0b900002,
+        0x05597788, 0x03b00986, 0x03b00987, 0x03a00075, 0x05597798, 0x03b0098a, 0x03b00989, 0x0c2000a4,
+        0x05597778, 0x04b009a6, 0x03b00997, 0x03a0007b, 0x04b009a8, 0x04b009aa, 0x03b00999, 0x04a0009d,
+        0x0c300a88, 0x05409796, 0x03b00977, 0x0c2000b5, 0x0c300a98, 0x0540979a, 0x03b00979, 0x0c2000ac,
+        0x0c300a78, 0x0c2000c6, 0x0c2000b7, 0x0c2000bb, 0x0c2000c8, 0x0c2000ca, 0x0c2000b9, 0x08000000,
+        0x03300888, 0x03b00786, 0x03b00787, 0x03200085, 0x03300898, 0x03b0078a, 0x03b00789, 0x05300994,
+        0x03300878, 0x0b200066, 0x03b00797, 0x0320008b, 0x0b200068, 0x0b20006a, 0x03b00799, 0x0b100003,
+        0x03300988, 0x03200076, 0x03b00777, 0x0ba000a5, 0x03300998, 0x0320007a, 0x03b00779, 0x0530099c,
+        0x03300978, 0x0ba000b6, 0x0ba000a7, 0x0ba000ab, 0x0ba000b8, 0x0ba000ba, 0x0ba000a9, 0x0b90000e,
+        0x03300788, 0x02a00086, 0x02a00087, 0x03a00095, 0x03300798, 0x02a0008a, 0x02a00089, 0x0a900004,
+        0x03300778, 0x0b2000a6, 0x02a00097, 0x03a0009b, 0x0b2000a8, 0x0b2000aa, 0x02a00099, 0x0b10000d,
+        0x02200088, 0x03200096, 0x02a00077, 0x0a100005, 0x02200098, 0x0320009a, 0x02a00079, 0x0a90000c,
+        0x02200078, 0x09900006, 0x01900007, 0x0a10000b, 0x01100008, 0x0990000a, 0x01900009, 0x08000000,
+        0x05578888, 0x04c08886, 0x04c08887, 0x05407885, 0x05578898, 0x04c0888a, 0x04c08889, 0x04b00884,
+        0x05578878, 0x05407866, 0x04c08897, 0x0540788b, 0x05407868, 0x0540786a, 0x04c08899, 0x05300783,
+        0x05578988, 0x05407876, 0x04c08877, 0x04b00865, 0x05578998, 0x0540787a, 0x04c08879, 0x04b0088c,
+        0x05578978, 0x04b00856, 0x04b00867, 0x04b0086b, 0x04b00858, 0x04b0085a, 0x04b00869, 0x04a00082,
+        0x05578788, 0x04c08986, 0x04c08987, 0x04b00875, 0x05578798, 0x04c0898a, 0x04c08989, 0x0c200064,
+        0x05578778, 0x054078a6, 0x04c08997, 0x04b0087b, 0x054078a8, 0x054078aa, 0x04c08999, 0x0530078d,
+        0x0c300688, 0x05407896, 0x04c08977, 0x0c200055, 0x0c300698, 0x0540789a, 0x04c08979, 0x0c20006c,
+        0x0c300678, 0x0c200046, 0x0c200057, 0x0c20005b, 0x0c200048, 0x0c20004a, 0x0c200059, 0x08000000,
+        0x05579888, 0x04c08786, 0x04c08787, 0x05407985, 0x05579898, 0x04c0878a, 0x04c08789, 0x05300774,
+        0x05579878, 0x0cb00666, 0x04c08797, 0x0540798b, 0x0cb00668, 0x0cb0066a, 0x04c08799, 0x0ca00063,
+        0x05579988, 0x05407976, 0x04c08777, 0x04b008a5, 0x05579998, 0x0540797a, 0x04c08779, 0x0530077c,
+        0x05579978, 0x04b008b6, 0x04b008a7, 0x04b008ab, 0x04b008b8, 0x04b008ba, 0x04b008a9, 0x04a0008e,
+        0x05579788, 0x0cb00686, 0x0cb00687, 0x04b00895, 0x05579798, 0x0cb0068a, 0x0cb00689, 0x0ca00054,
+        0x05579778, 0x0cb006a6, 0x0cb00697, 0x04b0089b, 0x0cb006a8, 0x0cb006aa, 0x0cb00699, 0x0ca0006d,
+        0x0cb00588, 0x05407996, 0x0cb00677, 0x0ca00045, 0x0cb00598, 0x0540799a, 0x0cb00679, 0x0ca0005c,
+        0x0cb00578, 0x0ca00036, 0x0ca00047, 0x0ca0004b, 0x0ca00038, 0x0ca0003a, 0x0ca00049, 0x08000000,
+        0x05577888, 0x04c09886, 0x04c09887, 0x05407785, 0x05577898, 0x04c0988a, 0x04c09889, 0x04b00984,
+        0x05577878, 0x04b00766, 0x04c09897, 0x0540778b, 0x04b00768, 0x04b0076a, 0x04c09899, 0x04a00073,
+        0x05577988, 0x05407776, 0x04c09877, 0x0d300a65, 0x05577998, 0x0540777a, 0x04c09879, 0x04b0098c,
+        0x05577978, 0x0d300a56, 0x0d300a67, 0x0d300a6b, 0x0d300a58, 0x0d300a5a, 0x0d300a69, 0x0d2000a2,
+        0x05577788, 0x04c09986, 0x04c09987, 0x04b00975, 0x05577798, 0x04c0998a, 0x04c09989, 0x0c2000a4,
+        0x05577778, 0x04b007a6, 0x04c09997, 0x04b0097b, 0x04b007a8, 0x04b007aa, 0x04c09999, 0x04a0007d,
+        0x0c300a88, 0x05407796, 0x04c09977, 0x0c2000b5, 0x0c300a98, 0x0540779a, 0x04c09979, 0x0c2000ac,
+        0x0c300a78, 0x0c2000c6, 0x0c2000b7, 0x0c2000bb, 0x0c2000c8, 0x0c2000ca, 0x0c2000b9, 0x08000000,
+        0x0d40a888, 0x04c09786, 0x04c09787, 0x0d300a85, 0x0d40a898, 0x04c0978a, 0x04c09789, 0x05300794,
+        0x0d40a878, 0x0d300b66, 0x04c09797, 0x0d300a8b, 0x0d300b68, 0x0d300b6a, 0x04c09799, 0x0d2000b3,
+        0x0d40a988, 0x0d300a76, 0x04c09777, 0x0d300aa5, 0x0d40a998, 0x0d300a7a, 0x04c09779, 0x0530079c,
+        0x0d40a978, 0x0d300ab6, 0x0d300aa7, 0x0d300aab, 0x0d300ab8, 0x0d300aba, 0x0d300aa9, 0x0d2000ae,
+        0x0d40a788, 0x0d300b86, 0x0d300b87, 0x04b00995, 0x0d40a798, 0x0d300b8a, 0x0d300b89, 0x0d2000c4,
+        0x0d40a778, 0x0d300ba6, 0x0d300b97, 0x04b0099b, 0x0d300ba8, 0x0d300baa, 0x0d300b99, 0x0d2000bd,
+        0x0d300c88, 0x0d300a96, 0x0d300b77, 0x0d2000d5, 0x0d300c98, 0x0d300a9a, 0x0d300b79, 0x0d2000cc,
+        0x0d300c78, 0x0d2000e6, 0x0d2000d7, 0x0d2000db, 0x0d2000e8, 0x0d2000ea, 0x0d2000d9, 0x08000000,
+        0x04408888, 0x04c07886, 0x04c07887, 0x04300885, 0x04408898, 0x04c0788a, 0x04c07889, 0x04b00784,
+        0x04408878, 0x04300866, 0x04c07897, 0x0430088b, 0x04300868, 0x0430086a, 0x04c07899, 0x04200083,
+        0x04408988, 0x04300876, 0x04c07877, 0x05300965, 0x04408998, 0x0430087a, 0x04c07879, 0x04b0078c,
+        0x04408978, 0x05300956, 0x05300967, 0x0530096b, 0x05300958, 0x0530095a, 0x05300969, 0x05200092,
+        0x04408788, 0x04c07986, 0x04c07987, 0x04b00775, 0x04408798, 0x04c0798a, 0x04c07989, 0x0c200064,
+        0x04408778, 0x043008a6, 0x04c07997, 0x04b0077b, 0x043008a8, 0x043008aa, 0x04c07999, 0x0420008d,
+        0x0c300688, 0x04300896, 0x04c07977, 0x0c200055, 0x0c300698, 0x0430089a, 0x04c07979, 0x0c20006c,
+        0x0c300678, 0x0c200046, 0x0c200057, 0x0c20005b, 0x0c200048, 0x0c20004a, 0x0c200059, 0x08000000,
+        0x04409888, 0x04c07786, 0x04c07787, 0x04300985, 0x04409898, 0x04c0778a, 0x04c07789, 0x04200074,
+        0x04409878, 0x0cb00a66, 0x04c07797, 0x0430098b, 0x0cb00a68, 0x0cb00a6a, 0x04c07799, 0x0ca000a3,
+        0x04409988, 0x04300976, 0x04c07777, 0x053009a5, 0x04409998, 0x0430097a, 0x04c07779, 0x0420007c,
+        0x04409978, 0x053009b6, 0x053009a7, 0x053009ab, 0x053009b8, 0x053009ba, 0x053009a9, 0x0520009e,
+        0x04409788, 0x0cb00a86, 0x0cb00a87, 0x04b00795, 0x04409798, 0x0cb00a8a, 0x0cb00a89, 0x0ca000b4,
+        0x04409778, 0x0cb00aa6, 0x0cb00a97, 0x04b0079b, 0x0cb00aa8, 0x0cb00aaa, 0x0cb00a99, 0x0ca000ad,
+        0x0cb00b88, 0x04300996, 0x0cb00a77, 0x0ca000c5, 0x0cb00b98, 0x0430099a, 0x0cb00a79, 0x0ca000bc,
+        0x0cb00b78, 0x0ca000d6, 0x0ca000c7, 0x0ca000cb, 0x0ca000d8, 0x0ca000da, 0x0ca000c9, 0x08000000,
+        0x04407888, 0x03b00886, 0x03b00887, 0x04300785, 0x04407898, 0x03b0088a, 0x03b00889, 0x03a00084,
+        0x04407878, 0x04b00966, 0x03b00897, 0x0430078b, 0x04b00968, 0x04b0096a, 0x03b00899, 0x04a00093,
+        0x04407988, 0x04300776, 0x03b00877, 0x0ba00065, 0x04407998, 0x0430077a, 0x03b00879, 0x03a0008c,
+        0x04407978, 0x0ba00056, 0x0ba00067, 0x0ba0006b, 0x0ba00058, 0x0ba0005a, 0x0ba00069, 0x0b900002,
+        0x04407788, 0x03b00986, 0x03b00987, 0x03a00075, 0x04407798, 0x03b0098a, 0x03b00989, 0x0c2000a4,
+        0x04407778, 0x04b009a6, 0x03b00997, 0x03a0007b, 0x04b009a8, 0x04b009aa, 0x03b00999, 0x04a0009d,
+        0x0c300a88, 0x04300796, 0x03b00977, 0x0c2000b5, 0x0c300a98, 0x0430079a, 0x03b00979, 0x0c2000ac,
+        0x0c300a78, 0x0c2000c6, 0x0c2000b7, 0x0c2000bb, 0x0c2000c8, 0x0c2000ca, 0x0c2000b9, 0x08000000,
+        0x03300888, 0x03b00786, 0x03b00787, 0x03200085, 0x03300898, 0x03b0078a, 0x03b00789, 0x04200094,
+        0x03300878, 0x0b200066, 0x03b00797, 0x0320008b, 0x0b200068, 0x0b20006a, 0x03b00799, 0x0b100003,
+        0x03300988, 0x03200076, 0x03b00777, 0x0ba000a5, 0x03300998, 0x0320007a, 0x03b00779, 0x0420009c,
+        0x03300978, 0x0ba000b6, 0x0ba000a7, 0x0ba000ab, 0x0ba000b8, 0x0ba000ba, 0x0ba000a9, 0x0b90000e,
+        0x03300788, 0x02a00086, 0x02a00087, 0x03a00095, 0x03300798, 0x02a0008a, 0x02a00089, 0x0a900004,
+        0x03300778, 0x0b2000a6, 0x02a00097, 0x03a0009b, 0x0b2000a8, 0x0b2000aa, 0x02a00099, 0x0b10000d,
+        0x02200088, 0x03200096, 0x02a00077, 0x0a100005, 0x02200098, 0x0320009a, 0x02a00079, 0x0a90000c,
+        0x02200078, 0x09900006, 0x01900007, 0x0a10000b, 0x01100008, 0x0990000a, 0x01900009, 0x08000000
+    }
+};
+
+/* RELP decoding table, indexed by the next 8 bits.
+** bits 0-15: up to 8 samples, 2 bits each (0 = 0, 1 = -2, 2 = +2)
+** bits 16-19: number of samples
+** bits 20-23: number of bits consumed */
+static const uint32_t utk_relp_table[256] = {
+    0x00880000, 0x00870001, 0x00870004, 0x00870002, 0x00870010, 0x00860005, 0x00870008, 0x00860006,
+    0x00870040, 0x00860011, 0x00860014, 0x00860012, 0x00870020, 0x00860009, 0x00860018, 0x0086000a,
+    0x00870100, 0x00860041, 0x00860044, 0x00860042, 0x00860050, 0x00850015, 0x00860048, 0x00850016,
+    0x00870080, 0x00860021, 0x00860024, 0x00860022, 0x00860060, 0x00850019, 0x00860028, 0x0085001a,
+    0x00870400, 0x00860101, 0x00860104, 0x00860102, 0x00860110, 0x00850045, 0x00860108, 0x00850046,
+    0x00860140, 0x00850051, 0x00850054, 0x00850052, 0x00860120, 0x00850049, 0x00850058, 0x0085004a,
+    0x00870200, 0x00860081, 0x00860084, 0x00860082, 0x00860090, 0x00850025, 0x00860088, 0x00850026,
+    0x00860180, 0x00850061, 0x00850064, 0x00850062, 0x008600a0, 0x00850029, 0x00850068, 0x0085002a,
+    0x00871000, 0x00860401, 0x00860404, 0x00860402, 0x00860410, 0x00850105, 0x00860408, 0x00850106,
+    0x00860440, 0x00850111, 0x00850114, 0x00850112, 0x00860420, 0x00850109, 0x00850118, 0x0085010a,
+    0x00860500, 0x00850141, 0x00850144, 0x00850142, 0x00850150, 0x00840055, 0x00850148, 0x00840056,
+    0x00860480, 0x00850121, 0x00850124, 0x00850122, 0x00850160, 0x00840059, 0x00850128, 0x0084005a,
+    0x00870800, 0x00860201, 0x00860204, 0x00860202, 0x00860210, 0x00850085, 0x00860208, 0x00850086,
+    0x00860240, 0x00850091, 0x00850094, 0x00850092, 0x00860220, 0x00850089, 0x00850098, 0x0085008a,
+    0x00860600, 0x00850181, 0x00850184, 0x00850182, 0x00850190, 0x00840065, 0x00850188, 0x00840066,
+    0x00860280, 0x008500a1, 0x008500a4, 0x008500a2, 0x008501a0, 0x00840069, 0x008500a8, 0x0084006a,
+    0x00770000, 0x00760001, 0x00760004, 0x00760002, 0x00760010, 0x00750005, 0x00760008, 0x00750006,
+    0x00760040, 0x00750011, 0x00750014, 0x00750012, 0x00760020, 0x00750009, 0x00750018, 0x0075000a,
+    0x00760100, 0x00750041, 0x00750044, 0x00750042, 0x00750050, 0x00740015, 0x00750048, 0x00740016,
+    0x00760080, 0x00750021, 0x00750024, 0x00750022, 0x00750060, 0x00740019, 0x00750028, 0x0074001a,
+    0x00760400, 0x00750101, 0x00750104, 0x00750102, 0x00750110, 0x00740045, 0x00750108, 0x00740046,
+    0x00750140, 0x00740051, 0x00740054, 0x00740052, 0x00750120, 0x00740049, 0x00740058, 0x0074004a,
+    0x00760200, 0x00750081, 0x00750084, 0x00750082, 0x00750090, 0x00740025, 0x00750088, 0x00740026,
+    0x00750180, 0x00740061, 0x00740064, 0x00740062, 0x007500a0, 0x00740029, 0x00740068, 0x0074002a,
+    0x00872000, 0x00860801, 0x00860804, 0x00860802, 0x00860810, 0x00850205, 0x00860808, 0x00850206,
+    0x00860840, 0x00850211, 0x00850214, 0x00850212, 0x00860820, 0x00850209, 0x00850218, 0x0085020a,
+    0x00860900, 0x00850241, 0x00850244, 0x00850242, 0x00850250, 0x00840095, 0x00850248, 0x00840096,
+    0x00860880, 0x00850221, 0x00850224, 0x00850222, 0x00850260, 0x00840099, 0x00850228, 0x0084009a,
+    0x00760800, 0x00750201, 0x00750204, 0x00750202, 0x00750210, 0x00740085, 0x00750208, 0x00740086,
+    0x00750240, 0x00740091, 0x00740094, 0x00740092, 0x00750220, 0x00740089, 0x00740098, 0x0074008a,
+    0x00860a00, 0x00850281, 0x00850284, 0x00850282, 0x00850290, 0x008400a5, 0x00850288, 0x008400a6,
+    0x00750280, 0x007400a1, 0x007400a4, 0x007400a2, 0x008502a0, 0x008400a9, 0x007400a8, 0x008400aa
+};
+
+/* utk_rc_table in Q24 fixed point, for utkfixed.h. */
+#define UTK_RC_FRAC_BITS 24
+
+static const int32_t utk_rc_table_fixed[64] = {
+           0, -16723126, -16614930, -16506751, -16398571, -16290375, -16182195, -16073999,
+    -15965820, -15615461, -15182709, -14749975, -14317223, -13884472, -13451737, -13018985,
+    -12586234, -12153499, -11720748, -11251388, -10385902, -9520399, -8654913, -7789426,
+    -6923923, -6058437, -5192951, -4327465, -3461962, -2596475, -1730989,  -865486,
+           0,   865486,  1730989,  2596476,  3461962,  4327465,  5192951,  6058437,
+     6923924,  7789427,  8654913,  9520399, 10385902, 11251388, 11720748, 12153499,
+    12586234, 13018985, 13451737, 13884472, 14317223, 14749975, 15182709, 15615461,
+    15965820, 16073999, 16182195, 16290375, 16398571, 16506751, 16614930, 16723126
+};
+
+#endif